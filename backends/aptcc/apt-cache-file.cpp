@@ -23,37 +23,76 @@
 
 #include <sstream>
 #include <cstdio>
+#include <memory>
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/upgrade.h>
 
 #include "apt-utils.h"
 #include "apt-messages.h"
+#include "apt-provides-index.h"
+#include "apt-search-index.h"
 
 using namespace APT;
 
-AptCacheFile::AptCacheFile(PkBackendJob *job) :
+// The job of the calling thread, for caches shared between jobs
+static thread_local PkBackendJob *s_threadJob = nullptr;
+
+// The record parsers keep state between lookups, so every thread using
+// a shared cache gets its own
+struct ThreadPkgRecords {
+    const AptCacheFile *owner = nullptr;
+    std::unique_ptr<pkgRecords> records;
+};
+static thread_local ThreadPkgRecords s_threadRecords;
+
+AptCacheFile::AptCacheFile(PkBackendJob *job, bool shared) :
     m_packageRecords(0),
-    m_job(job)
+    m_job(job),
+    m_shared(shared),
+    m_detailsIndex(nullptr),
+    m_nameIndex(nullptr),
+    m_providesIndex(nullptr),
+    m_versionCount(0)
 {
+    g_mutex_init(&m_indexMutex);
+    if (m_shared) {
+        s_threadJob = job;
+    }
 }
 
 AptCacheFile::~AptCacheFile()
 {
     Close();
+    g_mutex_clear(&m_indexMutex);
 }
 
 bool AptCacheFile::Open(bool withLock)
 {
-    OpPackageKitProgress progress(m_job);
-    return pkgCacheFile::Open(&progress, withLock);
+    OpPackageKitProgress progress(job());
+    if (!pkgCacheFile::Open(&progress, withLock)) {
+        return false;
+    }
+
+    // one slot per version, filled in as the filters need them
+    m_versionCount = GetPkgCache()->Head().VersionCount;
+    m_versionFlags.reset(new std::atomic<guint16>[m_versionCount]());
+    return true;
 }
 
 void AptCacheFile::Close()
 {
     delete m_packageRecords;
+    delete m_detailsIndex;
+    delete m_nameIndex;
+    delete m_providesIndex;
 
     m_packageRecords = 0;
+    m_detailsIndex = nullptr;
+    m_nameIndex = nullptr;
+    m_providesIndex = nullptr;
+    m_versionFlags.reset();
+    m_versionCount = 0;
 
     pkgCacheFile::Close();
 
@@ -64,7 +103,7 @@ void AptCacheFile::Close()
 
 bool AptCacheFile::BuildCaches(bool withLock)
 {
-    OpPackageKitProgress progress(m_job);
+    OpPackageKitProgress progress(job());
     return pkgCacheFile::BuildCaches(&progress, withLock);
 }
 
@@ -77,14 +116,14 @@ bool AptCacheFile::CheckDeps(bool AllowBroken)
     // Check that the system is OK
     if (DCache->DelCount() != 0 || DCache->InstCount() != 0) {
         _error->Error("Internal error, non-zero counts");
-        show_errors(m_job, PK_ERROR_ENUM_INTERNAL_ERROR);
+        show_errors(job(), PK_ERROR_ENUM_INTERNAL_ERROR);
         return false;
     }
 
     // Apply corrections for half-installed packages
     if (pkgApplyStatus(*DCache) == false) {
         _error->Error("Unable to apply corrections for half-installed packages");;
-        show_errors(m_job, PK_ERROR_ENUM_INTERNAL_ERROR);
+        show_errors(job(), PK_ERROR_ENUM_INTERNAL_ERROR);
         return false;
     }
 
@@ -104,7 +143,7 @@ bool AptCacheFile::CheckDeps(bool AllowBroken)
 
     if (pkgMinimizeUpgrade(*DCache) == false) {
         g_warning("Unable to minimize the upgrade set");
-        show_errors(m_job, PK_ERROR_ENUM_INTERNAL_ERROR);
+        show_errors(job(), PK_ERROR_ENUM_INTERNAL_ERROR);
         return false;
     }
 
@@ -114,7 +153,7 @@ bool AptCacheFile::CheckDeps(bool AllowBroken)
 
 bool AptCacheFile::DistUpgrade()
 {
-    OpPackageKitProgress progress(m_job);
+    OpPackageKitProgress progress(job());
     return Upgrade::Upgrade(*this, Upgrade::ALLOW_EVERYTHING, &progress);
 }
 
@@ -245,12 +284,40 @@ void AptCacheFile::ShowBroken(bool Now, PkErrorEnum error)
             }
         }
     }
-    pk_backend_job_error_code(m_job,
+    pk_backend_job_error_code(job(),
                               error,
                               "%s",
                               utf8(out.str().c_str()));
 }
 
+pkgRecords* AptCacheFile::GetPkgRecords()
+{
+    if (m_shared) {
+        if (s_threadRecords.owner != this) {
+            s_threadRecords.records.reset(new pkgRecords(*this));
+            s_threadRecords.owner = this;
+        }
+        return s_threadRecords.records.get();
+    }
+
+    buildPkgRecords();
+    return m_packageRecords;
+}
+
+void AptCacheFile::setJob(PkBackendJob *job)
+{
+    if (m_shared) {
+        s_threadJob = job;
+    } else {
+        m_job = job;
+    }
+}
+
+PkBackendJob* AptCacheFile::job() const
+{
+    return m_shared ? s_threadJob : m_job;
+}
+
 void AptCacheFile::buildPkgRecords()
 {
     if (m_packageRecords) {
@@ -345,7 +412,7 @@ bool AptCacheFile::isRemovingEssentialPackages()
 
     delete [] Added;
     if (!List.empty()) {
-        pk_backend_job_error_code(m_job,
+        pk_backend_job_error_code(job(),
                                   PK_ERROR_ENUM_CANNOT_REMOVE_SYSTEM_PACKAGE,
                                   "WARNING: You are trying to remove the following essential packages: %s",
                                   List.c_str());
@@ -428,7 +495,7 @@ std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).ShortDesc();
+        return GetPkgRecords()->Lookup(df).ShortDesc();
     }
 }
 
@@ -447,7 +514,7 @@ std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).LongDesc();
+        return GetPkgRecords()->Lookup(df).LongDesc();
     }
 }
 
@@ -456,6 +523,58 @@ std::string AptCacheFile::getLongDescriptionParsed(const pkgCache::VerIterator &
     return debParser(getLongDescription(ver));
 }
 
+AptDetailsIndex* AptCacheFile::detailsIndex()
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_indexMutex);
+
+    // jobs sharing the cache wait for the first one to build it
+    if (m_detailsIndex == nullptr) {
+        pk_backend_job_set_status(job(), PK_STATUS_ENUM_GENERATE_PACKAGE_LIST);
+        m_detailsIndex = new AptDetailsIndex(this);
+        pk_backend_job_set_status(job(), PK_STATUS_ENUM_QUERY);
+    }
+    return m_detailsIndex;
+}
+
+AptNameIndex* AptCacheFile::nameIndex()
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_indexMutex);
+
+    if (m_nameIndex == nullptr) {
+        m_nameIndex = new AptNameIndex(this);
+    }
+    return m_nameIndex;
+}
+
+AptProvidesIndex* AptCacheFile::providesIndex()
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_indexMutex);
+
+    if (m_providesIndex == nullptr) {
+        pk_backend_job_set_status(job(), PK_STATUS_ENUM_GENERATE_PACKAGE_LIST);
+        m_providesIndex = new AptProvidesIndex(this);
+        pk_backend_job_set_status(job(), PK_STATUS_ENUM_QUERY);
+    }
+    return m_providesIndex;
+}
+
+guint16 AptCacheFile::versionFlags(const pkgCache::VerIterator &ver) const
+{
+    if (ver.end() || ver->ID >= m_versionCount) {
+        return 0;
+    }
+    return m_versionFlags[ver->ID].load(std::memory_order_relaxed);
+}
+
+void AptCacheFile::setVersionFlags(const pkgCache::VerIterator &ver, guint16 flags)
+{
+    if (ver.end() || ver->ID >= m_versionCount) {
+        return;
+    }
+    // jobs sharing the cache compute the same flags, any write wins
+    m_versionFlags[ver->ID].store(flags, std::memory_order_relaxed);
+}
+
 bool AptCacheFile::tryToInstall(pkgProblemResolver &Fix,
                                 const pkgCache::VerIterator &ver,
                                 bool BrokenFix,
@@ -469,7 +588,7 @@ bool AptCacheFile::tryToInstall(pkgProblemResolver &Fix,
     pkgDepCache::StateCache &State = (*this)[Pkg];
 
     if (State.CandidateVer == 0) {
-        pk_backend_job_error_code(m_job,
+        pk_backend_job_error_code(job(),
                                   PK_ERROR_ENUM_DEP_RESOLUTION_FAILED,
                                   "Package %s is virtual and has no installation candidate",
                                   Pkg.Name());
@@ -564,6 +683,138 @@ std::string AptCacheFile::debParser(std::string descr)
     return descr;
 }
 
+AptSharedCache::AptSharedCache() :
+    m_invalid(FALSE)
+{
+    m_current.cache = nullptr;
+    m_current.users = 0;
+    m_readers = 0;
+    m_writing = false;
+    m_writersWaiting = 0;
+    g_mutex_init(&m_mutex);
+    g_mutex_init(&m_gateMutex);
+    g_cond_init(&m_gateCond);
+}
+
+AptSharedCache::~AptSharedCache()
+{
+    delete m_current.cache;
+    for (const Entry &entry : m_retired) {
+        delete entry.cache;
+    }
+    g_mutex_clear(&m_mutex);
+    g_mutex_clear(&m_gateMutex);
+    g_cond_clear(&m_gateCond);
+}
+
+AptCacheFile* AptSharedCache::acquire(PkBackendJob *job)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_mutex);
+
+    // The status or the lists changed, a cache still in use is
+    // deleted by the last release()
+    if (g_atomic_int_compare_and_exchange(&m_invalid, TRUE, FALSE) &&
+            m_current.cache != nullptr) {
+        if (m_current.users > 0) {
+            m_retired.push_back(m_current);
+        } else {
+            delete m_current.cache;
+        }
+        m_current.cache = nullptr;
+        m_current.users = 0;
+    }
+
+    if (m_current.cache == nullptr) {
+        AptCacheFile *cache = new AptCacheFile(job, true);
+        if (cache->Open(false) == false) {
+            show_errors(job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+            delete cache;
+            return nullptr;
+        }
+
+        // Check if there are half-installed packages and if we can fix them
+        if (cache->CheckDeps(false) == false) {
+            delete cache;
+            return nullptr;
+        }
+        m_current.cache = cache;
+    }
+
+    m_current.cache->setJob(job);
+    m_current.users++;
+    return m_current.cache;
+}
+
+void AptSharedCache::release(AptCacheFile *cache)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_mutex);
+
+    if (cache == m_current.cache) {
+        m_current.users--;
+        return;
+    }
+
+    for (auto it = m_retired.begin(); it != m_retired.end(); ++it) {
+        if (it->cache != cache) {
+            continue;
+        }
+        if (--it->users == 0) {
+            delete it->cache;
+            m_retired.erase(it);
+        }
+        return;
+    }
+}
+
+void AptSharedCache::invalidate()
+{
+    g_atomic_int_set(&m_invalid, TRUE);
+}
+
+void AptSharedCache::lockRead(PkBackendJob *job)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_gateMutex);
+
+    // Waiting writers go first, so queries can't starve them
+    if (m_writing || m_writersWaiting > 0) {
+        pk_backend_job_set_status(job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+        while (m_writing || m_writersWaiting > 0) {
+            g_cond_wait(&m_gateCond, &m_gateMutex);
+        }
+    }
+    m_readers++;
+}
+
+void AptSharedCache::unlockRead()
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_gateMutex);
+    if (--m_readers == 0) {
+        g_cond_broadcast(&m_gateCond);
+    }
+}
+
+void AptSharedCache::lockWrite(PkBackendJob *job)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_gateMutex);
+
+    if (m_writing || m_readers > 0) {
+        pk_backend_job_set_status(job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+        m_writersWaiting++;
+        while (m_writing || m_readers > 0) {
+            g_cond_wait(&m_gateCond, &m_gateMutex);
+        }
+        m_writersWaiting--;
+    }
+    m_writing = true;
+}
+
+void AptSharedCache::unlockWrite()
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_gateMutex);
+    m_writing = false;
+    g_cond_broadcast(&m_gateCond);
+}
+
 OpPackageKitProgress::OpPackageKitProgress(PkBackendJob *job) :
     m_job(job)
 {
@@ -27,11 +27,22 @@
 #include <apt-pkg/progress.h>
 #include <pk-backend.h>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 class pkgProblemResolver;
+class AptDetailsIndex;
+class AptNameIndex;
+class AptProvidesIndex;
 class AptCacheFile : public pkgCacheFile
 {
 public:
-    AptCacheFile(PkBackendJob *job);
+    /**
+      * @param shared whether the cache is used by several jobs at once,
+      * progress and errors then go to the job of the calling thread
+      */
+    AptCacheFile(PkBackendJob *job, bool shared = false);
     ~AptCacheFile();
 
     /**
@@ -69,7 +80,15 @@ public:
      */
     void ShowBroken(bool Now, PkErrorEnum error = PK_ERROR_ENUM_DEP_RESOLUTION_FAILED);
 
-    inline pkgRecords* GetPkgRecords() { buildPkgRecords(); return m_packageRecords; }
+    /**
+      * Returns the record parser, a shared cache has one per thread
+      */
+    pkgRecords* GetPkgRecords();
+
+    /**
+      * Sets the job that progress and errors are reported to
+      */
+    void setJob(PkBackendJob *job);
 
     /**
       * GetPolicy will build the policy object if needed and return it
@@ -142,12 +161,109 @@ public:
     void tryToRemove(pkgProblemResolver &Fix,
                      const pkgCache::VerIterator &ver);
 
+    /**
+      * Returns the word index over package names and descriptions,
+      * loading or building it on first use
+      */
+    AptDetailsIndex* detailsIndex();
+
+    /**
+      * Returns the substring index over package names, building it on
+      * first use
+      */
+    AptNameIndex* nameIndex();
+
+    /**
+      * Returns the codec and MIME type index for WhatProvides, building
+      * it on first use
+      */
+    AptProvidesIndex* providesIndex();
+
+    /**
+      * Returns the filter flags stored for the version, 0 if there are
+      * none yet, see AptIntf::versionFlags()
+      */
+    guint16 versionFlags(const pkgCache::VerIterator &ver) const;
+
+    /**
+      * Stores the filter flags of the version until the cache is closed
+      */
+    void setVersionFlags(const pkgCache::VerIterator &ver, guint16 flags);
+
 private:
     void buildPkgRecords();
+    PkBackendJob* job() const;
     static std::string debParser(std::string descr);
 
     pkgRecords *m_packageRecords;
     PkBackendJob *m_job;
+    bool m_shared;
+    AptDetailsIndex *m_detailsIndex;
+    AptNameIndex *m_nameIndex;
+    AptProvidesIndex *m_providesIndex;
+    GMutex m_indexMutex;
+    std::unique_ptr<std::atomic<guint16>[]> m_versionFlags;
+    guint32 m_versionCount;
+};
+
+/**
+ * Keeps one read-only AptCacheFile open between jobs, so queries don't
+ * have to open and check the whole cache every time
+ */
+class AptSharedCache
+{
+public:
+    AptSharedCache();
+    ~AptSharedCache();
+
+    /**
+      * Returns the shared cache, opening it for the given job if needed
+      * @returns nullptr if the cache could not be opened, the error is
+      * already reported to the job
+      * @note the cache must be given back with release()
+      */
+    AptCacheFile* acquire(PkBackendJob *job);
+
+    /**
+      * Gives back a cache returned by acquire()
+      */
+    void release(AptCacheFile *cache);
+
+    /**
+      * Drops the cache once nobody uses it anymore, called when the
+      * dpkg status or the package lists change
+      */
+    void invalidate();
+
+    /**
+      * Waits until no job is changing the system, any number of jobs
+      * may read it at the same time
+      */
+    void lockRead(PkBackendJob *job);
+    void unlockRead();
+
+    /**
+      * Waits until the job is the only one using the system
+      */
+    void lockWrite(PkBackendJob *job);
+    void unlockWrite();
+
+private:
+    struct Entry {
+        AptCacheFile *cache;
+        guint users;
+    };
+
+    Entry m_current;
+    std::vector<Entry> m_retired;
+    gint m_invalid;
+    GMutex m_mutex;
+
+    guint m_readers;
+    bool m_writing;
+    guint m_writersWaiting;
+    GMutex m_gateMutex;
+    GCond m_gateCond;
 };
 
 /**
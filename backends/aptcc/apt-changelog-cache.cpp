@@ -0,0 +1,152 @@
+/* apt-changelog-cache.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "apt-changelog-cache.h"
+
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <glib/gstdio.h>
+
+#include "apt-cache-file.h"
+
+using std::string;
+
+#define APT_CHANGELOG_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+
+AptChangelogCache::AptChangelogCache(const string &cacheDir) :
+    m_cacheDir(cacheDir)
+{
+    g_mutex_init(&m_mutex);
+}
+
+AptChangelogCache::~AptChangelogCache()
+{
+    g_mutex_clear(&m_mutex);
+}
+
+string AptChangelogCache::path(AptCacheFile *cache, const pkgCache::VerIterator &ver) const
+{
+    pkgRecords::Parser &rec = cache->GetPkgRecords()->Lookup(ver.FileList());
+    string srcpkg = rec.SourcePkg().empty() ? ver.ParentPkg().Name() : rec.SourcePkg();
+    string srcver = rec.SourceVer().empty() ? ver.VerStr() : rec.SourceVer();
+
+    // epochs are the only thing in a version not to put in a file name
+    string name = srcpkg + "_";
+    for (char c : srcver) {
+        if (c == ':') {
+            name += "%3a";
+        } else {
+            name += c;
+        }
+    }
+
+    return m_cacheDir + "/" + name + ".changelog";
+}
+
+void AptChangelogCache::fetch(AptCacheFile *cache, const PkgList &pkgs, pkgAcquireStatus *status)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_mutex);
+
+    const string partialDir = m_cacheDir + "/partial/";
+    if (g_mkdir_with_parents(partialDir.c_str(), 0755) != 0) {
+        g_warning("Failed to create %s: %s", partialDir.c_str(), g_strerror(errno));
+        return;
+    }
+    prune();
+
+    pkgAcquire fetcher;
+    fetcher.SetLog(status);
+
+    // queue each source version once, however many binaries it built
+    std::set<string> queued;
+    std::vector<std::pair<pkgAcqChangelog*, string>> items;
+    for (const pkgCache::VerIterator &ver : pkgs) {
+        const string file = path(cache, ver);
+        if (!queued.insert(file).second) {
+            continue;
+        }
+
+        if (FileExists(file)) {
+            // still in use, keep it from being pruned
+            utimes(file.c_str(), NULL);
+            continue;
+        }
+
+        pkgAcqChangelog *item = new pkgAcqChangelog(&fetcher, ver, partialDir, flNotDir(file));
+        items.push_back(std::make_pair(item, file));
+    }
+
+    if (items.empty()) {
+        return;
+    }
+
+    // a changelog that is not published yet is not an error of the job,
+    // it gets a notice in place of the text
+    _error->PushToStack();
+    fetcher.Run();
+    _error->RevertToStack();
+
+    for (const auto &item : items) {
+        const string &destFile = item.first->DestFile;
+        if (item.first->Status == pkgAcquire::Item::StatDone) {
+            // copy rather than rename, local methods may hand out a link
+            // to the mirror instead of a file of our own
+            g_autofree gchar *contents = NULL;
+            gsize length;
+            if (g_file_get_contents(destFile.c_str(), &contents, &length, NULL) &&
+                    !g_file_set_contents(item.second.c_str(), contents, length, NULL)) {
+                g_warning("Failed to store the changelog in %s", item.second.c_str());
+            }
+        }
+        g_unlink(destFile.c_str());
+    }
+}
+
+void AptChangelogCache::prune()
+{
+    g_autoptr(GDir) dir = g_dir_open(m_cacheDir.c_str(), 0, NULL);
+    if (dir == NULL) {
+        return;
+    }
+
+    const time_t now = time(NULL);
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(name, ".changelog")) {
+            continue;
+        }
+
+        g_autofree gchar *file = g_build_filename(m_cacheDir.c_str(), name, NULL);
+        struct stat st;
+        if (stat(file, &st) == 0 && now - st.st_mtime > APT_CHANGELOG_CACHE_MAX_AGE) {
+            g_unlink(file);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/* apt-changelog-cache.h
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef APT_CHANGELOG_CACHE_H
+#define APT_CHANGELOG_CACHE_H
+
+#include <glib.h>
+
+#include <apt-pkg/acquire.h>
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+
+#include "pkg-list.h"
+
+#define APT_CHANGELOG_CACHE_DIR "/var/cache/PackageKit/aptcc/changelogs"
+
+class AptCacheFile;
+
+/**
+ * Keeps downloaded changelogs on disk between runs
+ *
+ * Changelogs are stored by source package and version, so binaries
+ * built from the same source share one file and a version is only
+ * downloaded once. Files that were not used for a month are removed.
+ */
+class AptChangelogCache
+{
+public:
+    AptChangelogCache(const std::string &cacheDir = APT_CHANGELOG_CACHE_DIR);
+    ~AptChangelogCache();
+
+    /**
+      * Returns the file the changelog of ver is kept in, it only exists
+      * once the changelog was fetched
+      */
+    std::string path(AptCacheFile *cache, const pkgCache::VerIterator &ver) const;
+
+    /**
+      * Downloads the changelogs of the versions that are not cached yet,
+      * all of them queued on one fetcher
+      */
+    void fetch(AptCacheFile *cache, const PkgList &pkgs, pkgAcquireStatus *status);
+
+private:
+    void prune();
+
+    std::string m_cacheDir;
+    GMutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,427 @@
+/* apt-file-index.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "apt-file-index.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+#include <dirent.h>
+#include <regex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+using std::string;
+using std::vector;
+
+#define APT_FILE_INDEX_HEADER "PackageKit-APTcc file index 1"
+#define APT_FILE_INDEX_RACY_NSEC G_GINT64_CONSTANT(2000000000)
+
+static gint64 mtime_of(const struct stat &st)
+{
+    return (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec;
+}
+
+static string basename_of(const string &path)
+{
+    return path.substr(path.rfind('/') + 1);
+}
+
+static bool has_suffix(const string &str, const string &suffix)
+{
+    return str.size() >= suffix.size() &&
+            str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+AptFileIndex::AptFileIndex(const string &infoDir, const string &indexFile) :
+    m_infoDir(infoDir),
+    m_indexFile(indexFile),
+    m_suffixesDirty(true),
+    m_loaded(false),
+    m_scanned(false),
+    m_infoDirMtime(0)
+{
+    g_mutex_init(&m_mutex);
+}
+
+AptFileIndex::~AptFileIndex()
+{
+    g_mutex_clear(&m_mutex);
+}
+
+vector<string> AptFileIndex::search(gchar **values, const bool *cancel)
+{
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&m_mutex);
+    vector<const string*> owners;
+
+    if (!m_loaded) {
+        // a missing or outdated index is simply rebuilt by update()
+        m_loaded = true;
+        if (!load()) {
+            m_packages.clear();
+            m_paths.clear();
+            m_basenames.clear();
+            m_suffixesDirty = true;
+        }
+    }
+
+    if (update(cancel) && !save()) {
+        g_debug("Failed to save the file index to %s", m_indexFile.c_str());
+    }
+
+    for (uint i = 0; i < g_strv_length(values); ++i) {
+        const string value(values[i]);
+        if (value.empty()) {
+            continue;
+        }
+
+        if (value.find_first_of("^$*[\\") != string::npos) {
+            // callers used to be able to pass basic regular expressions,
+            // so "g++" or "libstdc++.so.6" are plain names
+            searchRegex(value, owners);
+        } else if (value[0] == '/') {
+            auto it = m_paths.find(value);
+            if (it != m_paths.end()) {
+                owners.insert(owners.end(), it->second.begin(), it->second.end());
+            }
+        } else if (value.find('/') != string::npos) {
+            // the part after the last slash has to be a whole base name
+            auto it = m_basenames.find(basename_of(value));
+            if (it == m_basenames.end()) {
+                continue;
+            }
+            for (const string *path : it->second) {
+                if (has_suffix(*path, value)) {
+                    addOwners(*path, owners);
+                }
+            }
+        } else {
+            searchSuffix(value, owners);
+        }
+    }
+
+    std::set<string> names;
+    for (const string *owner : owners) {
+        names.insert(*owner);
+    }
+    return vector<string>(names.begin(), names.end());
+}
+
+bool AptFileIndex::update(const bool *cancel)
+{
+    struct stat st;
+
+    // dpkg replaces the .list files by renaming them into place, so
+    // nothing changed if the directory itself did not
+    if (g_stat(m_infoDir.c_str(), &st) != 0) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+    const gint64 infoDirMtime = mtime_of(st);
+    if (m_scanned && infoDirMtime == m_infoDirMtime) {
+        return false;
+    }
+
+    DIR *dp = opendir(m_infoDir.c_str());
+    if (dp == NULL) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+
+    bool changed = false;
+    std::set<string> seen;
+    vector<string> files;
+    string line;
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != NULL) {
+        if (cancel != nullptr && *cancel) {
+            break;
+        }
+
+        string name(dirp->d_name);
+        if (!has_suffix(name, ".list")) {
+            continue;
+        }
+
+        const string fileName = m_infoDir + "/" + name;
+        name.erase(name.size() - 5);
+        if (g_stat(fileName.c_str(), &st) != 0) {
+            continue;
+        }
+        seen.insert(name);
+
+        auto it = m_packages.find(name);
+        if (it != m_packages.end() &&
+                it->second.mtime == mtime_of(st) &&
+                it->second.size == (gint64) st.st_size) {
+            continue;
+        }
+
+        std::ifstream in(fileName.c_str());
+        if (!in) {
+            continue;
+        }
+        files.clear();
+        while (getline(in, line)) {
+            if (!line.empty()) {
+                files.push_back(line);
+            }
+        }
+
+        if (it != m_packages.end()) {
+            removePackage(it);
+        }
+        addPackage(name, mtime_of(st), st.st_size, files);
+        changed = true;
+    }
+    closedir(dp);
+
+    // a cancelled scan leaves the index usable but incomplete, the
+    // next search picks up where it stopped
+    if (cancel != nullptr && *cancel) {
+        return changed;
+    }
+
+    for (auto it = m_packages.begin(); it != m_packages.end();) {
+        if (seen.find(it->first) == seen.end()) {
+            removePackage(it++);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    // the directory can still change within the same timestamp tick,
+    // only trust its mtime once it is old enough
+    m_infoDirMtime = infoDirMtime;
+    m_scanned = g_get_real_time() * 1000 - infoDirMtime > APT_FILE_INDEX_RACY_NSEC;
+    return changed;
+}
+
+bool AptFileIndex::load()
+{
+    std::ifstream in(m_indexFile.c_str());
+    if (!in) {
+        return false;
+    }
+
+    string line;
+    if (!getline(in, line) || line != APT_FILE_INDEX_HEADER) {
+        g_debug("Ignoring file index %s, unknown format", m_indexFile.c_str());
+        return false;
+    }
+
+    // @name mtime size, followed by the files of the package
+    string name;
+    gint64 mtime = 0;
+    gint64 size = 0;
+    vector<string> files;
+    while (getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] != '@') {
+            if (name.empty()) {
+                return false;
+            }
+            files.push_back(line);
+            continue;
+        }
+
+        if (!name.empty()) {
+            addPackage(name, mtime, size, files);
+        }
+        files.clear();
+
+        gchar **parts = g_strsplit(line.c_str() + 1, " ", -1);
+        if (g_strv_length(parts) != 3) {
+            g_strfreev(parts);
+            return false;
+        }
+        name = parts[0];
+        mtime = g_ascii_strtoll(parts[1], NULL, 10);
+        size = g_ascii_strtoll(parts[2], NULL, 10);
+        g_strfreev(parts);
+    }
+    if (!name.empty()) {
+        addPackage(name, mtime, size, files);
+    }
+
+    return true;
+}
+
+bool AptFileIndex::save() const
+{
+    g_autofree gchar *dir = g_path_get_dirname(m_indexFile.c_str());
+    if (g_mkdir_with_parents(dir, 0755) != 0) {
+        return false;
+    }
+
+    // write a new file and move it over the old one, readers never
+    // see a partial index
+    const string tmpFile = m_indexFile + ".new";
+    {
+        std::ofstream out(tmpFile.c_str(), std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        out << APT_FILE_INDEX_HEADER << '\n';
+        for (const auto &pkg : m_packages) {
+            out << '@' << pkg.first << ' ' << pkg.second.mtime << ' ' << pkg.second.size << '\n';
+            for (const string *file : pkg.second.files) {
+                out << *file << '\n';
+            }
+        }
+
+        out.flush();
+        if (!out) {
+            g_unlink(tmpFile.c_str());
+            return false;
+        }
+    }
+
+    if (g_rename(tmpFile.c_str(), m_indexFile.c_str()) != 0) {
+        g_unlink(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void AptFileIndex::addPackage(const string &name, gint64 mtime, gint64 size,
+                              const vector<string> &files)
+{
+    auto pkg = m_packages.emplace(name, Package{mtime, size, {}}).first;
+    const string *owner = &pkg->first;
+
+    pkg->second.files.reserve(files.size());
+    for (const string &file : files) {
+        auto path = m_paths.emplace(file, vector<const string*>()).first;
+        if (path->second.empty()) {
+            auto base = m_basenames.emplace(basename_of(file), vector<const string*>());
+            base.first->second.push_back(&path->first);
+            if (base.second) {
+                m_suffixesDirty = true;
+            }
+        }
+
+        if (std::find(path->second.begin(), path->second.end(), owner) == path->second.end()) {
+            path->second.push_back(owner);
+            pkg->second.files.push_back(&path->first);
+        }
+    }
+}
+
+void AptFileIndex::removePackage(std::map<string, Package>::iterator it)
+{
+    const string *owner = &it->first;
+
+    for (const string *file : it->second.files) {
+        auto path = m_paths.find(*file);
+        if (path == m_paths.end()) {
+            continue;
+        }
+
+        vector<const string*> &owners = path->second;
+        owners.erase(std::remove(owners.begin(), owners.end(), owner), owners.end());
+        if (!owners.empty()) {
+            continue;
+        }
+
+        // nobody owns the file anymore
+        auto base = m_basenames.find(basename_of(path->first));
+        if (base != m_basenames.end()) {
+            vector<const string*> &paths = base->second;
+            paths.erase(std::remove(paths.begin(), paths.end(), &path->first), paths.end());
+            if (paths.empty()) {
+                m_basenames.erase(base);
+                m_suffixesDirty = true;
+            }
+        }
+        m_paths.erase(path);
+    }
+
+    m_packages.erase(it);
+}
+
+void AptFileIndex::addOwners(const string &path, vector<const string*> &owners) const
+{
+    auto it = m_paths.find(path);
+    if (it != m_paths.end()) {
+        owners.insert(owners.end(), it->second.begin(), it->second.end());
+    }
+}
+
+void AptFileIndex::searchSuffix(const string &value, vector<const string*> &owners)
+{
+    if (m_suffixesDirty) {
+        m_suffixes.clear();
+        m_suffixes.reserve(m_basenames.size());
+        for (const auto &base : m_basenames) {
+            m_suffixes.emplace_back(base.first.rbegin(), base.first.rend());
+        }
+        std::sort(m_suffixes.begin(), m_suffixes.end());
+        m_suffixesDirty = false;
+    }
+
+    // every base name ending with the value starts with it once reversed
+    const string reversed(value.rbegin(), value.rend());
+    for (auto it = std::lower_bound(m_suffixes.begin(), m_suffixes.end(), reversed);
+         it != m_suffixes.end() && it->compare(0, reversed.size(), reversed) == 0;
+         ++it) {
+        auto base = m_basenames.find(string(it->rbegin(), it->rend()));
+        if (base == m_basenames.end()) {
+            continue;
+        }
+        for (const string *path : base->second) {
+            addOwners(*path, owners);
+        }
+    }
+}
+
+void AptFileIndex::searchRegex(const string &value, vector<const string*> &owners) const
+{
+    regex_t re;
+    string pattern;
+
+    if (value[0] == '/') {
+        pattern.append("^");
+    }
+    pattern.append(value);
+    if (!has_suffix(value, "$") || has_suffix(value, "\\$")) {
+        pattern.append("$");
+    }
+
+    // a basic expression like before, where '+' and '|' are no operators
+    if (regcomp(&re, pattern.c_str(), REG_NOSUB) != 0) {
+        g_debug("Regex compilation error");
+        return;
+    }
+
+    for (const auto &path : m_paths) {
+        if (regexec(&re, path.first.c_str(), (size_t)0, NULL, 0) == 0) {
+            owners.insert(owners.end(), path.second.begin(), path.second.end());
+        }
+    }
+    regfree(&re);
+}
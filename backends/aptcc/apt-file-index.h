@@ -0,0 +1,92 @@
+/* apt-file-index.h
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef APT_FILE_INDEX_H
+#define APT_FILE_INDEX_H
+
+#include <glib.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define APT_FILE_INDEX_INFO_DIR "/var/lib/dpkg/info"
+#define APT_FILE_INDEX_FILE     "/var/cache/PackageKit/aptcc/files.idx"
+
+/**
+ * Maps the files installed by dpkg to the packages owning them
+ *
+ * The index is built from the .list files in the dpkg info directory
+ * and kept on disk between runs. Before each search only the .list
+ * files whose mtime or size changed are read again.
+ */
+class AptFileIndex
+{
+public:
+    AptFileIndex(const std::string &infoDir = APT_FILE_INDEX_INFO_DIR,
+                 const std::string &indexFile = APT_FILE_INDEX_FILE);
+    ~AptFileIndex();
+
+    /**
+      * Returns the names of the packages owning a file that matches one
+      * of the values, absolute paths must match the whole file name,
+      * anything else matches its end (e.g. "ls" or "bin/ls")
+      * @param cancel checked while the index is brought up to date
+      */
+    std::vector<std::string> search(gchar **values, const bool *cancel = nullptr);
+
+private:
+    struct Package {
+        gint64 mtime;
+        gint64 size;
+        std::vector<const std::string*> files;
+    };
+
+    bool update(const bool *cancel);
+    bool load();
+    bool save() const;
+
+    void addPackage(const std::string &name, gint64 mtime, gint64 size,
+                    const std::vector<std::string> &files);
+    void removePackage(std::map<std::string, Package>::iterator it);
+    void addOwners(const std::string &path, std::vector<const std::string*> &owners) const;
+    void searchSuffix(const std::string &value, std::vector<const std::string*> &owners);
+    void searchRegex(const std::string &value, std::vector<const std::string*> &owners) const;
+
+    std::string m_infoDir;
+    std::string m_indexFile;
+
+    // package name -> .list file state and files
+    std::map<std::string, Package> m_packages;
+    // file path -> owning package names
+    std::unordered_map<std::string, std::vector<const std::string*>> m_paths;
+    // base name -> file paths
+    std::unordered_map<std::string, std::vector<const std::string*>> m_basenames;
+    // reversed base names, sorted for suffix lookups
+    std::vector<std::string> m_suffixes;
+    bool m_suffixesDirty;
+
+    bool m_loaded;
+    bool m_scanned;
+    gint64 m_infoDirMtime;
+    GMutex m_mutex;
+};
+
+#endif
@@ -35,12 +35,12 @@
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/version.h>
 
-#include <appstream.h>
-
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
 #include <sys/wait.h>
 #include <sys/fcntl.h>
+#include <locale.h>
+#include <poll.h>
 #include <pty.h>
 
 #include <iostream>
@@ -49,6 +49,10 @@
 #include <dirent.h>
 
 #include "apt-cache-file.h"
+#include "apt-changelog-cache.h"
+#include "apt-file-index.h"
+#include "apt-provides-index.h"
+#include "apt-search-index.h"
 #include "apt-utils.h"
 #include "gst-matcher.h"
 #include "apt-messages.h"
@@ -59,8 +63,43 @@ using namespace APT;
 
 #define RAMFS_MAGIC     0x858458f6
 
-AptIntf::AptIntf(PkBackendJob *job) :
+// The locale a query switched its thread to, see AptIntf::init(). The
+// AptIntf is deleted on the main loop, so the job thread restores and
+// frees it itself when it exits.
+struct ThreadLocale
+{
+    locale_t locale = (locale_t) 0;
+
+    void use(locale_t newLocale)
+    {
+        reset();
+        locale = newLocale;
+        uselocale(locale);
+    }
+
+    void reset()
+    {
+        if (locale != (locale_t) 0) {
+            uselocale(LC_GLOBAL_LOCALE);
+            freelocale(locale);
+            locale = (locale_t) 0;
+        }
+    }
+
+    ~ThreadLocale()
+    {
+        reset();
+    }
+};
+
+static thread_local ThreadLocale threadLocale;
+
+AptIntf::AptIntf(PkBackendJob *job, AptSharedCache *sharedCache) :
     m_cache(0),
+    m_sharedCache(sharedCache),
+    m_cacheShared(false),
+    m_gate(GateNone),
+    m_writes(false),
     m_job(job),
     m_cancel(false),
     m_lastSubProgress(0),
@@ -71,28 +110,8 @@ AptIntf::AptIntf(PkBackendJob *job) :
 
 bool AptIntf::init(gchar **localDebs)
 {
-    const gchar *http_proxy;
-    const gchar *ftp_proxy;
-
     m_isMultiArch = APT::Configuration::getArchitectures(false).size() > 1;
 
-    // set locale
-    setEnvLocaleFromJob();
-
-    // set http proxy
-    http_proxy = pk_backend_job_get_proxy_http(m_job);
-    if (http_proxy != NULL) {
-        g_autofree gchar *uri = pk_backend_convert_uri(http_proxy);
-        g_setenv("http_proxy", uri, TRUE);
-    }
-
-    // set ftp proxy
-    ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
-    if (ftp_proxy != NULL) {
-        g_autofree gchar *uri = pk_backend_convert_uri(ftp_proxy);
-        g_setenv("ftp_proxy", uri, TRUE);
-    }
-
     // Check if we should open the Cache with lock
     bool withLock;
     bool AllowBroken = false;
@@ -121,6 +140,40 @@ bool AptIntf::init(gchar **localDebs)
         withLock = !simulate;
     }
 
+    lockGate();
+
+    // Only change the process locale and environment while nobody reads them
+    if (m_gate == GateRead) {
+        const gchar *locale = pk_backend_job_get_locale(m_job);
+        if (locale != NULL) {
+            locale_t threadLocaleNew = newlocale(LC_ALL_MASK, locale, (locale_t) 0);
+            if (threadLocaleNew != (locale_t) 0) {
+                threadLocale.use(threadLocaleNew);
+            }
+        }
+    } else {
+        setEnvLocaleFromJob();
+        setProxiesFromJob();
+    }
+
+    m_interactive = pk_backend_job_get_interactive(m_job);
+    if (!m_interactive && m_writes) {
+        // Do not ask about config updates if we are not interactive,
+        // the config is only changed while nobody else reads it
+        _config->Set("Dpkg::Options::", "--force-confdef");
+        _config->Set("Dpkg::Options::", "--force-confold");
+        // Ensure nothing interferes with questions
+        setEnv("APT_LISTCHANGES_FRONTEND", "none");
+        setEnv("APT_LISTBUGS_FRONTEND", "none");
+    }
+
+    // Queries borrow the cache the backend keeps open
+    if (localDebs == nullptr && canShareCache()) {
+        m_cache = m_sharedCache->acquire(m_job);
+        m_cacheShared = m_cache != nullptr;
+        return m_cacheShared;
+    }
+
     // Create the AptCacheFile class to search for packages
     m_cache = new AptCacheFile(m_job);
     if (localDebs) {
@@ -155,26 +208,115 @@ bool AptIntf::init(gchar **localDebs)
         m_cache->Close();
     }
 
-    // default settings
-    _config->CndSet("APT::Get::AutomaticRemove::Kernels", _config->FindB("APT::Get::AutomaticRemove", true));
-
-    m_interactive = pk_backend_job_get_interactive(m_job);
-    if (!m_interactive) {
-        // Do not ask about config updates if we are not interactive
-        _config->Set("Dpkg::Options::", "--force-confdef");
-        _config->Set("Dpkg::Options::", "--force-confold");
-        // Ensure nothing interferes with questions
-        g_setenv("APT_LISTCHANGES_FRONTEND", "none", TRUE);
-        g_setenv("APT_LISTBUGS_FRONTEND", "none", TRUE);
-    }
-
     // Check if there are half-installed packages and if we can fix them
     return m_cache->CheckDeps(AllowBroken);
 }
 
 AptIntf::~AptIntf()
 {
-    delete m_cache;
+    if (m_cacheShared) {
+        m_sharedCache->release(m_cache);
+    } else {
+        delete m_cache;
+    }
+
+    if (m_gate == GateWrite) {
+        // queries waiting for us must not get the old cache
+        if (m_writes) {
+            m_sharedCache->invalidate();
+        }
+        m_sharedCache->unlockWrite();
+    } else if (m_gate == GateRead) {
+        m_sharedCache->unlockRead();
+    }
+}
+
+void AptIntf::lockGate()
+{
+    if (m_gate != GateNone) {
+        return;
+    }
+
+    // Jobs changing the system wait for all others, the rest run in parallel
+    PkRoleEnum role = pk_backend_job_get_role(m_job);
+    PkBitfield transactionFlags = pk_backend_job_get_transaction_flags(m_job);
+    bool simulate = pk_bitfield_contain(transactionFlags, PK_TRANSACTION_FLAG_ENUM_SIMULATE);
+    switch (role) {
+    case PK_ROLE_ENUM_INSTALL_PACKAGES:
+    case PK_ROLE_ENUM_INSTALL_FILES:
+    case PK_ROLE_ENUM_REMOVE_PACKAGES:
+    case PK_ROLE_ENUM_UPDATE_PACKAGES:
+    case PK_ROLE_ENUM_REPO_ENABLE:
+    case PK_ROLE_ENUM_REPO_REMOVE:
+        m_writes = !simulate;
+        break;
+    case PK_ROLE_ENUM_REPAIR_SYSTEM:
+    case PK_ROLE_ENUM_REFRESH_CACHE:
+        m_writes = true;
+        break;
+    default:
+        m_writes = false;
+    }
+
+    if (m_sharedCache == nullptr) {
+        return;
+    }
+    if (m_writes) {
+        m_sharedCache->lockWrite(m_job);
+        m_gate = GateWrite;
+    } else {
+        m_sharedCache->lockRead(m_job);
+        m_gate = GateRead;
+
+        // the environment is shared by the whole process, so a query
+        // wanting other proxies waits until it is alone to set them
+        if (proxiesChanged()) {
+            m_sharedCache->unlockRead();
+            m_sharedCache->lockWrite(m_job);
+            m_gate = GateWrite;
+        }
+    }
+}
+
+bool AptIntf::canShareCache() const
+{
+    if (m_sharedCache == nullptr) {
+        return false;
+    }
+
+    // Only roles which never mark anything in the depcache can share it
+    GVariant *params = pk_backend_job_get_parameters(m_job);
+    PkBitfield filters = PK_FILTER_ENUM_NONE;
+    switch (pk_backend_job_get_role(m_job)) {
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+        return true;
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+        // the downloaded filter marks packages for install
+        if (params != NULL && g_variant_n_children(params) > 0) {
+            g_autoptr(GVariant) child = g_variant_get_child_value(params, 0);
+            if (g_variant_is_of_type(child, G_VARIANT_TYPE_UINT64)) {
+                filters = g_variant_get_uint64(child);
+            }
+        }
+        return !pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED);
+    default:
+        return false;
+    }
+}
+
+bool AptIntf::usesSharedCache() const
+{
+    return m_cacheShared;
 }
 
 void AptIntf::setEnvLocaleFromJob()
@@ -183,12 +325,52 @@ void AptIntf::setEnvLocaleFromJob()
     if (locale == NULL)
         return;
 
-    // set daemon locale
+    // set daemon locale, only called while no other job runs
     setlocale(LC_ALL, locale);
 
     // processes spawned by APT need to inherit the right locale as well
-    g_setenv("LANG", locale, TRUE);
-    g_setenv("LANGUAGE", locale, TRUE);
+    setEnv("LANG", locale);
+    setEnv("LANGUAGE", locale);
+}
+
+void AptIntf::setEnv(const gchar *variable, const gchar *value)
+{
+    g_setenv(variable, value, TRUE);
+}
+
+void AptIntf::setProxiesFromJob()
+{
+    const gchar *http_proxy = pk_backend_job_get_proxy_http(m_job);
+    if (http_proxy != NULL) {
+        g_autofree gchar *uri = pk_backend_convert_uri(http_proxy);
+        setEnv("http_proxy", uri);
+    }
+
+    const gchar *ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
+    if (ftp_proxy != NULL) {
+        g_autofree gchar *uri = pk_backend_convert_uri(ftp_proxy);
+        setEnv("ftp_proxy", uri);
+    }
+}
+
+bool AptIntf::proxiesChanged() const
+{
+    const gchar *http_proxy = pk_backend_job_get_proxy_http(m_job);
+    if (http_proxy != NULL) {
+        g_autofree gchar *uri = pk_backend_convert_uri(http_proxy);
+        if (g_strcmp0(g_getenv("http_proxy"), uri) != 0) {
+            return true;
+        }
+    }
+
+    const gchar *ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
+    if (ftp_proxy != NULL) {
+        g_autofree gchar *uri = pk_backend_convert_uri(ftp_proxy);
+        if (g_strcmp0(g_getenv("ftp_proxy"), uri) != 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void AptIntf::cancel()
@@ -208,25 +390,23 @@ bool AptIntf::cancelled() const
     return m_cancel;
 }
 
-bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
+guint16 AptIntf::versionFlags(const pkgCache::VerIterator &ver, bool withApplication)
 {
-    if (filters != 0) {
+    guint16 flags = m_cache->versionFlags(ver);
+    const guint16 stored = flags;
+
+    if (!(flags & VersionFlagKnown)) {
         const pkgCache::PkgIterator &pkg = ver.ParentPkg();
-        bool installed = false;
+        flags |= VersionFlagKnown;
 
         // Check if the package is installed
         if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
-            installed = true;
+            flags |= VersionFlagInstalled;
         }
 
-        // if we are on multiarch check also the arch filter
-        if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)/* && !installed*/) {
-            // don't emit the package if it does not match
-            // the native architecture
-            if (strcmp(ver.Arch(), "all") != 0 &&
-                    strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) != 0) {
-                return false;
-            }
+        if (strcmp(ver.Arch(), "all") == 0 ||
+                strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) == 0) {
+            flags |= VersionFlagNativeArch;
         }
 
         std::string str = ver.Section() == NULL ? "" : ver.Section();
@@ -241,101 +421,137 @@ bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
             component = str.substr(0, found);
         }
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED) && installed) {
-            return false;
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED) && !installed) {
-            return false;
+        std::string pkgName = pkg.Name();
+        if (ends_with(pkgName, "-dev") ||
+                ends_with(pkgName, "-dbg") ||
+                !section.compare("devel") ||
+                !section.compare("libdevel")) {
+            flags |= VersionFlagDevel;
         }
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than devel
-            std::string pkgName = pkg.Name();
-            if (!ends_with(pkgName, "-dev") &&
-                    !ends_with(pkgName, "-dbg") &&
-                    section.compare("devel") &&
-                    section.compare("libdevel")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
-            std::string pkgName = pkg.Name();
-            if (ends_with(pkgName, "-dev") ||
-                    ends_with(pkgName, "-dbg") ||
-                    !section.compare("devel") ||
-                    !section.compare("libdevel")) {
-                return false;
-            }
+        if (!section.compare("x11") || !section.compare("gnome") ||
+                !section.compare("kde") || !section.compare("graphics")) {
+            flags |= VersionFlagGui;
         }
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than x11
-            if (section.compare("x11") && section.compare("gnome") &&
-                    section.compare("kde") && section.compare("graphics")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
-            if (!section.compare("x11") || !section.compare("gnome") ||
-                    !section.compare("kde") || !section.compare("graphics")) {
-                return false;
-            }
+        // Must be in main and universe to be free
+        if (component.compare("main") == 0 ||
+                component.compare("universe") == 0) {
+            flags |= VersionFlagFree;
         }
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
-            if (component.compare("main") != 0 &&
-                    component.compare("universe") != 0) {
-                // Must be in main and universe to be free
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
-            if (component.compare("main") == 0 ||
-                    component.compare("universe") == 0) {
-                // Must not be in main or universe to be free
-                return false;
-            }
+        if (packageIsSupported(ver, component)) {
+            flags |= VersionFlagSupported;
         }
+    }
 
-        // Check for supported packages
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
-            if (!packageIsSupported(ver, component)) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
-            if (packageIsSupported(ver, component)) {
-                return false;
-            }
+    // Check for applications, if they have files with .desktop
+    // We do not support checking if it is an Application if NOT installed
+    if (withApplication && !(flags & VersionFlagApplicationKnown)) {
+        flags |= VersionFlagApplicationKnown;
+        if ((flags & VersionFlagInstalled) && isApplication(ver)) {
+            flags |= VersionFlagApplication;
         }
+    }
 
-        // Check for applications, if they have files with .desktop
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || !isApplication(ver)) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || isApplication(ver)) {
-                return false;
-            }
+    if (flags != stored) {
+        m_cache->setVersionFlags(ver, flags);
+    }
+    return flags;
+}
+
+bool AptIntf::filterFlags(PkBitfield filters, guint16 &mask, guint16 &value) const
+{
+    bool possible = true;
+    auto require = [&](guint16 flag, bool set) {
+        if ((mask & flag) && ((value & flag) != 0) != set) {
+            possible = false;
+        }
+        mask |= flag;
+        if (set) {
+            value |= flag;
         }
+    };
+
+    mask = 0;
+    value = 0;
+
+    // if we are on multiarch check also the arch filter, don't emit
+    // the package if it does not match the native architecture
+    if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)) {
+        require(VersionFlagNativeArch, true);
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
+        require(VersionFlagInstalled, false);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED)) {
+        require(VersionFlagInstalled, true);
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
+        require(VersionFlagDevel, true);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
+        require(VersionFlagDevel, false);
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
+        require(VersionFlagGui, true);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
+        require(VersionFlagGui, false);
+    }
+
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
+        require(VersionFlagFree, true);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
+        require(VersionFlagFree, false);
+    }
 
-        // TODO test this one..
+    // Check for supported packages
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
+        require(VersionFlagSupported, true);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
+        require(VersionFlagSupported, false);
+    }
+
+    // Applications are only known for installed packages
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
+        require(VersionFlagInstalled, true);
+        require(VersionFlagApplication, true);
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
+        require(VersionFlagInstalled, true);
+        require(VersionFlagApplication, false);
+    }
+
+    // TODO test this one..
 #if 0
-        // I couldn'tfind any packages with the metapackages component, and I
-        // think the check is the wrong way around; PK_FILTER_ENUM_COLLECTIONS
-        // is for virtual group packages -- hughsie
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_COLLECTIONS)) {
-            if (!component.compare("metapackages")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_COLLECTIONS)) {
-            if (component.compare("metapackages")) {
-                return false;
-            }
+    // I couldn'tfind any packages with the metapackages component, and I
+    // think the check is the wrong way around; PK_FILTER_ENUM_COLLECTIONS
+    // is for virtual group packages -- hughsie
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_COLLECTIONS)) {
+        if (!component.compare("metapackages")) {
+            return false;
         }
+    } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_COLLECTIONS)) {
+        if (component.compare("metapackages")) {
+            return false;
+        }
+    }
 #endif
+
+    return possible;
+}
+
+bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
+{
+    if (filters != 0) {
+        guint16 mask;
+        guint16 value;
+        if (!filterFlags(filters, mask, value)) {
+            return false;
+        }
+
+        const guint16 flags = versionFlags(ver, mask & VersionFlagApplication);
+        return (flags & mask) == value;
     }
     return true;
 }
@@ -346,8 +562,16 @@ PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
         PkgList ret;
         ret.reserve(packages.size());
 
+        // The filters become a mask over the flags of each version
+        guint16 mask;
+        guint16 value;
+        if (!filterFlags(filters, mask, value)) {
+            return ret;
+        }
+
         for (const pkgCache::VerIterator &ver : packages) {
-            if (matchPackage(ver, filters)) {
+            const guint16 flags = versionFlags(ver, mask & VersionFlagApplication);
+            if ((flags & mask) == value) {
                 ret.push_back(ver);
             }
         }
@@ -524,49 +748,12 @@ void AptIntf::emitUpdates(PkgList &output, PkBitfield filters)
 // search packages which provide a codec (specified in "values")
 void AptIntf::providesCodec(PkgList &output, gchar **values)
 {
-    string arch;
     GstMatcher matcher(values);
     if (!matcher.hasMatches()) {
         return;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Ignore debug packages - these aren't interesting as codec providers,
-        // but they do have apt GStreamer-* metadata.
-        if (ends_with (pkg.Name(), "-dbg") || ends_with (pkg.Name(), "-dbgsym")) {
-            continue;
-        }
-
-        // TODO search in updates packages
-        // Ignore virtual packages
-        pkgCache::VerIterator ver = m_cache->findVer(pkg);
-        if (ver.end() == true) {
-            ver = m_cache->findCandidateVer(pkg);
-        }
-        if (ver.end() == true) {
-            continue;
-        }
-
-        arch = string(ver.Arch());
-
-        pkgCache::VerFileIterator vf = ver.FileList();
-        pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
-        const char *start, *stop;
-        rec.GetRec(start, stop);
-        string record(start, stop - start);
-        if (matcher.matches(record, arch)) {
-            output.push_back(ver);
-        }
-    }
+    m_cache->providesIndex()->codecs(matcher, output);
 }
 
 // search packages which provide the libraries specified in "values"
@@ -611,9 +798,18 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
                 libPkgName.append (strvalue.substr (pos + 4));
             }
 
+            // Make everything lower-case
+            std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
+
             g_debug ("pkg-name: %s", libPkgName.c_str ());
 
-            for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+            // the package of every architecture with that name
+            pkgCache::GrpIterator grp = (*m_cache)->FindGrp(libPkgName);
+            if (grp.end()) {
+                continue;
+            }
+
+            for (pkgCache::PkgIterator pkg = grp.PackageList(); !pkg.end(); pkg = grp.NextPkg(pkg)) {
                 // Ignore packages that exist only due to dependencies.
                 if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
                     continue;
@@ -628,17 +824,13 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
                     }
                 }
 
-                // Make everything lower-case
-                std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
-
-                if (g_strcmp0 (pkg.Name (), libPkgName.c_str ()) == 0) {
-                    output.push_back(ver);
-                }
+                output.push_back(ver);
             }
         } else {
             g_debug("libmatcher: Did not match: %s", value);
         }
     }
+    regfree(&libreg);
 }
 
 // Mostly copied from pkgAcqArchive.
@@ -787,7 +979,7 @@ void AptIntf::emitDetails(PkgList &pkgs)
 }
 
 // used to emit packages it collects all the needed info
-void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
+void AptIntf::emitUpdateDetail(AptChangelogCache *changelogs, const pkgCache::VerIterator &candver)
 {
     // Verify if our update version is valid
     if (candver.end()) {
@@ -818,24 +1010,16 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
         srcpkg = rec.SourcePkg();
     }
 
-    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
-    if (pk_backend_is_online(backend)) {
-        // Create the download object
-        AcqPackageKitStatus Stat(this, m_job);
-
-        // get a fetcher
-        pkgAcquire fetcher;
-        fetcher.SetLog(&Stat);
-
-        // fetch the changelog
-        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
-        changelog = fetchChangelogData(*m_cache,
-                                       fetcher,
-                                       candver,
-                                       currver,
-                                       &update_text,
-                                       &updated,
-                                       &issued);
+    // emitUpdateDetails already fetched it if we are online
+    const string changelogFile = changelogs->path(m_cache, candver);
+    if (FileExists(changelogFile) ||
+            pk_backend_is_online(PK_BACKEND(pk_backend_job_get_backend(m_job)))) {
+        changelog = parseChangelog(changelogFile,
+                                   srcpkg,
+                                   currver,
+                                   &update_text,
+                                   &updated,
+                                   &issued);
     }
 
     // Check if the update was updates since it was issued
@@ -908,14 +1092,24 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
     g_ptr_array_unref(cve_urls);
 }
 
-void AptIntf::emitUpdateDetails(const PkgList &pkgs)
+void AptIntf::emitUpdateDetails(AptChangelogCache *changelogs, const PkgList &pkgs)
 {
+    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
+    if (pk_backend_is_online(backend)) {
+        // Create the download object
+        AcqPackageKitStatus Stat(this, m_job);
+
+        // fetch all the missing changelogs at once
+        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
+        changelogs->fetch(m_cache, pkgs, &Stat);
+    }
+
     for (const pkgCache::VerIterator &verIt : pkgs) {
         if (m_cancel) {
             break;
         }
 
-        emitUpdateDetail(verIt);
+        emitUpdateDetail(changelogs, verIt);
     }
 }
 
@@ -952,33 +1146,49 @@ void AptIntf::getRequires(PkgList &output,
                           const pkgCache::VerIterator &ver,
                           bool recursive)
 {
-    for (pkgCache::PkgIterator parentPkg = m_cache->GetPkgCache()->PkgBegin(); !parentPkg.end(); ++parentPkg) {
+    // Packages already in the output are not walked again
+    vector<bool> visited(m_cache->GetPkgCache()->HeaderP->PackageCount, false);
+    if (recursive) {
+        for (const pkgCache::VerIterator &outputVer : output) {
+            visited[outputVer.ParentPkg()->ID] = true;
+        }
+    }
+
+    vector<pkgCache::VerIterator> pending = { ver };
+    while (!pending.empty()) {
         if (m_cancel) {
             break;
         }
 
-        // Ignore packages that exist only due to dependencies.
-        if (parentPkg.VersionList().end() && parentPkg.ProvidesList().end()) {
+        const pkgCache::VerIterator current = pending.back();
+        pending.pop_back();
+
+        // Dependencies resolve to the version we report for the package
+        if (m_cache->findVer(current.ParentPkg()) != current) {
             continue;
         }
 
-        // Don't insert virtual packages instead add what it provides
-        const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
-        if (parentVer.end() == false) {
-            PkgList deps;
-            getDepends(deps, parentVer, false);
-            for (const pkgCache::VerIterator &depVer : deps) {
-                if (depVer == ver) {
-                    if (recursive) {
-                        if (!output.contains(parentPkg)) {
-                            output.push_back(parentVer);
-                            getRequires(output, parentVer, recursive);
-                        }
-                    } else {
-                        output.push_back(parentVer);
-                    }
-                    break;
-                }
+        // Walk the dependencies naming the package instead of the whole cache
+        for (pkgCache::DepIterator dep = current.ParentPkg().RevDependsList(); !dep.end(); ++dep) {
+            if (dep->Type != pkgCache::Dep::Depends) {
+                continue;
+            }
+
+            const pkgCache::PkgIterator &parentPkg = dep.ParentPkg();
+            if (visited[parentPkg->ID]) {
+                continue;
+            }
+
+            // Only the dependencies of the version we report count
+            const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
+            if (parentVer.end() || parentVer != dep.ParentVer()) {
+                continue;
+            }
+
+            visited[parentPkg->ID] = true;
+            output.push_back(parentVer);
+            if (recursive) {
+                pending.push_back(parentVer);
             }
         }
     }
@@ -1108,8 +1318,8 @@ PkgList AptIntf::getPackagesFromGroup(gchar **values)
     return output;
 }
 
-bool AptIntf::matchesQueries(const vector<string> &queries, string s) {
-    for (string query : queries) {
+bool AptIntf::matchesQueries(const vector<string> &queries, const string &s) {
+    for (const string &query : queries) {
         // Case insensitive "string.contains"
         auto it = std::search(
             s.begin(), s.end(),
@@ -1129,6 +1339,7 @@ bool AptIntf::matchesQueries(const vector<string> &queries, string s) {
 PkgList AptIntf::searchPackageName(const vector<string> &queries)
 {
     PkgList output;
+    const vector<bool> matches = m_cache->nameIndex()->matches(queries);
 
     for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         if (m_cancel) {
@@ -1139,7 +1350,7 @@ PkgList AptIntf::searchPackageName(const vector<string> &queries)
             continue;
         }
 
-        if (matchesQueries(queries, pkg.Name())) {
+        if (pkg->ID < matches.size() && matches[pkg->ID]) {
             // Don't insert virtual packages instead add what it provides
             const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
             if (ver.end() == false) {
@@ -1166,10 +1377,16 @@ PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
 {
     PkgList output;
 
+    // Only read the descriptions of packages having the words of a query
+    const vector<bool> candidates = m_cache->detailsIndex()->candidates(queries);
+
     for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         if (m_cancel) {
             break;
         }
+        if (pkg->ID >= candidates.size() || !candidates[pkg->ID]) {
+            continue;
+        }
         // Ignore packages that exist only due to dependencies.
         if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
             continue;
@@ -1202,72 +1419,11 @@ PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
     return output;
 }
 
-// used to return files it reads, using the info from the files in /var/lib/dpkg/info/
-PkgList AptIntf::searchPackageFiles(gchar **values)
+// used to return files it reads, using the index built from the files in /var/lib/dpkg/info/
+PkgList AptIntf::searchPackageFiles(AptFileIndex *index, gchar **values)
 {
     PkgList output;
-    vector<string> packages;
-    string search;
-    regex_t re;
-
-    for (uint i = 0; i < g_strv_length(values); ++i) {
-        gchar *value = values[i];
-        if (strlen(value) < 1) {
-            continue;
-        }
-
-        if (!search.empty()) {
-            search.append("|");
-        }
-
-        if (value[0] == '/') {
-            search.append("^");
-            search.append(value);
-            search.append("$");
-        } else {
-            search.append(value);
-            search.append("$");
-        }
-    }
-
-    if(regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
-        return output;
-    }
-
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
-        regfree(&re);
-        return output;
-    }
-
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
-        if (m_cancel) {
-            break;
-        }
-
-        if (ends_with(dirp->d_name, ".list")) {
-            string file(dirp->d_name);
-            string f = "/var/lib/dpkg/info/" + file;
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
-            }
-
-            while (!in.eof()) {
-                getline(in, line);
-                if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
-                    break;
-                }
-            }
-        }
-    }
-    closedir(dp);
-    regfree(&re);
+    const vector<string> packages = index->search(values, &m_cancel);
 
     // Resolve the package names now
     for (const string &name : packages) {
@@ -1383,57 +1539,30 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades, PkgList &inst
 // used to return files it reads, using the info from the files in /var/lib/dpkg/info/
 void AptIntf::providesMimeType(PkgList &output, gchar **values)
 {
-    g_autoptr(AsPool) pool = NULL;
-    g_autoptr(GError) error = NULL;
-    guint i;
-    vector<string> packages;
-
-    pool = as_pool_new ();
-    as_pool_load (pool, NULL, &error);
-    if (error != NULL) {
-        /* we do not fail here because even with error we might still find metadata */
-        g_warning ("Issue while loading the AppStream metadata pool: %s", error->message);
-        g_error_free (error);
-        error = NULL;
-    }
-
-    for (i = 0; values[i] != NULL; i++) {
-        g_autoptr(GPtrArray) result = NULL;
-        guint j;
-        if (m_cancel)
-            break;
+    AptProvidesIndex *index = m_cache->providesIndex();
 
-        result = as_pool_get_components_by_provided_item (pool, AS_PROVIDED_KIND_MIMETYPE, values[i]);
-        for (j = 0; j < result->len; j++) {
-            AsComponent *cpt = AS_COMPONENT (g_ptr_array_index (result, j));
-            /* we only select one package per component - on Debian systems, AppStream components never reference multiple packages */
-            packages.push_back (as_component_get_pkgname (cpt));
-        }
-    }
-
-    /* resolve the package names */
-    for (const string &package : packages) {
+    for (guint i = 0; values[i] != NULL; i++) {
         if (m_cancel)
             break;
 
-        const pkgCache::PkgIterator &pkg = (*m_cache)->FindPkg(package);
-        if (pkg.end() == true)
-            continue;
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == true)
-            continue;
+        /* resolve the package names */
+        for (const string &package : index->mimeTypePackages(values[i])) {
+            const pkgCache::PkgIterator &pkg = (*m_cache)->FindPkg(package);
+            if (pkg.end() == true)
+                continue;
+            const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+            if (ver.end() == true)
+                continue;
 
-        output.push_back(ver);
+            output.push_back(ver);
+        }
     }
 
     /* check if we found nothing because AppStream data is missing completely */
-    if (output.empty()) {
-        g_autoptr(GPtrArray) all_cpts = as_pool_get_components (pool);
-        if (all_cpts->len <= 0) {
-            pk_backend_job_error_code(m_job,
-                                      PK_ERROR_ENUM_INTERNAL_ERROR,
-                                      "No AppStream metadata was found. This means we are unable to find any information for your request.");
-        }
+    if (output.empty() && !index->hasAppStreamData()) {
+        pk_backend_job_error_code(m_job,
+                                  PK_ERROR_ENUM_INTERNAL_ERROR,
+                                  "No AppStream metadata was found. This means we are unable to find any information for your request.");
     }
 }
 
@@ -1556,19 +1685,11 @@ bool AptIntf::packageIsSupported(const pkgCache::VerIterator &verIter, string co
         component = "main";
     }
 
-    // Get a fetcher
-    AcqPackageKitStatus Stat(this, m_job);
-    pkgAcquire fetcher;
-    fetcher.SetLog(&Stat);
-
-    PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
-    bool trusted = checkTrusted(fetcher, flags);
-
     if ((origin.compare("Debian") == 0) || (origin.compare("Ubuntu") == 0))  {
-        if ((component.compare("main") == 0 ||
-             component.compare("restricted") == 0 ||
-             component.compare("unstable") == 0 ||
-             component.compare("testing") == 0) && trusted) {
+        if (component.compare("main") == 0 ||
+                component.compare("restricted") == 0 ||
+                component.compare("unstable") == 0 ||
+                component.compare("testing") == 0) {
             return true;
         }
     }
@@ -1746,42 +1867,206 @@ pkgCache::VerIterator AptIntf::findTransactionPackage(const std::string &name)
 
 void AptIntf::updateInterface(int fd, int writeFd)
 {
-    char buf[2];
-    static char line[1024] = "";
-
-    while (1) {
-        // This algorithm should be improved (it's the same as the rpm one ;)
-        int len = read(fd, buf, 1);
-
-        // nothing was read
-        if(len < 1) {
-            break;
-        }
+    char buf[4096];
+    ssize_t len;
 
+    // read whatever is there, the caller polls for more
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
         // update the time we last saw some action
         m_lastTermAction = time(NULL);
 
-        if( buf[0] == '\n') {
+        m_statusParser.feed(buf, len, [this, writeFd](const AptStatusParser::Record &record) {
             if (m_cancel) {
                 kill(m_child_pid, SIGTERM);
             }
-            //cout << "got line: " << line << endl;
+            handleStatus(record, writeFd);
+        });
+    }
 
-            gchar **split  = g_strsplit(line, ":",5);
-            gchar *status  = g_strstrip(split[0]);
-            gchar *pkg     = g_strstrip(split[1]);
-            gchar *percent = g_strstrip(split[2]);
-            gchar *str     = g_strdup(g_strstrip(split[3]));
+    time_t now = time(NULL);
 
-            // major problem here, we got unexpected input. should _never_ happen
-            if(!(pkg && status)) {
-                continue;
-            }
+    if(!m_startCounting) {
+        // wait until we get the first message from apt
+        m_lastTermAction = now;
+    }
 
-            // Since PackageKit doesn't emulate finished anymore
-            // we need to manually do it here, as at this point
-            // dpkg doesn't process two packages at the same time
-            if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+    if ((now - m_lastTermAction) > m_terminalTimeout) {
+        // get some debug info
+        g_warning("no statusfd changes/content updates in terminal for %i"
+                  " seconds",m_terminalTimeout);
+        m_lastTermAction = time(NULL);
+    }
+}
+
+void AptIntf::handleStatus(const AptStatusParser::Record &record, int writeFd)
+{
+    const gchar *status = record.type;
+    const gchar *pkg = record.package;
+    const gchar *str = record.message;
+
+    // Since PackageKit doesn't emulate finished anymore
+    // we need to manually do it here, as at this point
+    // dpkg doesn't process two packages at the same time
+    if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+        if (!ver.end()) {
+            emitPackage(ver, PK_INFO_ENUM_FINISHED);
+        }
+        m_lastSubProgress = 0;
+    }
+
+    // first check for errors and conf-file prompts
+    if (strstr(status, "pmerror") != NULL) {
+        // error from dpkg
+        pk_backend_job_error_code(m_job,
+                                  PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
+                                  "Error while installing package: %s",
+                                  str);
+    } else if (strstr(status, "pmconffile") != NULL) {
+        // conffile-request from dpkg, needs to be parsed different
+        string orig_file, new_file;
+        AptStatusParser::conffileNames(str, orig_file, new_file);
+
+        gchar *filename;
+        filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
+        gchar **argv;
+        gchar **envp;
+        GError *error = NULL;
+        argv = (gchar **) g_malloc(5 * sizeof(gchar *));
+        argv[0] = filename;
+        argv[1] = g_strdup(m_lastPackage.c_str());
+        argv[2] = g_strdup(orig_file.c_str());
+        argv[3] = g_strdup(new_file.c_str());
+        argv[4] = NULL;
+
+        const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
+        if ((m_interactive) && (socket != NULL)) {
+            envp = (gchar **) g_malloc(3 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
+            envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
+            envp[2] = NULL;
+        } else {
+            // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
+            envp = (gchar **) g_malloc(2 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
+            envp[1] = NULL;
+        }
+
+        gboolean ret;
+        gint exitStatus;
+        ret = g_spawn_sync(NULL, // working dir
+                           argv, // argv
+                           envp, // envp
+                           G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
+                           NULL, // child_setup
+                           NULL, // user_data
+                           NULL, // standard_output
+                           NULL, // standard_error
+                           &exitStatus,
+                           &error);
+
+        int exit_code = WEXITSTATUS(exitStatus);
+        cout << filename << " " << exit_code << " ret: "<< ret << endl;
+
+        g_strfreev(argv);
+        g_strfreev(envp);
+
+        if (exit_code == 10) {
+            // 1 means the user wants the package config
+            if (write(writeFd, "Y\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else if (exit_code == 20) {
+            // 2 means the user wants to keep the current config
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else {
+            // either the user didn't choose an option or the front end failed'
+            //                     pk_backend_job_message(m_job,
+            //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
+            //                                            "The configuration file '%s' "
+            //                                            "(modified by you or a script) "
+            //                                            "has a newer version '%s'.\n"
+            //                                            "Please verify your changes and update it manually.",
+            //                                            orig_file.c_str(),
+            //                                            new_file.c_str());
+            // fall back to keep the current config file
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        }
+    } else if (strstr(status, "pmstatus") != NULL) {
+        // INSTALL & UPDATE
+        // - Running dpkg
+        // loops ALL
+        // -  0 Installing pkg (sometimes this is skiped)
+        // - 25 Preparing pkg
+        // - 50 Unpacking pkg
+        // - 75 Preparing to configure pkg
+        //   ** Some pkgs have
+        //   - Running post-installation
+        //   - Running dpkg
+        // reloops all
+        // -   0 Configuring pkg
+        // - +25 Configuring pkg (SOMETIMES)
+        // - 100 Installed pkg
+        // after all
+        // - Running post-installation
+
+        // REMOVE
+        // - Running dpkg
+        // loops
+        // - 25  Removing pkg
+        // - 50  Preparing for removal of pkg
+        // - 75  Removing pkg
+        // - 100 Removed pkg
+        // after all
+        // - Running post-installation
+
+        // Let's start parsing the status:
+        if (g_str_has_prefix(str, "Preparing to configure")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing to configure! " << line << endl;
+            // The next item might be Configuring so better it be 100
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
+            }
+        } else if (g_str_has_prefix(str, "Preparing for removal")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing for removal! " << line << endl;
+            m_lastSubProgress = 50;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
+            }
+        } else if (g_str_has_prefix(str, "Preparing")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
+            }
+        } else if (g_str_has_prefix(str, "Unpacking")) {
+            // cout << "Found Unpacking! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
+            }
+        } else if (g_str_has_prefix(str, "Configuring")) {
+            // Installing Package
+            // cout << "Found Configuring! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
                 const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
                 if (!ver.end()) {
                     emitPackage(ver, PK_INFO_ENUM_FINISHED);
@@ -1789,278 +2074,73 @@ void AptIntf::updateInterface(int fd, int writeFd)
                 m_lastSubProgress = 0;
             }
 
-            // first check for errors and conf-file prompts
-            if (strstr(status, "pmerror") != NULL) {
-                // error from dpkg
-                pk_backend_job_error_code(m_job,
-                                          PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
-                                          "Error while installing package: %s",
-                                          str);
-            } else if (strstr(status, "pmconffile") != NULL) {
-                // conffile-request from dpkg, needs to be parsed different
-                int i = 0;
-                string orig_file, new_file;
-
-                // go to first ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    orig_file.append(1, str[i]);
-                i++;
-
-                // same for second ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    new_file.append(1, str[i]);
-                i++;
-
-                gchar *filename;
-                filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
-                gchar **argv;
-                gchar **envp;
-                GError *error = NULL;
-                argv = (gchar **) g_malloc(5 * sizeof(gchar *));
-                argv[0] = filename;
-                argv[1] = g_strdup(m_lastPackage.c_str());
-                argv[2] = g_strdup(orig_file.c_str());
-                argv[3] = g_strdup(new_file.c_str());
-                argv[4] = NULL;
-
-                const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
-                if ((m_interactive) && (socket != NULL)) {
-                    envp = (gchar **) g_malloc(3 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
-                    envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
-                    envp[2] = NULL;
-                } else {
-                    // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
-                    envp = (gchar **) g_malloc(2 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
-                    envp[1] = NULL;
-                }
-
-                gboolean ret;
-                gint exitStatus;
-                ret = g_spawn_sync(NULL, // working dir
-                                   argv, // argv
-                                   envp, // envp
-                                   G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
-                                   NULL, // child_setup
-                                   NULL, // user_data
-                                   NULL, // standard_output
-                                   NULL, // standard_error
-                                   &exitStatus,
-                                   &error);
-
-                int exit_code = WEXITSTATUS(exitStatus);
-                cout << filename << " " << exit_code << " ret: "<< ret << endl;
-
-                g_strfreev(argv);
-                g_strfreev(envp);
-
-                if (exit_code == 10) {
-                    // 1 means the user wants the package config
-                    if (write(writeFd, "Y\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else if (exit_code == 20) {
-                    // 2 means the user wants to keep the current config
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else {
-                    // either the user didn't choose an option or the front end failed'
-                    //                     pk_backend_job_message(m_job,
-                    //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
-                    //                                            "The configuration file '%s' "
-                    //                                            "(modified by you or a script) "
-                    //                                            "has a newer version '%s'.\n"
-                    //                                            "Please verify your changes and update it manually.",
-                    //                                            orig_file.c_str(),
-                    //                                            new_file.c_str());
-                    // fall back to keep the current config file
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                }
-            } else if (strstr(status, "pmstatus") != NULL) {
-                // INSTALL & UPDATE
-                // - Running dpkg
-                // loops ALL
-                // -  0 Installing pkg (sometimes this is skiped)
-                // - 25 Preparing pkg
-                // - 50 Unpacking pkg
-                // - 75 Preparing to configure pkg
-                //   ** Some pkgs have
-                //   - Running post-installation
-                //   - Running dpkg
-                // reloops all
-                // -   0 Configuring pkg
-                // - +25 Configuring pkg (SOMETIMES)
-                // - 100 Installed pkg
-                // after all
-                // - Running post-installation
-
-                // REMOVE
-                // - Running dpkg
-                // loops
-                // - 25  Removing pkg
-                // - 50  Preparing for removal of pkg
-                // - 75  Removing pkg
-                // - 100 Removed pkg
-                // after all
-                // - Running post-installation
-
-                // Let's start parsing the status:
-                if (starts_with(str, "Preparing to configure")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing to configure! " << line << endl;
-                    // The next item might be Configuring so better it be 100
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
-                    }
-                } else if (starts_with(str, "Preparing for removal")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing for removal! " << line << endl;
-                    m_lastSubProgress = 50;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Preparing")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
-                    }
-                } else if (starts_with(str, "Unpacking")) {
-                    // cout << "Found Unpacking! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
-                    }
-                } else if (starts_with(str, "Configuring")) {
-                    // Installing Package
-                    // cout << "Found Configuring! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                        m_lastSubProgress = 0;
-                    }
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                    m_lastSubProgress += 25;
-                } else if (starts_with(str, "Running dpkg")) {
-                    // cout << "Found Running dpkg! " << line << endl;
-                } else if (starts_with(str, "Running")) {
-                    // cout << "Found Running! " << line << endl;
-                    pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
-                } else if (starts_with(str, "Installing")) {
-                    // cout << "Found Installing! " << line << endl;
-                    // FINISH the last package
-                    if (!m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress = 0;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Removing")) {
-                    // cout << "Found Removing! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress += 25;
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Installed") ||
-                           starts_with(str, "Removed")) {
-                    // cout << "Found FINISHED! " << line << endl;
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        //                         emitPackageProgress(ver, m_lastSubProgress);
-                    }
-                } else {
-                    cout << ">>>Unmaped value<<< :" << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+            m_lastSubProgress += 25;
+        } else if (g_str_has_prefix(str, "Running dpkg")) {
+            // cout << "Found Running dpkg! " << line << endl;
+        } else if (g_str_has_prefix(str, "Running")) {
+            // cout << "Found Running! " << line << endl;
+            pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
+        } else if (g_str_has_prefix(str, "Installing")) {
+            // cout << "Found Installing! " << line << endl;
+            // FINISH the last package
+            if (!m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-
-                if (!starts_with(str, "Running")) {
-                    m_lastPackage = pkg;
+            }
+            m_lastSubProgress = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+        } else if (g_str_has_prefix(str, "Removing")) {
+            // cout << "Found Removing! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-                m_startCounting = true;
-            } else {
-                m_startCounting = true;
             }
+            m_lastSubProgress += 25;
 
-            int val = atoi(percent);
-            //cout << "progress: " << val << endl;
-            pk_backend_job_set_percentage(m_job, val);
-
-            // clean-up
-            g_strfreev(split);
-            g_free(str);
-            line[0] = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
+            }
+        } else if (g_str_has_prefix(str, "Installed") ||
+                   g_str_has_prefix(str, "Removed")) {
+            // cout << "Found FINISHED! " << line << endl;
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_FINISHED);
+                //                         emitPackageProgress(ver, m_lastSubProgress);
+            }
         } else {
-            buf[1] = 0;
-            strcat(line, buf);
+            cout << ">>>Unmaped value<<< :" << pkg << ":" << str << endl;
         }
-    }
 
-    time_t now = time(NULL);
-
-    if(!m_startCounting) {
-        usleep(100000);
-        // wait until we get the first message from apt
-        m_lastTermAction = now;
-    }
-
-    if ((now - m_lastTermAction) > m_terminalTimeout) {
-        // get some debug info
-        g_warning("no statusfd changes/content updates in terminal for %i"
-                  " seconds",m_terminalTimeout);
-        m_lastTermAction = time(NULL);
+        if (!g_str_has_prefix(str, "Running")) {
+            m_lastPackage = pkg;
+        }
+        m_startCounting = true;
+    } else {
+        m_startCounting = true;
     }
 
-    // sleep for a while to don't obcess over it
-    usleep(5000);
+    int val = record.percent;
+    //cout << "progress: " << val << endl;
+    pk_backend_job_set_percentage(m_job, val);
 }
 
 PkgList AptIntf::resolvePackageIds(gchar **package_ids, PkBitfield filters)
@@ -2557,12 +2637,34 @@ bool AptIntf::installPackages(PkBitfield flags)
     // Check if the child died
     int ret;
     char masterbuf[1024];
+    struct pollfd fds[] = {
+        { readFromChildFD[0], POLLIN, 0 },
+        { pty_master, POLLIN, 0 },
+    };
     while (waitpid(m_child_pid, &ret, WNOHANG) == 0) {
+        // sleep until there is output, or a while to check on the child
+        if (poll(fds, G_N_ELEMENTS(fds), 100) > 0) {
+            for (guint i = 0; i < G_N_ELEMENTS(fds); ++i) {
+                if (fds[i].revents & (POLLHUP | POLLERR)) {
+                    // closed by the child, stop polling it
+                    fds[i].fd = -1;
+                }
+            }
+        }
+
         // TODO: This is dpkg's raw output. Maybe save it for error-solving?
         while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
         updateInterface(readFromChildFD[0], pty_master);
     }
 
+    // the child may have written its last status lines after the
+    // final read above, nothing more comes now that it exited
+    while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
+    updateInterface(readFromChildFD[0], pty_master);
+    if (m_statusParser.pending()) {
+        g_warning("The status of dpkg ended in the middle of a line");
+    }
+
     close(readFromChildFD[0]);
     close(readFromChildFD[1]);
     close(pty_master);
@@ -34,19 +34,29 @@
 
 #include "pkg-list.h"
 #include "apt-sourceslist.h"
+#include "apt-status-parser.h"
 
 #define REBOOT_REQUIRED      "/var/run/reboot-required"
 
 class pkgProblemResolver;
 class Matcher;
 class AptCacheFile;
+class AptSharedCache;
+class AptFileIndex;
+class AptChangelogCache;
 class AptIntf
 {
 public:
-    AptIntf(PkBackendJob *job);
+    AptIntf(PkBackendJob *job, AptSharedCache *sharedCache = nullptr);
     ~AptIntf();
 
     bool init(gchar **localDebs = nullptr);
+
+    /**
+     * Waits until the job may use the system: alone if it changes it,
+     * or next to other queries; init() does this too
+     */
+    void lockGate();
     void cancel();
     bool cancelled() const;
 
@@ -140,7 +150,7 @@ public:
     /**
       * Returns a list of all packages that matched contains the given files
       */
-    PkgList searchPackageFiles(gchar **values);
+    PkgList searchPackageFiles(AptFileIndex *index, gchar **values);
 
     /**
       * Returns a list of all packages that can be updated
@@ -194,14 +204,15 @@ public:
     void emitDetails(PkgList &pkgs);
 
     /**
-      * Emits update detail
+      * Emits update detail, with the changelog if it is in the cache
       */
-    void emitUpdateDetail(const pkgCache::VerIterator &candver);
+    void emitUpdateDetail(AptChangelogCache *changelogs, const pkgCache::VerIterator &candver);
 
     /**
-      * Emits update datails for the given list
+      * Emits update datails for the given list, fetching the changelogs
+      * that are not cached yet when online
       */
-    void emitUpdateDetails(const PkgList &pkgs);
+    void emitUpdateDetails(AptChangelogCache *changelogs, const PkgList &pkgs);
 
     /**
       *  Emits the files of a package
@@ -241,21 +252,56 @@ public:
 
     AptCacheFile* aptCacheFile() const;
 
+    /**
+      * Whether this job uses the shared read-only cache
+      */
+    bool usesSharedCache() const;
+
 private:
+    // What the filters look at, computed once per version and cache
+    enum VersionFlag {
+        VersionFlagKnown            = 1 << 0,
+        VersionFlagInstalled        = 1 << 1,
+        VersionFlagNativeArch       = 1 << 2,
+        VersionFlagDevel            = 1 << 3,
+        VersionFlagGui              = 1 << 4,
+        VersionFlagFree             = 1 << 5,
+        VersionFlagSupported        = 1 << 6,
+        // only looked up for installed packages when a filter needs it
+        VersionFlagApplicationKnown = 1 << 7,
+        VersionFlagApplication      = 1 << 8,
+    };
+
+    guint16 versionFlags(const pkgCache::VerIterator &ver, bool withApplication);
+    bool filterFlags(PkBitfield filters, guint16 &mask, guint16 &value) const;
+
     void setEnvLocaleFromJob();
+    void setEnv(const gchar *variable, const gchar *value);
+    void setProxiesFromJob();
+    bool proxiesChanged() const;
+    bool canShareCache() const;
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
     bool packageIsSupported(const pkgCache::VerIterator &verIter, string component);
     bool isApplication(const pkgCache::VerIterator &verIter);
-    bool matchesQueries(const vector<string> &queries, string s);
+    bool matchesQueries(const vector<string> &queries, const string &s);
 
     /**
      *  interprets dpkg status fd
      */
     void updateInterface(int readFd, int writeFd);
+    void handleStatus(const AptStatusParser::Record &record, int writeFd);
     PkgList checkChangedPackages(bool emitChanged);
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
     AptCacheFile *m_cache;
+    AptSharedCache *m_sharedCache;
+    bool       m_cacheShared;
+    enum {
+        GateNone,
+        GateRead,
+        GateWrite
+    } m_gate;
+    bool       m_writes;
     PkBackendJob  *m_job;
     bool       m_cancel;
     struct stat m_restartStat;
@@ -269,6 +315,7 @@ private:
     uint       m_lastSubProgress;
     bool       m_startCounting;
     bool       m_interactive;
+    AptStatusParser m_statusParser;
 
     // when the internal terminal timesout after no activity
     int m_terminalTimeout;
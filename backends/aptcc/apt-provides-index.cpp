@@ -0,0 +1,187 @@
+/* apt-provides-index.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "apt-provides-index.h"
+
+#include <apt-pkg/pkgrecords.h>
+
+#include <appstream.h>
+#include <gst/gst.h>
+
+#include "apt-cache-file.h"
+#include "apt-utils.h"
+#include "gst-matcher.h"
+
+using std::string;
+using std::vector;
+
+// the fields GstMatcher knows about
+static const char *gstreamerFields[] = {
+    "Gstreamer-Decoders",
+    "Gstreamer-Encoders",
+    "Gstreamer-Elements",
+    "Gstreamer-Uri-Sinks",
+    "Gstreamer-Uri-Sources",
+};
+
+AptProvidesIndex::AptProvidesIndex(AptCacheFile *cache) :
+    m_hasAppStreamData(false)
+{
+    buildCodecs(cache);
+    buildMimeTypes();
+}
+
+AptProvidesIndex::~AptProvidesIndex()
+{
+    for (const Codec &codec : m_codecs) {
+        gst_caps_unref(codec.caps);
+    }
+}
+
+void AptProvidesIndex::codecs(const GstMatcher &matcher, PkgList &output) const
+{
+    vector<bool> added(m_codecs.size(), false);
+    auto check = [&](guint32 idx) {
+        const Codec &codec = m_codecs[idx];
+        if (!added[idx] && matcher.matches(codec.version, codec.type, codec.caps, codec.ver.Arch())) {
+            added[idx] = true;
+            output.push_back(codec.ver);
+        }
+    };
+
+    // only packages with caps of the same media type can intersect
+    for (const string &mediaType : matcher.mediaTypes()) {
+        const auto it = m_codecsByMediaType.find(mediaType);
+        if (it != m_codecsByMediaType.end()) {
+            for (guint32 idx : it->second) {
+                check(idx);
+            }
+        }
+    }
+    for (guint32 idx : m_anyCodecs) {
+        check(idx);
+    }
+}
+
+vector<string> AptProvidesIndex::mimeTypePackages(const string &mimeType) const
+{
+    const auto it = m_mimeTypes.find(mimeType);
+    if (it == m_mimeTypes.end()) {
+        return vector<string>();
+    }
+    return it->second;
+}
+
+bool AptProvidesIndex::hasAppStreamData() const
+{
+    return m_hasAppStreamData;
+}
+
+void AptProvidesIndex::buildCodecs(AptCacheFile *cache)
+{
+    GstMatcher::init();
+
+    for (pkgCache::PkgIterator pkg = cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        // Ignore debug packages - these aren't interesting as codec providers,
+        // but they do have apt GStreamer-* metadata.
+        if (ends_with(pkg.Name(), "-dbg") || ends_with(pkg.Name(), "-dbgsym")) {
+            continue;
+        }
+
+        // TODO search in updates packages
+        // Ignore virtual packages
+        pkgCache::VerIterator ver = cache->findVer(pkg);
+        if (ver.end()) {
+            ver = cache->findCandidateVer(pkg);
+        }
+        if (ver.end()) {
+            continue;
+        }
+
+        pkgRecords::Parser &rec = cache->GetPkgRecords()->Lookup(ver.FileList());
+        const string version = rec.RecordField("Gstreamer-Version");
+        if (version.empty()) {
+            continue;
+        }
+
+        for (const char *field : gstreamerFields) {
+            string value = rec.RecordField(field);
+            value = value.substr(0, value.find('\n'));
+            if (value.empty()) {
+                continue;
+            }
+
+            GstCaps *caps = gst_caps_from_string(value.c_str());
+            if (caps == NULL) {
+                continue;
+            }
+
+            const guint32 idx = m_codecs.size();
+            m_codecs.push_back({ver, version, field, caps});
+            if (gst_caps_is_any(caps)) {
+                m_anyCodecs.push_back(idx);
+                continue;
+            }
+            for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+                const gchar *mediaType = gst_structure_get_name(gst_caps_get_structure(caps, i));
+                vector<guint32> &codecs = m_codecsByMediaType[mediaType];
+                // caps often list several structures of one media type
+                if (codecs.empty() || codecs.back() != idx) {
+                    codecs.push_back(idx);
+                }
+            }
+        }
+    }
+}
+
+void AptProvidesIndex::buildMimeTypes()
+{
+    g_autoptr(AsPool) pool = NULL;
+    g_autoptr(GError) error = NULL;
+
+    pool = as_pool_new();
+    as_pool_load(pool, NULL, &error);
+    if (error != NULL) {
+        /* we do not fail here because even with error we might still find metadata */
+        g_warning("Issue while loading the AppStream metadata pool: %s", error->message);
+    }
+
+    g_autoptr(GPtrArray) cpts = as_pool_get_components(pool);
+    m_hasAppStreamData = cpts->len > 0;
+    for (guint i = 0; i < cpts->len; ++i) {
+        AsComponent *cpt = AS_COMPONENT(g_ptr_array_index(cpts, i));
+
+        /* we only select one package per component - on Debian systems, AppStream components never reference multiple packages */
+        const gchar *pkgname = as_component_get_pkgname(cpt);
+        AsProvided *provided = as_component_get_provided_for_kind(cpt, AS_PROVIDED_KIND_MIMETYPE);
+        if (pkgname == NULL || provided == NULL) {
+            continue;
+        }
+
+        GPtrArray *items = as_provided_get_items(provided);
+        for (guint j = 0; j < items->len; ++j) {
+            m_mimeTypes[static_cast<const gchar*>(g_ptr_array_index(items, j))].push_back(pkgname);
+        }
+    }
+}
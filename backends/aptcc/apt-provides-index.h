@@ -0,0 +1,86 @@
+/* apt-provides-index.h
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef APT_PROVIDES_INDEX_H
+#define APT_PROVIDES_INDEX_H
+
+#include <glib.h>
+
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pkg-list.h"
+
+class AptCacheFile;
+class GstMatcher;
+typedef struct _GstCaps GstCaps;
+
+/**
+ * Answers WhatProvides for codecs and MIME types
+ *
+ * The GStreamer caps of all packages are read from their records and
+ * parsed once, and the MIME types handled by each package are taken
+ * from the AppStream pool once, per cache generation.
+ */
+class AptProvidesIndex
+{
+public:
+    explicit AptProvidesIndex(AptCacheFile *cache);
+    ~AptProvidesIndex();
+
+    /**
+      * Adds the versions providing one of the codecs of the matcher
+      */
+    void codecs(const GstMatcher &matcher, PkgList &output) const;
+
+    /**
+      * Returns the names of the packages handling the MIME type
+      */
+    std::vector<std::string> mimeTypePackages(const std::string &mimeType) const;
+
+    /**
+      * Returns whether there was any AppStream metadata to index
+      */
+    bool hasAppStreamData() const;
+
+private:
+    struct Codec {
+        pkgCache::VerIterator ver;
+        std::string version;
+        std::string type;
+        GstCaps *caps;
+    };
+
+    void buildCodecs(AptCacheFile *cache);
+    void buildMimeTypes();
+
+    std::vector<Codec> m_codecs;
+    // media type -> index in m_codecs
+    std::unordered_map<std::string, std::vector<guint32>> m_codecsByMediaType;
+    // codecs accepting any caps
+    std::vector<guint32> m_anyCodecs;
+
+    std::unordered_map<std::string, std::vector<std::string>> m_mimeTypes;
+    bool m_hasAppStreamData;
+};
+
+#endif
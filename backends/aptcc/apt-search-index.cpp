@@ -0,0 +1,484 @@
+/* apt-search-index.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "apt-search-index.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+#include "apt-cache-file.h"
+
+using std::string;
+using std::vector;
+
+#define APT_DETAILS_INDEX_FILE    "packagekit-details.idx"
+#define APT_DETAILS_INDEX_MAGIC   "PKAPTDI1"
+
+// Queries this long or more are looked up in the trigram indexes
+#define APT_INDEX_TRIGRAM          3
+
+static guint32 trigram_at(const gchar *str)
+{
+    return ((guint32) (guchar) str[0] << 16) |
+            ((guint32) (guchar) str[1] << 8) |
+            (guint32) (guchar) str[2];
+}
+
+// Splits text into lowercase words. Queries are split the same way, and
+// any byte outside ASCII counts as part of a word, so a query word that
+// occurs in a text always lies inside a single word of that text.
+static void split_words(const string &text, vector<string> &words)
+{
+    string word;
+
+    words.clear();
+    for (unsigned char ch : text) {
+        if (ch >= 0x80 || g_ascii_isalnum(ch)) {
+            word += g_ascii_tolower(ch);
+        } else if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+}
+
+AptDetailsIndex::AptDetailsIndex(AptCacheFile *cache) :
+    m_packageCount((*cache)->Head().PackageCount)
+{
+    const string fileName = _config->FindDir("Dir::Cache") + APT_DETAILS_INDEX_FILE;
+    const string key = generationKey(cache);
+
+    if (!load(fileName, key)) {
+        build(cache);
+        if (!save(fileName, key)) {
+            g_debug("Failed to save the details index to %s", fileName.c_str());
+        }
+    }
+
+    indexWords();
+}
+
+vector<bool> AptDetailsIndex::candidates(const vector<string> &queries) const
+{
+    vector<bool> result(m_packageCount, false);
+    vector<string> words;
+
+    for (const string &query : queries) {
+        split_words(query, words);
+        if (words.empty()) {
+            // nothing to look up, anything may match
+            return vector<bool>(m_packageCount, true);
+        }
+
+        // packages having a word containing every query word, starting
+        // with the rarest one so the intersections stay small
+        vector<vector<guint32>> postings;
+        for (const string &word : words) {
+            postings.push_back(lookup(word));
+        }
+        std::sort(postings.begin(), postings.end(),
+                  [](const vector<guint32> &a, const vector<guint32> &b) {
+                      return a.size() < b.size();
+                  });
+
+        vector<guint32> matches = std::move(postings[0]);
+        vector<guint32> both;
+        for (size_t i = 1; i < postings.size() && !matches.empty(); ++i) {
+            both.clear();
+            std::set_intersection(matches.begin(), matches.end(),
+                                  postings[i].begin(), postings[i].end(),
+                                  std::back_inserter(both));
+            matches.swap(both);
+        }
+
+        for (guint32 id : matches) {
+            result[id] = true;
+        }
+    }
+
+    return result;
+}
+
+// The sorted IDs of the packages having a word that contains the given one
+vector<guint32> AptDetailsIndex::lookup(const string &word) const
+{
+    vector<guint32> ids;
+    auto addWord = [&](guint32 i) {
+        if (m_words[i].find(word) != string::npos) {
+            ids.insert(ids.end(), m_postings[i].begin(), m_postings[i].end());
+        }
+    };
+
+    if (word.size() < APT_INDEX_TRIGRAM) {
+        // short words are part of so many others that a scan costs little more
+        for (guint32 i = 0; i < m_words.size(); ++i) {
+            addWord(i);
+        }
+    } else {
+        // only the words having the rarest trigram of this one can contain it
+        const vector<guint32> *rarest = nullptr;
+        for (size_t i = 0; i + APT_INDEX_TRIGRAM <= word.size(); ++i) {
+            auto it = m_wordTrigrams.find(trigram_at(word.c_str() + i));
+            if (it == m_wordTrigrams.end()) {
+                return ids;
+            }
+            if (rarest == nullptr || it->second.size() < rarest->size()) {
+                rarest = &it->second;
+            }
+        }
+        for (guint32 i : *rarest) {
+            addWord(i);
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+// Not saved with the index, it is quick to build from the words
+void AptDetailsIndex::indexWords()
+{
+    m_wordTrigrams.clear();
+    for (guint32 i = 0; i < m_words.size(); ++i) {
+        const string &word = m_words[i];
+        for (size_t j = 0; j + APT_INDEX_TRIGRAM <= word.size(); ++j) {
+            vector<guint32> &words = m_wordTrigrams[trigram_at(word.c_str() + j)];
+            if (words.empty() || words.back() != i) {
+                words.push_back(i);
+            }
+        }
+    }
+}
+
+void AptDetailsIndex::build(AptCacheFile *cache)
+{
+    std::unordered_map<string, vector<guint32>> postings;
+    vector<string> words;
+
+    auto addText = [&](const string &text, guint32 id) {
+        split_words(text, words);
+        for (const string &word : words) {
+            vector<guint32> &ids = postings[word];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+        }
+    };
+
+    // every version and translation, so the index does not depend on
+    // the candidate policy or the language of the job
+    for (pkgCache::PkgIterator pkg = (*cache)->PkgBegin(); !pkg.end(); ++pkg) {
+        addText(pkg.Name(), pkg->ID);
+
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            for (pkgCache::DescIterator desc = ver.DescriptionList(); !desc.end(); ++desc) {
+                pkgCache::DescFileIterator df = desc.FileList();
+                if (df.end()) {
+                    continue;
+                }
+                addText(cache->GetPkgRecords()->Lookup(df).LongDesc(), pkg->ID);
+            }
+        }
+    }
+
+    m_words.reserve(postings.size());
+    for (const auto &posting : postings) {
+        m_words.push_back(posting.first);
+    }
+    std::sort(m_words.begin(), m_words.end());
+
+    m_postings.reserve(m_words.size());
+    for (const string &word : m_words) {
+        m_postings.push_back(std::move(postings[word]));
+    }
+}
+
+// The index is keyed by the files the cache was built from, the same
+// inputs always give the same package IDs
+string AptDetailsIndex::generationKey(AptCacheFile *cache)
+{
+    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    pkgCache::Header &head = (*cache)->Head();
+    g_autofree gchar *counts = g_strdup_printf("%u %u %u",
+                                               (guint) head.PackageCount,
+                                               (guint) head.VersionCount,
+                                               (guint) head.DescriptionCount);
+
+    g_checksum_update(checksum, (const guchar *) counts, -1);
+    for (pkgCache::PkgFileIterator file = (*cache)->FileBegin(); !file.end(); ++file) {
+        g_autofree gchar *stamp = g_strdup_printf("\n%s %llu %lld",
+                                                  file.FileName() ? file.FileName() : "",
+                                                  (unsigned long long) file->Size,
+                                                  (long long) file->mtime);
+        g_checksum_update(checksum, (const guchar *) stamp, -1);
+    }
+
+    return g_checksum_get_string(checksum);
+}
+
+// MAGIC key\0 package-count word-count, then for every word:
+// length bytes id-count ids
+bool AptDetailsIndex::load(const string &fileName, const string &key)
+{
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(fileName.c_str(), &contents, &length, NULL)) {
+        return false;
+    }
+
+    const gchar *pos = contents;
+    const gchar *end = contents + length;
+    auto readU32 = [&](guint32 &value) {
+        if (end - pos < (gssize) sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+
+    const size_t header = strlen(APT_DETAILS_INDEX_MAGIC) + key.size() + 1;
+    if (length < header ||
+            memcmp(pos, APT_DETAILS_INDEX_MAGIC, strlen(APT_DETAILS_INDEX_MAGIC)) != 0 ||
+            key != pos + strlen(APT_DETAILS_INDEX_MAGIC)) {
+        return false;
+    }
+    pos += header;
+
+    guint32 packageCount;
+    guint32 wordCount;
+    if (!readU32(packageCount) || packageCount != m_packageCount || !readU32(wordCount)) {
+        return false;
+    }
+
+    vector<string> words;
+    vector<vector<guint32>> postings;
+    words.reserve(wordCount);
+    postings.reserve(wordCount);
+    for (guint32 i = 0; i < wordCount; ++i) {
+        guint32 size;
+        if (!readU32(size) || end - pos < (gssize) size) {
+            return false;
+        }
+        words.emplace_back(pos, size);
+        pos += size;
+
+        if (!readU32(size) || (gsize) (end - pos) / sizeof(guint32) < size) {
+            return false;
+        }
+        vector<guint32> ids(size);
+        memcpy(ids.data(), pos, size * sizeof(guint32));
+        pos += size * sizeof(guint32);
+        for (guint32 id : ids) {
+            if (id >= m_packageCount) {
+                return false;
+            }
+        }
+        postings.push_back(std::move(ids));
+    }
+
+    m_words.swap(words);
+    m_postings.swap(postings);
+    return true;
+}
+
+bool AptDetailsIndex::save(const string &fileName, const string &key) const
+{
+    string contents;
+    auto appendU32 = [&](guint32 value) {
+        contents.append((const char *) &value, sizeof(value));
+    };
+
+    contents.append(APT_DETAILS_INDEX_MAGIC);
+    contents.append(key.c_str(), key.size() + 1);
+    appendU32(m_packageCount);
+    appendU32(m_words.size());
+    for (size_t i = 0; i < m_words.size(); ++i) {
+        appendU32(m_words[i].size());
+        contents.append(m_words[i]);
+        appendU32(m_postings[i].size());
+        contents.append((const char *) m_postings[i].data(), m_postings[i].size() * sizeof(guint32));
+    }
+
+    // written to a temporary file and renamed, never seen half written
+    return g_file_set_contents(fileName.c_str(), contents.data(), contents.size(), NULL);
+}
+
+// Fewest names a scanning thread gets
+#define APT_NAME_INDEX_MIN_CHUNK   16384
+
+static string fold_case(const string &str)
+{
+    string folded(str);
+    for (char &ch : folded) {
+        ch = g_ascii_tolower(ch);
+    }
+    return folded;
+}
+
+struct AptNameScan
+{
+    const AptNameIndex *index;
+    const string *query;
+    guint32 begin;
+    guint32 end;
+    guint8 *found;
+
+    static gpointer run(gpointer data)
+    {
+        const AptNameScan *chunk = static_cast<const AptNameScan*>(data);
+        chunk->index->scan(*chunk->query, chunk->begin, chunk->end, chunk->found);
+        return NULL;
+    }
+};
+
+AptNameIndex::AptNameIndex(AptCacheFile *cache) :
+    m_packageCount((*cache)->Head().PackageCount)
+{
+    vector<const char*> names(m_packageCount, "");
+    for (pkgCache::PkgIterator pkg = (*cache)->PkgBegin(); !pkg.end(); ++pkg) {
+        if (pkg->ID < m_packageCount) {
+            names[pkg->ID] = pkg.Name();
+        }
+    }
+
+    m_offsets.reserve(m_packageCount + 1);
+    for (guint32 id = 0; id < m_packageCount; ++id) {
+        m_offsets.push_back(m_names.size());
+        const string name = fold_case(names[id]);
+
+        for (size_t i = 0; i + APT_INDEX_TRIGRAM <= name.size(); ++i) {
+            vector<guint32> &ids = m_trigrams[trigram_at(name.c_str() + i)];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+        }
+
+        m_names.append(name);
+        m_names.push_back('\0');
+    }
+    m_offsets.push_back(m_names.size());
+}
+
+vector<bool> AptNameIndex::matches(const vector<string> &queries) const
+{
+    vector<guint8> found(m_packageCount, 0);
+
+    for (const string &query : queries) {
+        const string folded = fold_case(query);
+
+        if (folded.size() < APT_INDEX_TRIGRAM) {
+            scanParallel(folded, found);
+            continue;
+        }
+
+        // the rarest trigram of the query gives the fewest names to check
+        const vector<guint32> *rarest = nullptr;
+        for (size_t i = 0; i + APT_INDEX_TRIGRAM <= folded.size(); ++i) {
+            auto it = m_trigrams.find(trigram_at(folded.c_str() + i));
+            if (it == m_trigrams.end()) {
+                rarest = nullptr;
+                break;
+            }
+            if (rarest == nullptr || it->second.size() < rarest->size()) {
+                rarest = &it->second;
+            }
+        }
+        if (rarest == nullptr) {
+            continue;
+        }
+
+        for (guint32 id : *rarest) {
+            if (!found[id] && nameContains(id, folded)) {
+                found[id] = 1;
+            }
+        }
+    }
+
+    return vector<bool>(found.begin(), found.end());
+}
+
+bool AptNameIndex::nameContains(guint32 id, const string &query) const
+{
+    const gchar *name = m_names.data() + m_offsets[id];
+    return memmem(name, m_offsets[id + 1] - m_offsets[id] - 1, query.data(), query.size()) != NULL;
+}
+
+// The names are separated by \0, so a match never spans two of them
+void AptNameIndex::scan(const string &query, guint32 begin, guint32 end, guint8 *found) const
+{
+    const gchar *names = m_names.data();
+    gsize pos = m_offsets[begin];
+    const gsize last = m_offsets[end];
+
+    if (query.empty()) {
+        memset(found + begin, 1, end - begin);
+        return;
+    }
+
+    while (pos < last) {
+        const gchar *hit = static_cast<const gchar*>(memmem(names + pos, last - pos,
+                                                            query.data(), query.size()));
+        if (hit == NULL) {
+            break;
+        }
+
+        // continue after the name that matched
+        auto next = std::upper_bound(m_offsets.begin() + begin, m_offsets.begin() + end + 1,
+                                     (guint32) (hit - names));
+        found[next - m_offsets.begin() - 1] = 1;
+        pos = *next;
+    }
+}
+
+void AptNameIndex::scanParallel(const string &query, vector<guint8> &found) const
+{
+    const guint32 threads = MIN(g_get_num_processors(),
+                                MAX(m_packageCount / APT_NAME_INDEX_MIN_CHUNK, 1u));
+    if (threads == 1) {
+        scan(query, 0, m_packageCount, found.data());
+        return;
+    }
+
+    // each thread marks its own range of IDs
+    vector<AptNameScan> chunks(threads);
+    vector<GThread*> running;
+    const guint32 size = m_packageCount / threads;
+    for (guint32 i = 0; i < threads; ++i) {
+        chunks[i].index = this;
+        chunks[i].query = &query;
+        chunks[i].begin = i * size;
+        chunks[i].end = i + 1 == threads ? m_packageCount : (i + 1) * size;
+        chunks[i].found = found.data();
+        running.push_back(g_thread_new("aptcc-name-scan", AptNameScan::run, &chunks[i]));
+    }
+    for (GThread *thread : running) {
+        g_thread_join(thread);
+    }
+}
@@ -0,0 +1,105 @@
+/* apt-search-index.h
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef APT_SEARCH_INDEX_H
+#define APT_SEARCH_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AptCacheFile;
+
+/**
+ * Inverted index from the words in package names and descriptions to
+ * the packages using them
+ *
+ * The index is built once per cache generation and saved next to
+ * pkgcache.bin, so later daemon runs only have to load it.
+ */
+class AptDetailsIndex
+{
+public:
+    /**
+      * Loads the index saved for the cache, or builds and saves it
+      */
+    explicit AptDetailsIndex(AptCacheFile *cache);
+
+    /**
+      * Returns which packages, by package ID, have all the words of at
+      * least one of the queries in their name or descriptions
+      * @note the index only knows about words, callers must still check
+      * the candidates against the queries themselves
+      */
+    std::vector<bool> candidates(const std::vector<std::string> &queries) const;
+
+private:
+    void build(AptCacheFile *cache);
+    void indexWords();
+    std::vector<guint32> lookup(const std::string &word) const;
+    bool load(const std::string &fileName, const std::string &key);
+    bool save(const std::string &fileName, const std::string &key) const;
+
+    static std::string generationKey(AptCacheFile *cache);
+
+    guint32 m_packageCount;
+    // sorted words, and the IDs of the packages using each of them
+    std::vector<std::string> m_words;
+    std::vector<std::vector<guint32>> m_postings;
+    // trigram -> indexes of the words having it
+    std::unordered_map<guint32, std::vector<guint32>> m_wordTrigrams;
+};
+
+/**
+ * Finds package names containing a string
+ *
+ * Keeps the lowercase names of all packages in one buffer, and a
+ * trigram index over it so that longer queries only have to look at a
+ * few names. Queries too short for trigrams scan the whole buffer,
+ * split between threads.
+ */
+class AptNameIndex
+{
+public:
+    explicit AptNameIndex(AptCacheFile *cache);
+
+    /**
+      * Returns which packages, by package ID, have a name containing one
+      * of the queries, ignoring case
+      */
+    std::vector<bool> matches(const std::vector<std::string> &queries) const;
+
+private:
+    friend struct AptNameScan;
+
+    bool nameContains(guint32 id, const std::string &query) const;
+    void scan(const std::string &query, guint32 begin, guint32 end, guint8 *found) const;
+    void scanParallel(const std::string &query, std::vector<guint8> &found) const;
+
+    guint32 m_packageCount;
+    // lowercase names in package ID order, each ended by a \0
+    std::string m_names;
+    std::vector<guint32> m_offsets;
+    // trigram -> IDs of the packages having it in their name
+    std::unordered_map<guint32, std::vector<guint32>> m_trigrams;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/* apt-status-parser.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "apt-status-parser.h"
+
+#include <string.h>
+
+void AptStatusParser::feed(gchar *data, gsize size, const RecordFunc &func)
+{
+    gchar *end = data + size;
+
+    while (data < end) {
+        gchar *newline = static_cast<gchar*>(memchr(data, '\n', end - data));
+        if (newline == NULL) {
+            // keep the rest until its line is complete
+            m_line.append(data, end - data);
+            break;
+        }
+
+        if (m_line.empty()) {
+            // the whole line is in the chunk, parse it where it is
+            *newline = '\0';
+            parseLine(data, func);
+        } else {
+            m_line.append(data, newline - data);
+            parseLine(&m_line[0], func);
+            m_line.clear();
+        }
+        data = newline + 1;
+    }
+}
+
+bool AptStatusParser::pending() const
+{
+    return !m_line.empty();
+}
+
+void AptStatusParser::parseLine(gchar *line, const RecordFunc &func)
+{
+    gchar *fields[3];
+    gchar *pos = line;
+
+    // type:package:percent:message, only the first three colons split
+    for (guint i = 0; i < G_N_ELEMENTS(fields); ++i) {
+        gchar *colon = strchr(pos, ':');
+        if (colon == NULL) {
+            // unexpected input, should never happen
+            return;
+        }
+        *colon = '\0';
+        fields[i] = pos;
+        pos = colon + 1;
+    }
+
+    Record record;
+    record.type = g_strstrip(fields[0]);
+    record.package = g_strstrip(fields[1]);
+    record.percent = g_ascii_strtod(fields[2], NULL);
+    record.message = g_strstrip(pos);
+    func(record);
+}
+
+bool AptStatusParser::conffileNames(const gchar *message, std::string &current, std::string &updated)
+{
+    // 'current' 'updated' 1 1
+    const gchar *quotes[4];
+    const gchar *pos = message;
+
+    for (guint i = 0; i < G_N_ELEMENTS(quotes); ++i) {
+        quotes[i] = strchr(pos, '\'');
+        if (quotes[i] == NULL) {
+            return false;
+        }
+        pos = quotes[i] + 1;
+    }
+
+    current.assign(quotes[0] + 1, quotes[1]);
+    updated.assign(quotes[2] + 1, quotes[3]);
+    return true;
+}
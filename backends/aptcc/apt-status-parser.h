@@ -0,0 +1,74 @@
+/* apt-status-parser.h
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef APT_STATUS_PARSER_H
+#define APT_STATUS_PARSER_H
+
+#include <glib.h>
+
+#include <functional>
+#include <string>
+
+/**
+ * Splits the status stream apt writes while running dpkg into records
+ *
+ * Lines look like "pmstatus:package:percent:message". The data can be
+ * fed in chunks of any size, the parser keeps the unfinished line and
+ * reuses its buffer, records point into it and are only valid during
+ * the callback.
+ */
+class AptStatusParser
+{
+public:
+    struct Record {
+        // pmstatus, pmerror, pmconffile...
+        const gchar *type;
+        // the package, or the config file for pmconffile
+        const gchar *package;
+        double percent;
+        // everything after the third colon, may contain colons itself
+        const gchar *message;
+    };
+
+    typedef std::function<void(const Record &record)> RecordFunc;
+
+    /**
+      * Parses the given data, calling func for every complete line
+      * @note the data is modified in place
+      */
+    void feed(gchar *data, gsize size, const RecordFunc &func);
+
+    /**
+      * Returns whether part of a line is still waiting for its end
+      */
+    bool pending() const;
+
+    /**
+      * Extracts the two quoted file names of a pmconffile message
+      * @returns false if the message does not have them
+      */
+    static bool conffileNames(const gchar *message, std::string &current, std::string &updated);
+
+private:
+    static void parseLine(gchar *line, const RecordFunc &func);
+
+    std::string m_line;
+};
+
+#endif
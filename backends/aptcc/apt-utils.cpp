@@ -156,39 +156,21 @@ PkGroupEnum get_enum_group(string group)
     }
 }
 
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued)
+string parseChangelog(const string &fileName,
+                      const string &srcpkg,
+                      pkgCache::VerIterator currver,
+                      string *update_text,
+                      string *updated,
+                      string *issued)
 {
-    string changelog;
+    string changelog = "Changelog for this version is not yet available";
 
-    pkgAcqChangelog *c = new pkgAcqChangelog(&Fetcher, Ver);
-
-    // try downloading it, if that fails, try third-party-changelogs location
-    // FIXME: Fetcher.Run() is "Continue" even if I get a 404?!?
-    Fetcher.Run();
-
-    // error
-    pkgRecords Recs(CacheFile);
-    pkgCache::PkgIterator Pkg = Ver.ParentPkg();
-    pkgRecords::Parser &rec=Recs.Lookup(Ver.FileList());
-    string srcpkg = rec.SourcePkg().empty() ? Pkg.Name() : rec.SourcePkg();
-    changelog = "Changelog for this version is not yet available";
-
-    // return empty string if we don't have a file to read
-    if (!FileExists(c->DestFile)) {
-        return changelog;
-    }
-
-    if (_error->PendingError()) {
+    // return the notice if we don't have a file to read
+    if (!FileExists(fileName)) {
         return changelog;
     }
 
-    ifstream in(c->DestFile.c_str());
+    ifstream in(fileName.c_str());
     string line;
     g_autoptr(GRegex) regexVer = NULL;
     regexVer = g_regex_new("(?'source'.+) \\((?'version'.*)\\) "
@@ -451,7 +433,8 @@ gchar* utilBuildPackageId(const pkgCache::VerIterator &ver)
 
 const char *utf8(const char *str)
 {
-    static char *_str = NULL;
+    // one buffer per thread, as jobs run in parallel
+    static GPrivate _str = G_PRIVATE_INIT(g_free);
     if (str == NULL) {
         return NULL;
     }
@@ -460,8 +443,6 @@ const char *utf8(const char *str)
         return str;
     }
 
-    g_free(_str);
-    _str = NULL;
-    _str = g_locale_to_utf8(str, -1, NULL, NULL, NULL);
-    return _str;
+    g_private_replace(&_str, g_locale_to_utf8(str, -1, NULL, NULL, NULL));
+    return static_cast<const char *>(g_private_get(&_str));
 }
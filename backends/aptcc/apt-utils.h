@@ -36,15 +36,15 @@ using namespace std;
 PkGroupEnum get_enum_group(string group);
 
 /**
-  * Return the changelog and extract details about the changes.
+  * Return the changelog read from fileName and extract details about
+  * the changes newer than currver.
   */
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued);
+string parseChangelog(const string &fileName,
+                      const string &srcpkg,
+                      pkgCache::VerIterator currver,
+                      string *update_text,
+                      string *updated,
+                      string *issued);
 
 /**
   * Returns a list of links pairs url;description for CVEs
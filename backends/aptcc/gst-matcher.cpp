@@ -24,14 +24,11 @@
 #include <regex.h>
 #include <gst/gst.h>
 
-static bool inited = false;
+static gsize inited = 0;
 
 GstMatcher::GstMatcher(gchar **values)
 {
-    if (!inited) {
-        gst_init(NULL, NULL);
-        inited = true;
-    }
+    init();
 
     // The search term from PackageKit daemon:
     // gstreamer0.10(urisource-foobar)
@@ -54,9 +51,8 @@ GstMatcher::GstMatcher(gchar **values)
             Match values;
             string version, type, data, opt, arch;
 
-            // Appends the version "0.10"
-            version = "\nGstreamer-Version: ";
-            version.append(string(value, matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so));
+            // the version "0.10"
+            version = string(value, matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
 
             // type (encode|decoder...)
             type = string(value, matches[3].rm_so, matches[3].rm_eo - matches[3].rm_so);
@@ -89,15 +85,15 @@ GstMatcher::GstMatcher(gchar **values)
             }
 
             if (type.compare("encoder") == 0) {
-                type = "Gstreamer-Encoders: ";
+                type = "Gstreamer-Encoders";
             } else if (type.compare("decoder") == 0) {
-                type = "Gstreamer-Decoders: ";
+                type = "Gstreamer-Decoders";
             } else if (type.compare("urisource") == 0) {
-                type = "Gstreamer-Uri-Sources: ";
+                type = "Gstreamer-Uri-Sources";
             } else if (type.compare("urisink") == 0) {
-                type = "Gstreamer-Uri-Sinks: ";
+                type = "Gstreamer-Uri-Sinks";
             } else if (type.compare("element") == 0) {
-                type = "Gstreamer-Elements: ";
+                type = "Gstreamer-Elements";
             }
 
             gchar *capsString;
@@ -135,40 +131,49 @@ GstMatcher::~GstMatcher()
     }
 }
 
-bool GstMatcher::matches(string record, string arch)
+void GstMatcher::init()
 {
-    for (const Match &match : m_matches) {
-        // Tries to find "Gstreamer-version: xxx"
-        if (record.find(match.version) != string::npos) {
-            size_t found;
-            if (!match.arch.empty() && arch != match.arch)
-                    continue;
-            found = record.find(match.type);
-            // Tries to find the type "Gstreamer-Uri-Sinks: "
-            if (found != string::npos) {
-                found += match.type.size(); // skips the "Gstreamer-Uri-Sinks: " string
-                size_t endOfLine;
-                endOfLine = record.find('\n', found);
-
-                GstCaps *caps;
-                caps = gst_caps_from_string(record.substr(found, endOfLine - found).c_str());
-                if (caps == NULL) {
-                    continue;
-                }
+    if (g_once_init_enter(&inited)) {
+        gst_init(NULL, NULL);
+        g_once_init_leave(&inited, 1);
+    }
+}
 
-                // if the record is capable of intersect them we found the package
-                bool provides = gst_caps_can_intersect(static_cast<GstCaps*>(match.caps), caps);
-                gst_caps_unref(caps);
+bool GstMatcher::matches(const string &version, const string &type,
+                         const GstCaps *caps, const string &arch) const
+{
+    for (const Match &match : m_matches) {
+        // "1" also matches packages for "1.0"
+        if (!g_str_has_prefix(version.c_str(), match.version.c_str())) {
+            continue;
+        }
+        if (!match.arch.empty() && arch != match.arch) {
+            continue;
+        }
+        if (type != match.type) {
+            continue;
+        }
 
-                if (provides) {
-                    return true;
-                }
-            }
+        // if the record is capable of intersect them we found the package
+        if (gst_caps_can_intersect(static_cast<GstCaps*>(match.caps), caps)) {
+            return true;
         }
     }
     return false;
 }
 
+vector<string> GstMatcher::mediaTypes() const
+{
+    vector<string> ret;
+    for (const Match &match : m_matches) {
+        GstCaps *caps = static_cast<GstCaps*>(match.caps);
+        for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+            ret.push_back(gst_structure_get_name(gst_caps_get_structure(caps, i)));
+        }
+    }
+    return ret;
+}
+
 bool GstMatcher::hasMatches() const
 {
     return !m_matches.empty();
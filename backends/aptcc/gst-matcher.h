@@ -28,6 +28,8 @@
 
 using namespace std;
 
+typedef struct _GstCaps GstCaps;
+
 typedef struct {
     string   version;
     string   type;
@@ -43,7 +45,25 @@ public:
     GstMatcher(gchar **values);
     ~GstMatcher();
 
-    bool matches(string record, string arch);
+    /**
+      * Initializes GStreamer once, caps can't be parsed before
+      */
+    static void init();
+
+    /**
+      * Returns whether a package with the given Gstreamer-Version and
+      * these caps in the given Gstreamer-* field provides one of the
+      * searched codecs
+      */
+    bool matches(const string &version, const string &type,
+                 const GstCaps *caps, const string &arch) const;
+
+    /**
+      * Returns the media types of the searched codecs, only packages
+      * with caps for one of them can match
+      */
+    vector<string> mediaTypes() const;
+
     bool hasMatches() const;
 
 private:
@@ -36,12 +36,18 @@
 
 #include "apt-intf.h"
 #include "apt-cache-file.h"
+#include "apt-changelog-cache.h"
+#include "apt-file-index.h"
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "apt-sourceslist.h"
 
 /* static bodges */
 static PkBackendSpawn *spawn;
+static AptSharedCache *sharedCache;
+static GFileMonitor *listsMonitor;
+static AptFileIndex *fileIndex;
+static AptChangelogCache *changelogCache;
 
 const gchar* pk_backend_get_description(PkBackend *backend)
 {
@@ -56,8 +62,25 @@ const gchar* pk_backend_get_author(PkBackend *backend)
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-    // we need to set this to TRUE as soon as the parallelization work is completed!
-    return FALSE;
+    // queries share one cache and run in parallel, jobs changing the
+    // system wait in AptIntf::init() until they have it to themselves
+    return TRUE;
+}
+
+static void pk_backend_aptcc_status_changed_cb(PkBackend *backend, gpointer data)
+{
+    g_debug("dpkg status changed, dropping the shared cache");
+    sharedCache->invalidate();
+}
+
+static void pk_backend_aptcc_lists_changed_cb(GFileMonitor *monitor,
+                                              GFile *file,
+                                              GFile *other_file,
+                                              GFileMonitorEvent event_type,
+                                              gpointer user_data)
+{
+    g_debug("package lists changed, dropping the shared cache");
+    sharedCache->invalidate();
 }
 
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
@@ -83,14 +106,46 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
         g_debug("ERROR initializing backend system");
     }
 
+    // default settings, set once as jobs read the config in parallel
+    _config->CndSet("APT::Get::AutomaticRemove::Kernels", _config->FindB("APT::Get::AutomaticRemove", true));
+
     spawn = pk_backend_spawn_new(conf);
     //     pk_backend_spawn_set_job(spawn, backend);
     pk_backend_spawn_set_name(spawn, "aptcc");
+
+    // Queries share one cache until the installed or available packages change
+    sharedCache = new AptSharedCache;
+    const string statusFile = _config->FindFile("Dir::State::status");
+    pk_backend_watch_file(backend, statusFile.c_str(), pk_backend_aptcc_status_changed_cb, NULL);
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GFile) lists = g_file_new_for_path(_config->FindDir("Dir::State::lists").c_str());
+    listsMonitor = g_file_monitor_directory(lists, G_FILE_MONITOR_NONE, NULL, &error);
+    if (listsMonitor == NULL) {
+        g_warning("Failed to watch the package lists: %s", error->message);
+    } else {
+        g_signal_connect(listsMonitor, "changed",
+                         G_CALLBACK(pk_backend_aptcc_lists_changed_cb), NULL);
+    }
+
+    // Maps installed files to packages, kept up to date by SearchFile itself
+    fileIndex = new AptFileIndex;
+
+    // Downloaded changelogs, shared by all GetUpdateDetail calls
+    changelogCache = new AptChangelogCache;
 }
 
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APTcc being destroyed");
+
+    g_clear_object(&listsMonitor);
+    delete sharedCache;
+    sharedCache = nullptr;
+    delete fileIndex;
+    fileIndex = nullptr;
+    delete changelogCache;
+    changelogCache = nullptr;
 }
 
 PkBitfield pk_backend_get_groups(PkBackend *backend)
@@ -152,7 +207,7 @@ gchar** pk_backend_get_mime_types(PkBackend *backend)
 void pk_backend_start_job(PkBackend *backend, PkBackendJob *job)
 {
     /* create private state for this job */
-    AptIntf *apt = new AptIntf(job);
+    AptIntf *apt = new AptIntf(job, sharedCache);
     pk_backend_job_set_user_data(job, apt);
 }
 
@@ -163,6 +218,22 @@ void pk_backend_stop_job(PkBackend *backend, PkBackendJob *job)
         delete apt;
     }
 
+    /* don't wait for the file monitors to notice our own changes */
+    switch (pk_backend_job_get_role(job)) {
+    case PK_ROLE_ENUM_INSTALL_FILES:
+    case PK_ROLE_ENUM_INSTALL_PACKAGES:
+    case PK_ROLE_ENUM_REMOVE_PACKAGES:
+    case PK_ROLE_ENUM_UPDATE_PACKAGES:
+    case PK_ROLE_ENUM_REPAIR_SYSTEM:
+    case PK_ROLE_ENUM_REFRESH_CACHE:
+    case PK_ROLE_ENUM_REPO_ENABLE:
+    case PK_ROLE_ENUM_REPO_REMOVE:
+        sharedCache->invalidate();
+        break;
+    default:
+        break;
+    }
+
     /* make debugging easier */
     pk_backend_job_set_user_data (job, NULL);
 }
@@ -329,7 +400,7 @@ static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpoi
     }
 
     if (role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-        apt->emitUpdateDetails(pkgs);
+        apt->emitUpdateDetails(changelogCache, pkgs);
     } else {
         apt->emitDetails(pkgs);
     }
@@ -637,7 +708,7 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
 
         pk_backend_job_set_status(job, PK_STATUS_ENUM_QUERY);
         PkgList output;
-        output = apt->searchPackageFiles(search);
+        output = apt->searchPackageFiles(fileIndex, search);
 
         // It's faster to emit the packages here rather than in the matching part
         apt->emitPackages(output, filters);
@@ -889,6 +960,11 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                        &enabled);
     }
 
+    // enabling and removing rewrite sources.list, and autoremove runs
+    // dpkg, so they wait until nobody else reads it
+    AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    apt->lockGate();
+
     SourcesList sourcesList;
     if (sourcesList.ReadSources() == false) {
         _error->
@@ -943,7 +1019,6 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                 }
             } else if (role == PK_ROLE_ENUM_REPO_REMOVE) {
                 if (autoremove) {
-                    AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
                     if (!apt->init()) {
                         g_debug("Failed to create apt cache");
                         return;
@@ -0,0 +1,246 @@
+/* changelog-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include <packagekit-glib2/pk-update-detail.h>
+
+#include "apt-cache-file.h"
+#include "apt-changelog-cache.h"
+#include "apt-intf.h"
+
+/* two binaries built from one source, both with an update pending */
+static const gchar *package_ids[] = {
+	"pk-changelog-bin;2.0-1;amd64;stable",
+	"pk-changelog-lib;2.0-1;amd64;stable",
+	NULL
+};
+
+static const gchar *changelog =
+	"pk-changelog (2.0-1) unstable; urgency=medium\n"
+	"\n"
+	"  * Fix the crash on startup (Closes: #123456)\n"
+	"\n"
+	" -- PackageKit <packagekit@example.org>  Mon, 19 Oct 2026 12:00:00 +0000\n"
+	"\n"
+	"pk-changelog (1.0-1) unstable; urgency=medium\n"
+	"\n"
+	"  * Initial release.\n"
+	"\n"
+	" -- PackageKit <packagekit@example.org>  Thu, 01 Jan 2026 12:00:00 +0000\n";
+
+static gchar *root;
+static GKeyFile *conf;
+
+static void
+write_path (const gchar *path, const gchar *contents)
+{
+	g_autofree gchar *parent = g_path_get_dirname (path);
+
+	g_assert_cmpint (g_mkdir_with_parents (parent, 0755), ==, 0);
+	g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+}
+
+static void
+write_file (const gchar *dir, const gchar *name, const gchar *contents)
+{
+	g_autofree gchar *path = g_build_filename (root, dir, name, NULL);
+	write_path (path, contents);
+}
+
+static void
+write_package (GString *str, const gchar *name, const gchar *version, gboolean installed)
+{
+	g_string_append_printf (str, "Package: %s\n", name);
+	if (installed)
+		g_string_append (str, "Status: install ok installed\n");
+	g_string_append_printf (str,
+				"Source: pk-changelog\n"
+				"Architecture: amd64\n"
+				"Version: %s\n"
+				"Maintainer: PackageKit <packagekit@example.org>\n",
+				version);
+	if (!installed) {
+		g_string_append_printf (str, "Filename: pool/main/p/pk-changelog/%s_%s_amd64.deb\n"
+					"Size: 1024\n",
+					name, version);
+	}
+	g_string_append_printf (str, "Description: PackageKit changelog test %s\n\n", name);
+}
+
+static AptIntf *
+open_apt (PkBackendJob *job, PkgList &pkgs)
+{
+	AptIntf *apt = new AptIntf (job);
+
+	if (!apt->init ())
+		g_error ("failed to open the test cache");
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		const pkgCache::VerIterator &ver = apt->aptCacheFile ()->resolvePkgID (package_ids[i]);
+		g_assert_false (ver.end ());
+		pkgs.push_back (ver);
+	}
+	return apt;
+}
+
+static void
+update_detail_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	GPtrArray *details = (GPtrArray *) user_data;
+	g_ptr_array_add (details, g_object_ref (object));
+}
+
+static void
+test_changelog_fetch (void)
+{
+	g_autoptr(PkBackendJob) job = pk_backend_job_new (conf);
+	g_autoptr(GPtrArray) details = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autofree gchar *cache_dir = g_build_filename (root, "cache", "changelogs", NULL);
+	AptChangelogCache changelogs (cache_dir);
+	PkgList pkgs;
+
+	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_UPDATE_DETAIL);
+	pk_backend_job_set_parameters (job, g_variant_new ("(^as)", package_ids));
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_UPDATE_DETAIL,
+				  update_detail_cb, details);
+	AptIntf *apt = open_apt (job, pkgs);
+
+	/* publish the changelog where the mirror says it is */
+	std::string uri = pkgAcqChangelog::URI (pkgs.front ());
+	g_assert_true (g_str_has_prefix (uri.c_str (), "file://"));
+	const std::string mirror_file = uri.substr (strlen ("file://"));
+	write_path (mirror_file.c_str (), changelog);
+
+	/* both binaries share the one download */
+	const std::string path = changelogs.path (apt->aptCacheFile (), pkgs.front ());
+	g_assert_cmpstr (path.c_str (), ==, changelogs.path (apt->aptCacheFile (), pkgs.back ()).c_str ());
+	g_assert_true (g_str_has_suffix (path.c_str (), "/pk-changelog_2.0-1.changelog"));
+	changelogs.fetch (apt->aptCacheFile (), pkgs, NULL);
+	g_assert_true (g_file_test (path.c_str (), G_FILE_TEST_IS_REGULAR));
+
+	/* from now on it is read from the cache */
+	g_assert_cmpint (g_unlink (mirror_file.c_str ()), ==, 0);
+	apt->emitUpdateDetails (&changelogs, pkgs);
+	while (g_main_context_iteration (NULL, FALSE));
+
+	g_assert_cmpuint (details->len, ==, 2);
+	for (guint i = 0; i < details->len; i++) {
+		PkUpdateDetail *item = PK_UPDATE_DETAIL (g_ptr_array_index (details, i));
+		g_assert_nonnull (strstr (pk_update_detail_get_changelog (item), "Fix the crash on startup"));
+		g_assert_nonnull (strstr (pk_update_detail_get_update_text (item), "== 2.0-1 =="));
+		g_assert_null (strstr (pk_update_detail_get_update_text (item), "Initial release"));
+		g_assert_nonnull (pk_update_detail_get_bugzilla_urls (item)[0]);
+		g_assert_nonnull (strstr (pk_update_detail_get_bugzilla_urls (item)[0], "123456"));
+	}
+
+	delete apt;
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+		const gchar *name;
+		while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+			g_autofree gchar *child = g_build_filename (path, name, NULL);
+			remove_tree (child);
+		}
+		g_rmdir (path);
+	} else {
+		g_unlink (path);
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	const gchar *dirs[] = { "etc/apt/preferences.d", "etc/apt/sources.list.d",
+				"var/lib/apt/lists/partial", "var/cache/apt/archives/partial", NULL };
+	g_autoptr(GString) status = g_string_new (NULL);
+	g_autoptr(GString) packages = g_string_new (NULL);
+	g_autofree gchar *root_dir = NULL;
+	g_autofree gchar *status_file = NULL;
+	g_autofree gchar *mirror = NULL;
+	int ret;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* a system with version 1.0-1 installed and a mirror with 2.0-1 */
+	root = g_dir_make_tmp ("pk-aptcc-changelog-XXXXXX", NULL);
+	g_assert_nonnull (root);
+	for (guint i = 0; dirs[i] != NULL; i++) {
+		g_autofree gchar *path = g_build_filename (root, dirs[i], NULL);
+		g_assert_cmpint (g_mkdir_with_parents (path, 0755), ==, 0);
+	}
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_auto(GStrv) split = pk_package_id_split (package_ids[i]);
+		write_package (status, split[PK_PACKAGE_ID_NAME], "1.0-1", TRUE);
+		write_package (packages, split[PK_PACKAGE_ID_NAME], "2.0-1", FALSE);
+	}
+	write_file ("var/lib/dpkg", "status", status->str);
+	write_file ("var/lib/apt/lists", "example.org_debian_dists_stable_main_binary-amd64_Packages",
+		    packages->str);
+	write_file ("var/lib/apt/lists", "example.org_debian_dists_stable_Release",
+		    "Origin: PackageKit\n"
+		    "Label: PackageKit\n"
+		    "Suite: stable\n"
+		    "Codename: stable\n"
+		    "Architectures: amd64\n"
+		    "Components: main\n");
+	write_file ("etc/apt", "sources.list",
+		    "deb [trusted=yes arch=amd64] http://example.org/debian stable main\n");
+
+	if (!pkgInitConfig (*_config))
+		g_error ("failed to initialize the apt config");
+	root_dir = g_strconcat (root, "/", NULL);
+	status_file = g_build_filename (root, "var", "lib", "dpkg", "status", NULL);
+	mirror = g_strconcat ("file://", root, "/mirror/@CHANGEPATH@/changelog", NULL);
+	_config->Set ("Dir", root_dir);
+	_config->Set ("Dir::State::status", status_file);
+	_config->Set ("Dir::Cache::pkgcache", "");
+	_config->Set ("Dir::Cache::srcpkgcache", "");
+	_config->Set ("Debug::NoLocking", true);
+	_config->Set ("APT::Architecture", "amd64");
+	_config->Clear ("APT::Architectures");
+	_config->Set ("APT::Architectures::", "amd64");
+	_config->Set ("Acquire::Changelogs::URI::Override::Origin::PackageKit", mirror);
+	if (!pkgInitSystem (*_config, _system))
+		g_error ("failed to initialize the apt system");
+
+	conf = g_key_file_new ();
+
+	g_test_add_func ("/aptcc/changelog/fetch", test_changelog_fetch);
+
+	ret = g_test_run ();
+	g_key_file_unref (conf);
+	remove_tree (root);
+	g_free (root);
+	return ret;
+}
@@ -0,0 +1,207 @@
+/* file-index-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "apt-file-index.h"
+
+typedef struct {
+	gchar *dir;
+	gchar *info_dir;
+	gchar *index_file;
+} FileIndexFixture;
+
+static void
+write_list (FileIndexFixture *fixture, const gchar *package, const gchar *contents)
+{
+	g_autofree gchar *name = g_strdup_printf ("%s.list", package);
+	g_autofree gchar *path = g_build_filename (fixture->info_dir, name, NULL);
+	g_autofree gchar *tmp = g_strdup_printf ("%s-new", path);
+
+	/* like dpkg, so the directory mtime changes */
+	g_assert_true (g_file_set_contents (tmp, contents, -1, NULL));
+	g_assert_cmpint (g_rename (tmp, path), ==, 0);
+}
+
+static gchar *
+search (AptFileIndex &index, const gchar *value)
+{
+	const gchar *values[] = { value, NULL };
+	std::vector<std::string> names = index.search ((gchar **) values);
+	g_autoptr(GString) str = g_string_new (NULL);
+
+	for (const std::string &name : names) {
+		if (str->len > 0)
+			g_string_append_c (str, ',');
+		g_string_append (str, name.c_str ());
+	}
+	return g_string_free (g_steal_pointer (&str), FALSE);
+}
+
+static void
+fixture_setup (FileIndexFixture *fixture, gconstpointer user_data)
+{
+	fixture->dir = g_dir_make_tmp ("pk-aptcc-file-index-XXXXXX", NULL);
+	g_assert_nonnull (fixture->dir);
+	fixture->info_dir = g_build_filename (fixture->dir, "info", NULL);
+	fixture->index_file = g_build_filename (fixture->dir, "cache", "files.idx", NULL);
+	g_assert_cmpint (g_mkdir (fixture->info_dir, 0755), ==, 0);
+
+	write_list (fixture, "coreutils",
+		    "/.\n/bin\n/bin/ls\n/bin/cat\n/usr/share/doc/coreutils\n");
+	write_list (fixture, "busybox:amd64",
+		    "/.\n/bin\n/bin/busybox\n/usr/sbin/ls\n");
+	write_list (fixture, "fonts",
+		    "/.\n/usr/share/fonts/DejaVuSans.ttf\n");
+	write_list (fixture, "g++",
+		    "/.\n/usr/bin/g++\n");
+	write_list (fixture, "libstdc++6",
+		    "/.\n/usr/lib/x86_64-linux-gnu/libstdc++.so.6\n");
+}
+
+static void
+fixture_teardown (FileIndexFixture *fixture, gconstpointer user_data)
+{
+	g_autoptr(GDir) dir = NULL;
+	const gchar *name;
+
+	dir = g_dir_open (fixture->info_dir, 0, NULL);
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *path = g_build_filename (fixture->info_dir, name, NULL);
+		g_unlink (path);
+	}
+	g_rmdir (fixture->info_dir);
+	g_unlink (fixture->index_file);
+	g_autofree gchar *cache_dir = g_path_get_dirname (fixture->index_file);
+	g_rmdir (cache_dir);
+	g_rmdir (fixture->dir);
+
+	g_free (fixture->dir);
+	g_free (fixture->info_dir);
+	g_free (fixture->index_file);
+}
+
+static void
+test_file_index_search (FileIndexFixture *fixture, gconstpointer user_data)
+{
+	AptFileIndex index (fixture->info_dir, fixture->index_file);
+	gchar *found;
+
+	/* exact paths */
+	found = search (index, "/bin/ls");
+	g_assert_cmpstr (found, ==, "coreutils");
+	g_free (found);
+	found = search (index, "/bin");
+	g_assert_cmpstr (found, ==, "busybox:amd64,coreutils");
+	g_free (found);
+	found = search (index, "/bin/l");
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+
+	/* base names and suffixes */
+	found = search (index, "ls");
+	g_assert_cmpstr (found, ==, "busybox:amd64,coreutils");
+	g_free (found);
+	found = search (index, "sbin/ls");
+	g_assert_cmpstr (found, ==, "busybox:amd64");
+	g_free (found);
+	found = search (index, "box");
+	g_assert_cmpstr (found, ==, "busybox:amd64");
+	g_free (found);
+	found = search (index, "Sans.ttf");
+	g_assert_cmpstr (found, ==, "fonts");
+	g_free (found);
+
+	/* '+' is part of the name */
+	found = search (index, "/usr/bin/g++");
+	g_assert_cmpstr (found, ==, "g++");
+	g_free (found);
+	found = search (index, "libstdc++.so.6");
+	g_assert_cmpstr (found, ==, "libstdc++6");
+	g_free (found);
+
+	/* basic regular expressions still work */
+	found = search (index, "/bin/[cb].*");
+	g_assert_cmpstr (found, ==, "busybox:amd64,coreutils");
+	g_free (found);
+	found = search (index, "^/usr/bin/g++$");
+	g_assert_cmpstr (found, ==, "g++");
+	g_free (found);
+	found = search (index, "libstdc++.so.6$");
+	g_assert_cmpstr (found, ==, "libstdc++6");
+	g_free (found);
+	found = search (index, "/bin/(cat|busybox)");
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+}
+
+static void
+test_file_index_update (FileIndexFixture *fixture, gconstpointer user_data)
+{
+	g_autofree gchar *path = g_build_filename (fixture->info_dir, "fonts.list", NULL);
+	gchar *found;
+
+	{
+		AptFileIndex index (fixture->info_dir, fixture->index_file);
+		found = search (index, "cat");
+		g_assert_cmpstr (found, ==, "coreutils");
+		g_free (found);
+
+		/* a package changes and another one goes away */
+		write_list (fixture, "coreutils", "/.\n/bin\n/bin/ls\n/bin/dog\n");
+		g_assert_cmpint (g_unlink (path), ==, 0);
+
+		found = search (index, "cat");
+		g_assert_cmpstr (found, ==, "");
+		g_free (found);
+		found = search (index, "/bin/dog");
+		g_assert_cmpstr (found, ==, "coreutils");
+		g_free (found);
+		found = search (index, "DejaVuSans.ttf");
+		g_assert_cmpstr (found, ==, "");
+		g_free (found);
+	}
+
+	g_assert_true (g_file_test (fixture->index_file, G_FILE_TEST_EXISTS));
+
+	/* a new instance picks up the saved index */
+	AptFileIndex index (fixture->info_dir, fixture->index_file);
+	found = search (index, "dog");
+	g_assert_cmpstr (found, ==, "coreutils");
+	g_free (found);
+	found = search (index, "ls");
+	g_assert_cmpstr (found, ==, "busybox:amd64,coreutils");
+	g_free (found);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/aptcc/file-index/search", FileIndexFixture, NULL,
+		    fixture_setup, test_file_index_search, fixture_teardown);
+	g_test_add ("/aptcc/file-index/update", FileIndexFixture, NULL,
+		    fixture_setup, test_file_index_update, fixture_teardown);
+
+	return g_test_run ();
+}
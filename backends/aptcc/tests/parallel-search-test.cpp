@@ -0,0 +1,133 @@
+/* parallel-search-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <locale.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include "apt-cache-file.h"
+#include "apt-intf.h"
+
+#define N_SEARCHES	16
+
+/* pk-fixture-alpha, pk-fixture-beta and pk-fixture-gamma */
+#define N_FIXTURE_PACKAGES	3
+
+static GKeyFile *conf;
+static AptSharedCache *sharedCache;
+
+static gpointer
+search_thread (gpointer user_data)
+{
+	guint idx = GPOINTER_TO_UINT (user_data);
+	const gchar *values[] = { "fixture", NULL };
+	PkRoleEnum role;
+	PkgList output;
+	g_autoptr(PkBackendJob) job = NULL;
+
+	/* half search the names, half the descriptions */
+	role = idx % 2 == 0 ? PK_ROLE_ENUM_SEARCH_NAME : PK_ROLE_ENUM_SEARCH_DETAILS;
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_role (job, role);
+	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
+							   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							   values));
+	pk_backend_job_set_locale (job, idx % 3 == 0 ? "C.UTF-8" : "C");
+
+	AptIntf *apt = new AptIntf (job, sharedCache);
+	g_assert_true (apt->init ());
+	g_assert_true (apt->usesSharedCache ());
+
+	std::vector<std::string> queries = { "fixture" };
+	if (role == PK_ROLE_ENUM_SEARCH_NAME)
+		output = apt->searchPackageName (queries);
+	else
+		output = apt->searchPackageDetails (queries);
+	output.removeDuplicates ();
+
+	delete apt;
+	return GUINT_TO_POINTER (output.size ());
+}
+
+static void
+test_parallel_search (void)
+{
+	GThread *threads[N_SEARCHES];
+	guint i;
+	g_autofree gchar *locale = g_strdup (setlocale (LC_ALL, NULL));
+	g_autofree gchar *lang = g_strdup (g_getenv ("LANG"));
+
+	/* all of them at once against the same cache */
+	for (i = 0; i < N_SEARCHES; i++) {
+		g_autofree gchar *name = g_strdup_printf ("search-%u", i);
+		threads[i] = g_thread_new (name, search_thread, GUINT_TO_POINTER (i));
+	}
+	for (i = 0; i < N_SEARCHES; i++) {
+		guint found = GPOINTER_TO_UINT (g_thread_join (threads[i]));
+		g_assert_cmpuint (found, ==, N_FIXTURE_PACKAGES);
+	}
+
+	/* queries use their locale without changing the process one */
+	g_assert_cmpstr (setlocale (LC_ALL, NULL), ==, locale);
+	g_assert_cmpstr (g_getenv ("LANG"), ==, lang);
+}
+
+static void
+test_parallel_search_invalidated (void)
+{
+	/* the cache is reopened once and then shared again */
+	sharedCache->invalidate ();
+	test_parallel_search ();
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	/* use the fixture instead of the system */
+	if (!pkgInitConfig (*_config))
+		g_error ("failed to initialize the apt config");
+	_config->Set ("Dir", TESTDATADIR "/");
+	_config->Set ("Dir::State::status", TESTDATADIR "/var/lib/dpkg/status");
+	_config->Set ("Dir::Cache::pkgcache", "");
+	_config->Set ("Dir::Cache::srcpkgcache", "");
+	_config->Set ("Debug::NoLocking", true);
+	_config->Set ("APT::Architecture", "amd64");
+	_config->Clear ("APT::Architectures");
+	_config->Set ("APT::Architectures::", "amd64");
+	if (!pkgInitSystem (*_config, _system))
+		g_error ("failed to initialize the apt system");
+
+	conf = g_key_file_new ();
+	sharedCache = new AptSharedCache;
+
+	g_test_add_func ("/aptcc/parallel-search", test_parallel_search);
+	g_test_add_func ("/aptcc/parallel-search-invalidated", test_parallel_search_invalidated);
+
+	int ret = g_test_run ();
+	delete sharedCache;
+	g_key_file_unref (conf);
+	return ret;
+}
@@ -0,0 +1,149 @@
+/* provides-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include "apt-cache-file.h"
+#include "apt-intf.h"
+
+static GKeyFile *conf;
+static AptSharedCache *sharedCache;
+
+typedef enum {
+	PROVIDES_CODEC,
+	PROVIDES_LIBRARY
+} ProvidesKind;
+
+/* the names of the packages providing value, sorted */
+static gchar *
+what_provides (ProvidesKind kind, const gchar *value)
+{
+	const gchar *values[] = { value, NULL };
+	g_autoptr(PkBackendJob) job = NULL;
+	g_autoptr(GString) names = g_string_new (NULL);
+	PkgList output;
+
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_role (job, PK_ROLE_ENUM_WHAT_PROVIDES);
+	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
+							   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							   values));
+
+	AptIntf *apt = new AptIntf (job, sharedCache);
+	g_assert_true (apt->init ());
+	if (kind == PROVIDES_CODEC)
+		apt->providesCodec (output, (gchar **) values);
+	else
+		apt->providesLibrary (output, (gchar **) values);
+	output.sort ();
+	output.removeDuplicates ();
+
+	for (const pkgCache::VerIterator &ver : output) {
+		if (names->len > 0)
+			g_string_append_c (names, ' ');
+		g_string_append (names, ver.ParentPkg ().Name ());
+	}
+
+	delete apt;
+	return g_string_free (g_steal_pointer (&names), FALSE);
+}
+
+static void
+test_provides_codec (void)
+{
+	struct {
+		const gchar *value;
+		const gchar *names;
+	} tests[] = {
+		{ "gstreamer1(decoder-audio/x-wma)(wmaversion=2)", "gstreamer1.0-pk-codecs" },
+		{ "gstreamer1.0(decoder-video/x-wmv)", "gstreamer1.0-pk-codecs" },
+		{ "gstreamer1(decoder-audio/x-wma)(wmaversion=3)", "" },
+		{ "gstreamer1(encoder-audio/x-wma)", "" },
+		{ "gstreamer0.10(decoder-audio/x-wma)", "" },
+		{ "gstreamer1(decoder-audio/mpeg)", "" },
+	};
+
+	/* the second round is answered from the same index */
+	for (guint round = 0; round < 2; round++) {
+		for (guint i = 0; i < G_N_ELEMENTS (tests); i++) {
+			g_autofree gchar *names = what_provides (PROVIDES_CODEC, tests[i].value);
+			g_assert_cmpstr (names, ==, tests[i].names);
+		}
+	}
+}
+
+static void
+test_provides_library (void)
+{
+	g_autofree gchar *names = NULL;
+
+	names = what_provides (PROVIDES_LIBRARY, "libpkcodec.so.2");
+	g_assert_cmpstr (names, ==, "libpkcodec2");
+	g_clear_pointer (&names, g_free);
+	names = what_provides (PROVIDES_LIBRARY, "libpkcodec.so.3");
+	g_assert_cmpstr (names, ==, "");
+}
+
+static gboolean
+log_fatal_cb (const gchar *log_domain,
+	      GLogLevelFlags log_level,
+	      const gchar *message,
+	      gpointer user_data)
+{
+	/* the system running the test may have no AppStream data at all */
+	return !g_str_has_prefix (message, "Issue while loading the AppStream metadata pool");
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+	g_test_log_set_fatal_handler (log_fatal_cb, NULL);
+
+	/* use the fixture instead of the system */
+	if (!pkgInitConfig (*_config))
+		g_error ("failed to initialize the apt config");
+	_config->Set ("Dir", TESTDATADIR "/");
+	_config->Set ("Dir::State::status", TESTDATADIR "/var/lib/dpkg/status");
+	_config->Set ("Dir::Cache::pkgcache", "");
+	_config->Set ("Dir::Cache::srcpkgcache", "");
+	_config->Set ("Debug::NoLocking", true);
+	_config->Set ("APT::Architecture", "amd64");
+	_config->Clear ("APT::Architectures");
+	_config->Set ("APT::Architectures::", "amd64");
+	if (!pkgInitSystem (*_config, _system))
+		g_error ("failed to initialize the apt system");
+
+	conf = g_key_file_new ();
+	sharedCache = new AptSharedCache;
+
+	g_test_add_func ("/aptcc/provides/codec", test_provides_codec);
+	g_test_add_func ("/aptcc/provides/library", test_provides_library);
+
+	int ret = g_test_run ();
+	delete sharedCache;
+	g_key_file_unref (conf);
+	return ret;
+}
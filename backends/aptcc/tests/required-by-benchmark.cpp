@@ -0,0 +1,166 @@
+/* required-by-benchmark.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include "apt-cache-file.h"
+#include "apt-intf.h"
+
+/* packages depending on libc6, each also depending on the one at half
+ * its index, so the recursive closure is a tree a few levels deep */
+#define N_PACKAGES	20000
+
+static void
+write_status (const gchar *path)
+{
+	g_autoptr(GString) status = g_string_new (NULL);
+
+	g_string_append (status,
+			 "Package: libc6\n"
+			 "Status: install ok installed\n"
+			 "Priority: required\n"
+			 "Architecture: amd64\n"
+			 "Multi-Arch: same\n"
+			 "Version: 2.36-9\n"
+			 "Description: GNU C Library: Shared libraries\n\n");
+	for (guint i = 1; i <= N_PACKAGES; i++) {
+		g_string_append_printf (status,
+					"Package: pk-bench-%u\n"
+					"Status: install ok installed\n"
+					"Architecture: amd64\n"
+					"Version: 1.0-1\n",
+					i);
+		if (i > 1)
+			g_string_append_printf (status, "Depends: libc6 (>= 2.36), pk-bench-%u\n", i / 2);
+		else
+			g_string_append (status, "Depends: libc6 (>= 2.36)\n");
+		g_string_append_printf (status, "Description: RequiredBy benchmark package %u\n\n", i);
+	}
+
+	if (!g_file_set_contents (path, status->str, status->len, NULL))
+		g_error ("failed to write %s", path);
+}
+
+static guint
+required_by (GKeyFile *conf, gboolean recursive, gdouble *elapsed)
+{
+	g_autoptr(GTimer) timer = NULL;
+	const gchar *package_ids[] = { "libc6;2.36-9;amd64;installed", NULL };
+	g_autoptr(PkBackendJob) job = NULL;
+	PkgList output;
+
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_role (job, PK_ROLE_ENUM_REQUIRED_BY);
+	pk_backend_job_set_parameters (job, g_variant_new ("(t^asb)",
+							   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							   package_ids,
+							   recursive));
+
+	AptIntf *apt = new AptIntf (job);
+	if (!apt->init ())
+		g_error ("failed to open the benchmark cache");
+
+	const pkgCache::VerIterator &ver = apt->aptCacheFile ()->resolvePkgID (package_ids[0]);
+	g_assert_false (ver.end ());
+
+	/* only the query, not opening the cache */
+	timer = g_timer_new ();
+	apt->getRequires (output, ver, recursive);
+	*elapsed = g_timer_elapsed (timer, NULL);
+	output.sort ();
+	output.removeDuplicates ();
+
+	delete apt;
+	return output.size ();
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+		const gchar *name;
+		while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+			g_autofree gchar *child = g_build_filename (path, name, NULL);
+			remove_tree (child);
+		}
+		g_rmdir (path);
+	} else {
+		g_unlink (path);
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	const gchar *dirs[] = { "etc/apt/sources.list.d", "etc/apt/preferences.d",
+				"var/lib/apt/lists/partial", "var/lib/dpkg",
+				"var/cache/apt/archives/partial", NULL };
+	g_autoptr(GKeyFile) conf = g_key_file_new ();
+	g_autofree gchar *status = NULL;
+	g_autofree gchar *sources = NULL;
+	g_autofree gchar *root_dir = NULL;
+	g_autofree gchar *root = NULL;
+	gdouble elapsed;
+	guint found;
+
+	/* a system with nothing but the benchmark packages installed */
+	root = g_dir_make_tmp ("pk-aptcc-bench-XXXXXX", NULL);
+	g_assert_nonnull (root);
+	for (guint i = 0; dirs[i] != NULL; i++) {
+		g_autofree gchar *path = g_build_filename (root, dirs[i], NULL);
+		g_assert_cmpint (g_mkdir_with_parents (path, 0755), ==, 0);
+	}
+	sources = g_build_filename (root, "etc", "apt", "sources.list", NULL);
+	g_assert_true (g_file_set_contents (sources, "", 0, NULL));
+	status = g_build_filename (root, "var", "lib", "dpkg", "status", NULL);
+	write_status (status);
+
+	if (!pkgInitConfig (*_config))
+		g_error ("failed to initialize the apt config");
+	root_dir = g_strconcat (root, "/", NULL);
+	_config->Set ("Dir", root_dir);
+	_config->Set ("Dir::State::status", status);
+	_config->Set ("Dir::Cache::pkgcache", "");
+	_config->Set ("Dir::Cache::srcpkgcache", "");
+	_config->Set ("Debug::NoLocking", true);
+	_config->Set ("APT::Architecture", "amd64");
+	_config->Clear ("APT::Architectures");
+	_config->Set ("APT::Architectures::", "amd64");
+	if (!pkgInitSystem (*_config, _system))
+		g_error ("failed to initialize the apt system");
+
+	found = required_by (conf, FALSE, &elapsed);
+	g_print ("RequiredBy libc6: %u packages in %.3f s\n", found, elapsed);
+	g_assert_cmpuint (found, ==, N_PACKAGES);
+
+	found = required_by (conf, TRUE, &elapsed);
+	g_print ("RequiredBy libc6, recursive: %u packages in %.3f s\n", found, elapsed);
+	g_assert_cmpuint (found, ==, N_PACKAGES);
+
+	remove_tree (root);
+	return 0;
+}
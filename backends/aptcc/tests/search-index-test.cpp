@@ -0,0 +1,514 @@
+/* search-index-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgrecords.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include "apt-cache-file.h"
+#include "apt-search-index.h"
+
+#define PACKAGES_FILE	"var/lib/apt/lists/example.org_debian_dists_stable_main_binary-amd64_Packages"
+
+/* enough names for the short queries to be split between threads */
+#define N_GENERATED_PACKAGES	40000
+
+static GKeyFile *conf;
+
+typedef struct {
+	gchar *dir;
+	gchar *packages_file;
+	gchar *index_file;
+	PkBackendJob *job;
+	AptCacheFile *cache;
+} SearchIndexFixture;
+
+static const gchar *fixture_files[] = {
+	"etc/apt/sources.list",
+	"var/lib/apt/lists/example.org_debian_dists_stable_Release",
+	PACKAGES_FILE,
+	"var/lib/dpkg/status",
+};
+
+static std::string
+fold_case (const std::string &str)
+{
+	std::string folded (str);
+	for (char &ch : folded)
+		ch = g_ascii_tolower (ch);
+	return folded;
+}
+
+static void
+open_cache (SearchIndexFixture *fixture)
+{
+	delete fixture->cache;
+	fixture->cache = new AptCacheFile (fixture->job);
+	g_assert_true (fixture->cache->Open (false));
+}
+
+/* the names of the packages set in ids, sorted */
+static gchar *
+names_of (SearchIndexFixture *fixture, const std::vector<bool> &ids)
+{
+	std::vector<std::string> names;
+	g_autoptr(GString) str = g_string_new (NULL);
+
+	g_assert_cmpuint (ids.size (), ==, (*fixture->cache)->Head ().PackageCount);
+	for (pkgCache::PkgIterator pkg = (*fixture->cache)->PkgBegin (); !pkg.end (); ++pkg) {
+		if (ids[pkg->ID])
+			names.push_back (pkg.Name ());
+	}
+	std::sort (names.begin (), names.end ());
+
+	for (const std::string &name : names) {
+		if (str->len > 0)
+			g_string_append_c (str, ',');
+		g_string_append (str, name.c_str ());
+	}
+	return g_string_free (g_steal_pointer (&str), FALSE);
+}
+
+static gchar *
+search_details (SearchIndexFixture *fixture,
+		AptDetailsIndex &index,
+		const std::vector<std::string> &queries)
+{
+	return names_of (fixture, index.candidates (queries));
+}
+
+static gchar *
+search_names (SearchIndexFixture *fixture,
+	      AptNameIndex &index,
+	      const std::vector<std::string> &queries)
+{
+	return names_of (fixture, index.matches (queries));
+}
+
+/* what the search roles finally keep, the query anywhere in the name
+ * or one of the descriptions */
+static void
+assert_details_superset (SearchIndexFixture *fixture,
+			 AptDetailsIndex &index,
+			 const std::string &query)
+{
+	std::vector<bool> candidates = index.candidates ({ query });
+	const std::string folded = fold_case (query);
+
+	for (pkgCache::PkgIterator pkg = (*fixture->cache)->PkgBegin (); !pkg.end (); ++pkg) {
+		std::string text = pkg.Name ();
+
+		for (pkgCache::VerIterator ver = pkg.VersionList (); !ver.end (); ++ver) {
+			for (pkgCache::DescIterator desc = ver.DescriptionList (); !desc.end (); ++desc) {
+				pkgCache::DescFileIterator df = desc.FileList ();
+				if (df.end ())
+					continue;
+				text += "\n";
+				text += fixture->cache->GetPkgRecords ()->Lookup (df).LongDesc ();
+			}
+		}
+
+		if (fold_case (text).find (folded) != std::string::npos && !candidates[pkg->ID])
+			g_error ("%s matches '%s' but is not a candidate", pkg.Name (), query.c_str ());
+	}
+}
+
+/* the same as a plain scan of every name */
+static void
+assert_names_scanned (SearchIndexFixture *fixture,
+		      AptNameIndex &index,
+		      const std::string &query)
+{
+	std::vector<bool> matches = index.matches ({ query });
+	const std::string folded = fold_case (query);
+
+	for (pkgCache::PkgIterator pkg = (*fixture->cache)->PkgBegin (); !pkg.end (); ++pkg) {
+		bool found = fold_case (pkg.Name ()).find (folded) != std::string::npos;
+		if (found != matches[pkg->ID])
+			g_error ("%s %s '%s' but the index says otherwise",
+				 pkg.Name (), found ? "matches" : "does not match", query.c_str ());
+	}
+}
+
+static guint64
+index_inode (SearchIndexFixture *fixture)
+{
+	GStatBuf buf;
+
+	g_assert_cmpint (g_stat (fixture->index_file, &buf), ==, 0);
+	return buf.st_ino;
+}
+
+static void
+fixture_setup (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	guint generated = GPOINTER_TO_UINT (user_data);
+
+	/* a copy of the fixture, so the packages and the saved index can change */
+	fixture->dir = g_dir_make_tmp ("pk-aptcc-search-index-XXXXXX", NULL);
+	g_assert_nonnull (fixture->dir);
+	for (guint i = 0; i < G_N_ELEMENTS (fixture_files); i++) {
+		g_autofree gchar *src = g_build_filename (TESTDATADIR, fixture_files[i], NULL);
+		g_autofree gchar *dest = g_build_filename (fixture->dir, fixture_files[i], NULL);
+		g_autofree gchar *parent = g_path_get_dirname (dest);
+		g_autofree gchar *contents = NULL;
+		gsize length;
+
+		g_assert_true (g_file_get_contents (src, &contents, &length, NULL));
+		g_assert_cmpint (g_mkdir_with_parents (parent, 0755), ==, 0);
+		g_assert_true (g_file_set_contents (dest, contents, length, NULL));
+	}
+	fixture->packages_file = g_build_filename (fixture->dir, PACKAGES_FILE, NULL);
+
+	if (generated > 0) {
+		g_autoptr(GString) packages = g_string_new (NULL);
+		g_autofree gchar *contents = NULL;
+
+		g_assert_true (g_file_get_contents (fixture->packages_file, &contents, NULL, NULL));
+		g_string_append (packages, contents);
+		for (guint i = 0; i < generated; i++) {
+			g_string_append_printf (packages,
+						"\nPackage: pk-gen-%05u\n"
+						"Version: 1.0-1\n"
+						"Architecture: amd64\n"
+						"Filename: pool/main/p/pk-gen-%05u_1.0-1_amd64.deb\n"
+						"Size: 1024\n"
+						"Description: Generated package %u\n",
+						i, i, i);
+		}
+		g_assert_true (g_file_set_contents (fixture->packages_file,
+						    packages->str, packages->len, NULL));
+	}
+
+	g_autofree gchar *cache_dir = g_build_filename (fixture->dir, "var", "cache", "apt", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (cache_dir, 0755), ==, 0);
+	fixture->index_file = g_build_filename (cache_dir, "packagekit-details.idx", NULL);
+
+	g_autofree gchar *root = g_strdup_printf ("%s/", fixture->dir);
+	g_autofree gchar *status = g_build_filename (fixture->dir, "var", "lib", "dpkg", "status", NULL);
+	_config->Set ("Dir", root);
+	_config->Set ("Dir::State::status", status);
+
+	fixture->job = pk_backend_job_new (conf);
+	fixture->cache = NULL;
+	open_cache (fixture);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	if (g_file_test (path, G_FILE_TEST_IS_DIR) &&
+	    !g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+		g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+		const gchar *name;
+
+		while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+			g_autofree gchar *child = g_build_filename (path, name, NULL);
+			remove_tree (child);
+		}
+		g_rmdir (path);
+	} else {
+		g_unlink (path);
+	}
+}
+
+static void
+fixture_teardown (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	delete fixture->cache;
+	g_object_unref (fixture->job);
+	remove_tree (fixture->dir);
+
+	g_free (fixture->dir);
+	g_free (fixture->packages_file);
+	g_free (fixture->index_file);
+}
+
+static void
+test_details_candidates (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	AptDetailsIndex index (fixture->cache);
+	gchar *found;
+
+	/* a word of the names and of the descriptions */
+	found = search_details (fixture, index, { "fixture" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-beta,pk-fixture-gamma");
+	g_free (found);
+	found = search_details (fixture, index, { "entirely" });
+	g_assert_cmpstr (found, ==, "unrelated-tool");
+	g_free (found);
+
+	/* part of a word, looked up by trigram, ignoring case */
+	found = search_details (fixture, index, { "ALP" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha");
+	g_free (found);
+	found = search_details (fixture, index, { "ixtur" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-beta,pk-fixture-gamma");
+	g_free (found);
+	found = search_details (fixture, index, { "xyz" });
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+
+	/* words too short for trigrams */
+	found = search_details (fixture, index, { "ta" });
+	g_assert_cmpstr (found, ==, "pk-fixture-beta");
+	g_free (found);
+	found = search_details (fixture, index, { "ir" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-gamma,unrelated-tool");
+	g_free (found);
+
+	/* every word of a query, in any order */
+	found = search_details (fixture, index, { "fixture alpha" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha");
+	g_free (found);
+	found = search_details (fixture, index, { "Second test" });
+	g_assert_cmpstr (found, ==, "pk-fixture-beta");
+	g_free (found);
+	found = search_details (fixture, index, { "ir aptcc" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-gamma");
+	g_free (found);
+	found = search_details (fixture, index, { "alpha beta" });
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+	found = search_details (fixture, index, { "alpha xyz" });
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+
+	/* any of the queries */
+	found = search_details (fixture, index, { "fixture alpha", "gamma", "xyz" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-gamma");
+	g_free (found);
+
+	/* nothing to look up */
+	std::vector<bool> all = index.candidates ({ "--" });
+	g_assert_true (std::find (all.begin (), all.end (), false) == all.end ());
+	all = index.candidates ({ "xyz", "" });
+	g_assert_true (std::find (all.begin (), all.end (), false) == all.end ());
+
+	/* the candidates never miss a package the search keeps, even for
+	 * queries spanning several words */
+	for (const gchar *query : { "fixture", "FIXTURE ALPHA", "st fix", "package of",
+				    "fixture.", "e", "xtur", "pk-fixture-g", "else entirely" })
+		assert_details_superset (fixture, index, query);
+}
+
+static void
+test_details_saved (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	guint64 inode;
+	gchar *found;
+
+	{
+		AptDetailsIndex index (fixture->cache);
+		found = search_details (fixture, index, { "fixture beta" });
+		g_assert_cmpstr (found, ==, "pk-fixture-beta");
+		g_free (found);
+	}
+	g_assert_true (g_file_test (fixture->index_file, G_FILE_TEST_EXISTS));
+	inode = index_inode (fixture);
+
+	/* the same cache again loads the saved index instead of writing a new one */
+	open_cache (fixture);
+	{
+		AptDetailsIndex index (fixture->cache);
+		g_assert_cmpuint (index_inode (fixture), ==, inode);
+		found = search_details (fixture, index, { "fixture beta" });
+		g_assert_cmpstr (found, ==, "pk-fixture-beta");
+		g_free (found);
+		found = search_details (fixture, index, { "ta" });
+		g_assert_cmpstr (found, ==, "pk-fixture-beta");
+		g_free (found);
+		for (const gchar *query : { "fixture", "st fix", "e" })
+			assert_details_superset (fixture, index, query);
+	}
+
+	/* a package is added, so the saved index is stale and the package
+	 * IDs may all have moved */
+	{
+		g_autofree gchar *contents = NULL;
+		g_autofree gchar *packages = NULL;
+
+		g_assert_true (g_file_get_contents (fixture->packages_file, &contents, NULL, NULL));
+		packages = g_strconcat ("Package: pk-fixture-delta\n"
+					"Version: 4.0-1\n"
+					"Architecture: amd64\n"
+					"Filename: pool/main/p/pk-fixture-delta/pk-fixture-delta_4.0-1_amd64.deb\n"
+					"Size: 1024\n"
+					"Description: PackageKit test fixture delta\n"
+					" Fourth package, with a newword.\n"
+					"\n",
+					contents, NULL);
+		g_assert_true (g_file_set_contents (fixture->packages_file, packages, -1, NULL));
+	}
+	open_cache (fixture);
+	{
+		AptDetailsIndex index (fixture->cache);
+		g_assert_cmpuint (index_inode (fixture), !=, inode);
+		inode = index_inode (fixture);
+
+		found = search_details (fixture, index, { "newword" });
+		g_assert_cmpstr (found, ==, "pk-fixture-delta");
+		g_free (found);
+		found = search_details (fixture, index, { "fixture" });
+		g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-beta,pk-fixture-delta,pk-fixture-gamma");
+		g_free (found);
+		found = search_details (fixture, index, { "fixture beta" });
+		g_assert_cmpstr (found, ==, "pk-fixture-beta");
+		g_free (found);
+		for (const gchar *query : { "fixture", "newword", "st fix", "e" })
+			assert_details_superset (fixture, index, query);
+	}
+
+	/* a damaged index is rebuilt too */
+	g_assert_true (g_file_set_contents (fixture->index_file, "PKAPTDI1garbage", -1, NULL));
+	open_cache (fixture);
+	{
+		AptDetailsIndex index (fixture->cache);
+		found = search_details (fixture, index, { "newword" });
+		g_assert_cmpstr (found, ==, "pk-fixture-delta");
+		g_free (found);
+	}
+	open_cache (fixture);
+	{
+		inode = index_inode (fixture);
+		AptDetailsIndex index (fixture->cache);
+		g_assert_cmpuint (index_inode (fixture), ==, inode);
+		found = search_details (fixture, index, { "newword" });
+		g_assert_cmpstr (found, ==, "pk-fixture-delta");
+		g_free (found);
+	}
+}
+
+static void
+test_name_matches (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	AptNameIndex index (fixture->cache);
+	gchar *found;
+
+	/* looked up by trigram, ignoring case */
+	found = search_names (fixture, index, { "fixture-al" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha");
+	g_free (found);
+	found = search_names (fixture, index, { "FIXTURE" });
+	g_assert_cmpstr (found, ==, "pk-fixture-alpha,pk-fixture-beta,pk-fixture-gamma");
+	g_free (found);
+	found = search_names (fixture, index, { "gamma", "TOOL", "xyz" });
+	g_assert_cmpstr (found, ==, "pk-fixture-gamma,unrelated-tool");
+	g_free (found);
+
+	/* no name has every trigram of the query */
+	found = search_names (fixture, index, { "alphabet" });
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+
+	/* names only, not the descriptions */
+	found = search_names (fixture, index, { "entirely" });
+	g_assert_cmpstr (found, ==, "");
+	g_free (found);
+
+	/* too short for trigrams */
+	found = search_names (fixture, index, { "ta" });
+	g_assert_cmpstr (found, ==, "pk-fixture-beta");
+	g_free (found);
+	found = search_names (fixture, index, { "-T" });
+	g_assert_cmpstr (found, ==, "unrelated-tool");
+	g_free (found);
+
+	for (const gchar *query : { "", "a", "PK", "fixture-", "ed-t", "zz" })
+		assert_names_scanned (fixture, index, query);
+}
+
+static void
+test_name_matches_parallel (SearchIndexFixture *fixture, gconstpointer user_data)
+{
+	AptNameIndex index (fixture->cache);
+	gchar *found;
+
+	if (g_get_num_processors () < 2)
+		g_test_message ("only one processor, the names are scanned in one thread");
+
+	/* short queries scan every name, split in ranges of package IDs */
+	for (const gchar *query : { "", "a", "7", "A-", "-0", "99", "zz" })
+		assert_names_scanned (fixture, index, query);
+
+	/* and the longer ones still use the trigrams */
+	for (const gchar *query : { "pk-gen-0", "N-3999", "fixture", "xyz" })
+		assert_names_scanned (fixture, index, query);
+
+	found = search_names (fixture, index, { "gen-39999", "FIXTURE-b" });
+	g_assert_cmpstr (found, ==, "pk-fixture-beta,pk-gen-39999");
+	g_free (found);
+}
+
+static gboolean
+log_fatal_cb (const gchar *log_domain,
+	      GLogLevelFlags log_level,
+	      const gchar *message,
+	      gpointer user_data)
+{
+	/* the system running the test may have no AppStream data at all */
+	return !g_str_has_prefix (message, "Issue while loading the AppStream metadata pool");
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+	g_test_log_set_fatal_handler (log_fatal_cb, NULL);
+
+	/* the root is set to a copy of the fixture for each test */
+	if (!pkgInitConfig (*_config))
+		g_error ("failed to initialize the apt config");
+	_config->Set ("Dir", TESTDATADIR "/");
+	_config->Set ("Dir::State::status", TESTDATADIR "/var/lib/dpkg/status");
+	_config->Set ("Dir::Cache::pkgcache", "");
+	_config->Set ("Dir::Cache::srcpkgcache", "");
+	_config->Set ("Debug::NoLocking", true);
+	_config->Set ("APT::Architecture", "amd64");
+	_config->Clear ("APT::Architectures");
+	_config->Set ("APT::Architectures::", "amd64");
+	if (!pkgInitSystem (*_config, _system))
+		g_error ("failed to initialize the apt system");
+
+	conf = g_key_file_new ();
+
+	g_test_add ("/aptcc/search-index/details", SearchIndexFixture, NULL,
+		    fixture_setup, test_details_candidates, fixture_teardown);
+	g_test_add ("/aptcc/search-index/details-saved", SearchIndexFixture, NULL,
+		    fixture_setup, test_details_saved, fixture_teardown);
+	g_test_add ("/aptcc/search-index/names", SearchIndexFixture, NULL,
+		    fixture_setup, test_name_matches, fixture_teardown);
+	g_test_add ("/aptcc/search-index/names-parallel", SearchIndexFixture,
+		    GUINT_TO_POINTER (N_GENERATED_PACKAGES),
+		    fixture_setup, test_name_matches_parallel, fixture_teardown);
+
+	int ret = g_test_run ();
+	g_key_file_unref (conf);
+	return ret;
+}
@@ -0,0 +1,196 @@
+/* status-parser-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+
+#include <string.h>
+#include <string>
+
+#include "apt-status-parser.h"
+
+#define N_PACKAGES	2000
+#define N_STEPS		6
+
+typedef struct {
+	guint status;
+	guint errors;
+	guint conffiles;
+	gdouble last_percent;
+	gboolean monotonic;
+	std::string last_package;
+	std::string error_message;
+	std::string conffile_current;
+	std::string conffile_updated;
+} ReplayResult;
+
+/* the status stream apt writes while upgrading N_PACKAGES packages,
+ * with the same records and wording as a real run */
+static GString *
+replay_stream (void)
+{
+	GString *stream = g_string_new ("pmstatus:dpkg-exec:0:Running dpkg\n");
+	const guint total = N_PACKAGES * N_STEPS;
+	guint step = 0;
+
+	for (guint i = 0; i < N_PACKAGES; i++) {
+		gchar percent[G_ASCII_DTOSTR_BUF_SIZE];
+
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Preparing to unpack .../libpk-upgrade%u_2.0-1_amd64.deb ...\n",
+					i, percent, i);
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Unpacking libpk-upgrade%u (2.0-1) over (1.0-1)\n",
+					i, percent, i);
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Preparing to configure libpk-upgrade%u\n",
+					i, percent, i);
+	}
+	for (guint i = 0; i < N_PACKAGES; i++) {
+		gchar percent[G_ASCII_DTOSTR_BUF_SIZE];
+
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Configuring libpk-upgrade%u\n",
+					i, percent, i);
+		if (i == 42) {
+			g_string_append_printf (stream, "pmconffile:/etc/pk-upgrade%u.conf:%s:'/etc/pk-upgrade%u.conf' '/etc/pk-upgrade%u.conf.dpkg-new' 1 1\n",
+						i, percent, i, i);
+		}
+		if (i == 1000) {
+			g_string_append_printf (stream, "pmerror:libpk-upgrade%u:%s:installed libpk-upgrade%u package post-installation script subprocess returned error exit status 1\n",
+						i, percent, i);
+		}
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Configuring libpk-upgrade%u\n",
+					i, percent, i);
+		g_ascii_dtostr (percent, sizeof (percent), 100.0 * step++ / total);
+		g_string_append_printf (stream, "pmstatus:libpk-upgrade%u:%s:Installed libpk-upgrade%u\n",
+					i, percent, i);
+	}
+	g_string_append (stream, "pmstatus:dpkg-exec:100:Running dpkg\n");
+
+	return stream;
+}
+
+static void
+replay (const GString *stream, gsize max_chunk, ReplayResult &result)
+{
+	AptStatusParser parser;
+	g_autofree gchar *data = g_strndup (stream->str, stream->len);
+	gsize pos = 0;
+
+	result.monotonic = TRUE;
+	while (pos < stream->len) {
+		gsize size = g_test_rand_int_range (1, max_chunk + 1);
+
+		size = MIN (size, stream->len - pos);
+
+		parser.feed (data + pos, size, [&result] (const AptStatusParser::Record &record) {
+			if (g_strcmp0 (record.type, "pmstatus") == 0) {
+				result.status++;
+			} else if (g_strcmp0 (record.type, "pmerror") == 0) {
+				result.errors++;
+				result.error_message = record.message;
+			} else if (g_strcmp0 (record.type, "pmconffile") == 0) {
+				result.conffiles++;
+				g_assert_true (AptStatusParser::conffileNames (record.message,
+									       result.conffile_current,
+									       result.conffile_updated));
+			}
+			if (record.percent < result.last_percent)
+				result.monotonic = FALSE;
+			result.last_percent = record.percent;
+			result.last_package = record.package;
+		});
+		pos += size;
+	}
+	g_assert_false (parser.pending ());
+}
+
+static void
+test_status_parser_replay (void)
+{
+	g_autoptr(GString) stream = replay_stream ();
+	const gsize chunks[] = { 1, 7, 64, 4096, 65536 };
+
+	/* the same records however the stream was split by read() */
+	for (guint i = 0; i < G_N_ELEMENTS (chunks); i++) {
+		ReplayResult result = { 0, 0, 0, 0.0, TRUE };
+
+		replay (stream, chunks[i], result);
+		g_assert_cmpuint (result.status, ==, N_PACKAGES * N_STEPS + 2);
+		g_assert_cmpuint (result.errors, ==, 1);
+		g_assert_cmpuint (result.conffiles, ==, 1);
+		g_assert_true (result.monotonic);
+		g_assert_cmpfloat (result.last_percent, ==, 100.0);
+		g_assert_cmpstr (result.last_package.c_str (), ==, "dpkg-exec");
+		g_assert_cmpstr (result.error_message.c_str (), ==,
+				 "installed libpk-upgrade1000 package post-installation script subprocess returned error exit status 1");
+		g_assert_cmpstr (result.conffile_current.c_str (), ==, "/etc/pk-upgrade42.conf");
+		g_assert_cmpstr (result.conffile_updated.c_str (), ==, "/etc/pk-upgrade42.conf.dpkg-new");
+	}
+}
+
+static void
+test_status_parser_fields (void)
+{
+	AptStatusParser parser;
+	gchar data[] = "pmerror: libfoo :12.5: error processing archive /tmp/foo.deb (--unpack): trying to overwrite '/usr/bin/foo'\n"
+		       "garbage without fields\n"
+		       "pmstatus:libfoo:50";
+	guint records = 0;
+
+	parser.feed (data, strlen (data), [&records] (const AptStatusParser::Record &record) {
+		records++;
+		g_assert_cmpstr (record.type, ==, "pmerror");
+		g_assert_cmpstr (record.package, ==, "libfoo");
+		g_assert_cmpfloat (record.percent, ==, 12.5);
+		/* only the first three colons split the line */
+		g_assert_cmpstr (record.message, ==,
+				 "error processing archive /tmp/foo.deb (--unpack): trying to overwrite '/usr/bin/foo'");
+	});
+	g_assert_cmpuint (records, ==, 1);
+	g_assert_true (parser.pending ());
+}
+
+static void
+test_status_parser_conffile (void)
+{
+	std::string current;
+	std::string updated;
+
+	g_assert_true (AptStatusParser::conffileNames ("'/etc/a' '/etc/a.dpkg-new' 1 1", current, updated));
+	g_assert_cmpstr (current.c_str (), ==, "/etc/a");
+	g_assert_cmpstr (updated.c_str (), ==, "/etc/a.dpkg-new");
+	g_assert_false (AptStatusParser::conffileNames ("'/etc/a' 1 1", current, updated));
+	g_assert_false (AptStatusParser::conffileNames ("", current, updated));
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/aptcc/status-parser/replay", test_status_parser_replay);
+	g_test_add_func ("/aptcc/status-parser/fields", test_status_parser_fields);
+	g_test_add_func ("/aptcc/status-parser/conffile", test_status_parser_conffile);
+
+	return g_test_run ();
+}
@@ -43,6 +43,8 @@
 #include <librepo/librepo.h>
 #include <rpm/rpmlib.h>
 
+#include <pk-shared.h>
+
 #include "dnf-backend-vendor.h"
 #include "dnf-backend.h"
 
@@ -50,6 +52,9 @@ typedef struct {
 	DnfSack		*sack;
 	gboolean	 valid;
 	gchar		*key;
+	GPtrArray	*unavailable;	/* of repo IDs, NULL if not remote */
+	GHashTable	*repo_checksums; /* repo ID:state, NULL if not remote */
+	guint		 repos_serial;	/* of the repos last checked against */
 } DnfSackCacheItem;
 
 typedef struct {
@@ -57,8 +62,17 @@ typedef struct {
 	DnfContext	*context;
 	GHashTable	*sack_cache;	/* of DnfSackCacheItem */
 	GMutex		 sack_mutex;
-	GTimer		*repos_timer;
+	guint		 repos_serial;
 	gchar		*release_ver;
+	guint		 jobs_running;
+	guint		 prewarm_id;
+	GThread		*prewarm_thread;
+	PkBackendJob	*prewarm_job;
+	GCancellable	*prewarm_cancellable;
+	GMutex		 prewarm_mutex;
+	GCond		 prewarm_cond;
+	gboolean	 prewarm_running; /* with prewarm_mutex */
+	guint		 prewarm_queue_id; /* with prewarm_mutex */
 } PkBackendDnfPrivate;
 
 typedef struct {
@@ -70,6 +84,10 @@ typedef struct {
 	HyGoal		 goal;
 } PkBackendDnfJobData;
 
+static void pk_backend_sack_prewarm_queue (PkBackend *backend);
+static void pk_backend_sack_prewarm_stop (PkBackend *backend);
+static void pk_backend_sack_prewarm_wait (PkBackend *backend, PkBackendJob *job);
+
 const gchar *
 pk_backend_get_description (PkBackend *backend)
 {
@@ -106,12 +124,25 @@ pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
 			cache_item->valid = FALSE;
 		}
 	}
+	pk_backend_sack_prewarm_queue (backend);
+}
+
+static void
+pk_backend_sack_cache_repos_changed (PkBackend *backend, const gchar *why)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+	/* the remote sacks are checked against the repos on next use */
+	g_debug ("checking the remote sacks as %s", why);
+	priv->repos_serial++;
+	pk_backend_sack_prewarm_queue (backend);
 }
 
 static void
 pk_backend_yum_repos_changed_cb (DnfRepoLoader *repo_loader, PkBackend *backend)
 {
-	pk_backend_sack_cache_invalidate (backend, "yum.repos.d changed");
+	pk_backend_sack_cache_repos_changed (backend, "yum.repos.d changed");
 	pk_backend_repo_list_changed (backend);
 }
 
@@ -120,6 +151,10 @@ dnf_sack_cache_item_free (DnfSackCacheItem *cache_item)
 {
 	g_object_unref (cache_item->sack);
 	g_free (cache_item->key);
+	if (cache_item->unavailable != NULL)
+		g_ptr_array_unref (cache_item->unavailable);
+	if (cache_item->repo_checksums != NULL)
+		g_hash_table_unref (cache_item->repo_checksums);
 	g_slice_free (DnfSackCacheItem, cache_item);
 }
 
@@ -281,7 +316,6 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv = g_new0 (PkBackendDnfPrivate, 1);
 	pk_backend_set_user_data (backend, priv);
 	priv->conf = g_key_file_ref (conf);
-	priv->repos_timer = g_timer_new ();
 
 	g_debug ("Using libdnf %i.%i.%i",
 		 LIBDNF_MAJOR_VERSION,
@@ -299,14 +333,25 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	/* clean up any cache directories left over from a distro upgrade */
 	remove_old_cache_directories (backend, priv->release_ver);
 
-	/* a cache of DnfSacks with the key being which sacks are loaded
+	/* a cache of DnfSacks with the key being which sacks are loaded,
+	 * i.e. one with the installed packages only and one with everything
+	 * the other roles need, see dnf_utils_create_sack_for_filters()
 	 *
 	 * notes:
 	 * - this deals with deallocating the sack when the backend is unloaded
 	 * - all the cached sacks are dropped on any transaction that can
-	 *   modify state or if the repos or rpmdb are changed
+	 *   modify state or if the rpmdb is changed, and the remote ones
+	 *   if the metadata of any repo changed
+	 * - libdnf cannot reload the installed packages of a sack, as the
+	 *   provides, the considered packages and the module excludes are
+	 *   computed over all repos; the remote repos of a rebuilt sack are
+	 *   read back from the solv files libdnf cached for them, so only
+	 *   the rpmdb is parsed again (both times are in the debug log)
+	 * - they are rebuilt in the background while no job is running
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	g_mutex_init (&priv->prewarm_mutex);
+	g_cond_init (&priv->prewarm_cond);
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
@@ -314,18 +359,30 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 
 	if (!pk_backend_ensure_default_dnf_context (backend, &error))
 		g_warning ("failed to setup context: %s", error->message);
+
+	/* load the sacks before the first query needs them */
+	pk_backend_sack_prewarm_queue (backend);
 }
 
 void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	if (priv->prewarm_id != 0)
+		g_source_remove (priv->prewarm_id);
+	/* cancel the prewarm before waiting for it, then free it */
+	pk_backend_sack_prewarm_stop (backend);
+	pk_backend_sack_prewarm_wait (backend, NULL);
+	pk_backend_sack_prewarm_stop (backend);
+	if (priv->prewarm_queue_id != 0)
+		g_source_remove (priv->prewarm_queue_id);
 	if (priv->conf != NULL)
 		g_key_file_unref (priv->conf);
 	if (priv->context != NULL)
 		g_object_unref (priv->context);
-	g_timer_destroy (priv->repos_timer);
 	g_mutex_clear (&priv->sack_mutex);
+	g_mutex_clear (&priv->prewarm_mutex);
+	g_cond_clear (&priv->prewarm_cond);
 	g_hash_table_unref (priv->sack_cache);
 	g_free (priv->release_ver);
 	g_free (priv);
@@ -339,26 +396,6 @@ pk_backend_state_percentage_changed_cb (DnfState *state,
 	pk_backend_job_set_percentage (job, percentage);
 }
 
-static void
-pk_backend_download_percentage_changed_cb (DnfState *state,
-                                           guint percentage,
-                                           PkBackendJob *job)
-{
-	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
-	GPtrArray *remote_pkgs;
-	guint64 download_size;
-	guint64 download_size_remaining;
-
-	remote_pkgs = dnf_transaction_get_remote_pkgs (job_data->transaction);
-	download_size = dnf_package_array_get_download_size (remote_pkgs);
-
-	if (download_size == 0)
-		return;
-
-	download_size_remaining = download_size - (download_size / 100.0f * percentage);
-	pk_backend_job_set_download_size_remaining (job, download_size_remaining);
-}
-
 static void
 pk_backend_state_action_changed_cb (DnfState *state,
 				    DnfStateAction action,
@@ -472,6 +509,13 @@ void
 pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 {
 	PkBackendDnfJobData *job_data;
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* real transactions take priority over warming the sack cache; the
+	 * job waits for the prewarm to give up in its own thread */
+	priv->jobs_running++;
+	pk_backend_sack_prewarm_stop (backend);
+
 	job_data = g_new0 (PkBackendDnfJobData, 1);
 	job_data->backend = backend;
 	pk_backend_job_set_user_data (job, job_data);
@@ -502,11 +546,9 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_RUNNING);
 }
 
-void
-pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
+static void
+pk_backend_dnf_job_data_free (PkBackendDnfJobData *job_data)
 {
-	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
-
 	if (job_data->state != NULL) {
 		dnf_state_release_locks (job_data->state);
 		g_object_unref (job_data->state);
@@ -518,7 +560,19 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 	if (job_data->goal != NULL)
 		hy_goal_free (job_data->goal);
 	g_free (job_data);
+}
+
+void
+pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+
+	pk_backend_dnf_job_data_free (pk_backend_job_get_user_data (job));
 	pk_backend_job_set_user_data (job, NULL);
+
+	/* the transaction may have left the sack cache cold */
+	priv->jobs_running--;
+	pk_backend_sack_prewarm_queue (backend);
 }
 
 static gboolean
@@ -639,6 +693,120 @@ dnf_utils_real_path (const gchar *path)
 	return real;
 }
 
+/* the repos enabled for metadata only which have packages in the sack;
+ * dnf_sack_add_repos() leaves out those which are skip_if_unavailable
+ * and could not be loaded */
+static GPtrArray *
+dnf_utils_sack_get_unavailable (DnfSack *sack, DnfContext *context, GError **error)
+{
+	g_autoptr(GPtrArray) repos = NULL;
+	g_autoptr(GPtrArray) unavailable = g_ptr_array_new_with_free_func (g_free);
+
+	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (context), error);
+	if (repos == NULL)
+		return NULL;
+	for (guint i = 0; i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		HyQuery query;
+		gboolean empty;
+
+		if (dnf_repo_get_enabled (repo) != DNF_REPO_ENABLED_METADATA)
+			continue;
+		query = hy_query_create (sack);
+		hy_query_filter (query, HY_PKG_REPONAME, HY_EQ, dnf_repo_get_id (repo));
+		empty = hy_query_is_empty (query);
+		hy_query_free (query);
+		if (!empty)
+			g_ptr_array_add (unavailable, g_strdup (dnf_repo_get_id (repo)));
+	}
+	return g_steal_pointer (&unavailable);
+}
+
+/* repos enabled for metadata only are part of the shared sack, and hidden
+ * from every role but the queries */
+static void
+dnf_utils_sack_set_unavailable (DnfSackCacheItem *cache_item, gboolean enabled)
+{
+	if (cache_item->unavailable == NULL)
+		return;
+	for (guint i = 0; i < cache_item->unavailable->len; i++) {
+		dnf_sack_repo_enabled (cache_item->sack,
+				       g_ptr_array_index (cache_item->unavailable, i),
+				       enabled);
+	}
+}
+
+/* the enabled state and repomd.xml checksum of each repo, which is all a
+ * remote sack depends on besides the rpmdb */
+static GHashTable *
+dnf_utils_get_repo_checksums (DnfContext *context, GError **error)
+{
+	g_autoptr(GHashTable) repo_checksums = NULL;
+	g_autoptr(GPtrArray) repos = NULL;
+
+	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (context), error);
+	if (repos == NULL)
+		return NULL;
+	repo_checksums = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	for (guint i = 0; i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		gsize len = 0;
+		g_autofree gchar *checksum = NULL;
+		g_autofree gchar *data = NULL;
+		g_autofree gchar *repomd = NULL;
+
+		if (dnf_repo_get_enabled (repo) == DNF_REPO_ENABLED_NONE)
+			continue;
+		repomd = g_build_filename (dnf_repo_get_location (repo),
+					   "repodata", "repomd.xml", NULL);
+		if (g_file_get_contents (repomd, &data, &len, NULL))
+			checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+								(const guchar *) data, len);
+		g_hash_table_insert (repo_checksums,
+				     g_strdup (dnf_repo_get_id (repo)),
+				     g_strdup_printf ("%u:%s",
+						      (guint) dnf_repo_get_enabled (repo),
+						      checksum != NULL ? checksum : "missing"));
+	}
+	return g_steal_pointer (&repo_checksums);
+}
+
+static gboolean
+dnf_utils_repo_checksums_equal (GHashTable *old_checksums, GHashTable *new_checksums)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	if (g_hash_table_size (old_checksums) != g_hash_table_size (new_checksums))
+		return FALSE;
+	g_hash_table_iter_init (&iter, old_checksums);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_strcmp0 (value, g_hash_table_lookup (new_checksums, key)) != 0) {
+			g_debug ("repo %s changed", (const gchar *) key);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static DnfSackAddFlags
+dnf_utils_get_sack_add_flags (PkBitfield filters)
+{
+	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
+
+	/* don't add if we're going to filter out anyway */
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
+		/* all the roles share one sack with the remote packages, so it
+		 * has the updateinfo and the metadata-only repos any of them
+		 * may need; neither can be added to it later */
+		flags |= DNF_SACK_ADD_FLAG_REMOTE;
+		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
+		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
+	}
+	return flags;
+}
+
 static DnfSack *
 dnf_utils_create_sack_for_filters (PkBackendJob *job,
 				   PkBitfield filters,
@@ -647,7 +815,8 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 				   GError **error)
 {
 	gboolean ret;
-	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
+	gboolean unavailable = FALSE;
+	DnfSackAddFlags flags = dnf_utils_get_sack_add_flags (filters);
 	DnfSackCacheItem *cache_item = NULL;
 	DnfState *state_local;
 	PkBackend *backend = pk_backend_job_get_backend (job);
@@ -657,14 +826,10 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	g_autofree gchar *install_root = NULL;
 	g_autofree gchar *solv_dir = NULL;
 	g_autoptr(DnfSack) sack = NULL;
-
-	/* don't add if we're going to filter out anyway */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
-		flags |= DNF_SACK_ADD_FLAG_REMOTE;
-
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
-		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
+	g_autoptr(GHashTable) repo_checksums = NULL;
+	g_autoptr(GPtrArray) unavailable_repos = NULL;
+	g_autoptr(GTimer) timer = NULL;
+	guint repos_serial;
 
 	/* only use unavailble packages for queries */
 	switch (pk_backend_job_get_role (job)) {
@@ -674,23 +839,16 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	case PK_ROLE_ENUM_SEARCH_FILE:
 	case PK_ROLE_ENUM_GET_DETAILS:
 	case PK_ROLE_ENUM_WHAT_PROVIDES:
-		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
+		unavailable = TRUE;
 		break;
 	default:
 		break;
 	}
 
-	/* media repos could disappear at any time */
-	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
-	    dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)) &&
-	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
-		g_debug ("not reusing sack as media may have disappeared");
-		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-	g_timer_reset (priv->repos_timer);
-
-	/* if we've specified a specific cache-age then do not use the cache */
+	/* if we've specified a specific cache-age then do not use the cache,
+	 * unless the metadata has just been refreshed */
 	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    pk_backend_job_get_role (job) != PK_ROLE_ENUM_REFRESH_CACHE &&
 	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
 		g_debug ("not reusing sack specific cache age requested");
 		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
@@ -698,12 +856,33 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 
 	/* do we have anything in the cache */
 	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
+	g_mutex_lock (&priv->sack_mutex);
+	repos_serial = priv->repos_serial;
+	g_mutex_unlock (&priv->sack_mutex);
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
 		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
 		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
 		if (cache_item != NULL && cache_item->sack != NULL) {
+			/* the repos may have changed under a remote sack, and
+			 * media repos could disappear at any time */
+			if (cache_item->valid &&
+			    cache_item->repo_checksums != NULL &&
+			    (cache_item->repos_serial != priv->repos_serial ||
+			     dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)))) {
+				repo_checksums = dnf_utils_get_repo_checksums (job_data->context, error);
+				if (repo_checksums == NULL)
+					return NULL;
+				if (!dnf_utils_repo_checksums_equal (cache_item->repo_checksums,
+								     repo_checksums)) {
+					g_debug ("not reusing sack %s as the repos changed", cache_key);
+					cache_item->valid = FALSE;
+				} else {
+					cache_item->repos_serial = priv->repos_serial;
+				}
+			}
 			if (cache_item->valid) {
 				g_debug ("using cached sack %s", cache_key);
+				dnf_utils_sack_set_unavailable (cache_item, unavailable);
 				return g_object_ref (cache_item->sack);
 			} else {
 				/* we have to do this now rather than rely on the
@@ -743,11 +922,14 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	}
 
 	/* add installed packages */
+	timer = g_timer_new ();
 	ret = dnf_sack_load_system_repo (sack, NULL, DNF_SACK_LOAD_FLAG_BUILD_CACHE, error);
 	if (!ret) {
 		g_prefix_error (error, "Failed to load system repo: ");
 		return NULL;
 	}
+	g_debug ("loaded the installed packages for %s in %.0fms",
+		 cache_key, g_timer_elapsed (timer, NULL) * 1000);
 
 	/* done */
 	ret = dnf_state_done (state, error);
@@ -756,11 +938,24 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 
 	/* add remote packages */
 	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
+		/* what the remote packages are loaded from; any change from
+		 * here on has a newer serial, so the sack gets checked */
+		g_clear_pointer (&repo_checksums, g_hash_table_unref);
+		repo_checksums = dnf_utils_get_repo_checksums (job_data->context, error);
+		if (repo_checksums == NULL)
+			return NULL;
+
+		g_timer_start (timer);
 		state_local = dnf_state_get_child (state);
 		ret = dnf_utils_add_remote (job, sack, flags,
 					    state_local, error);
 		if (!ret)
 			return NULL;
+		g_debug ("added the remote packages for %s in %.0fms",
+			 cache_key, g_timer_elapsed (timer, NULL) * 1000);
+		unavailable_repos = dnf_utils_sack_get_unavailable (sack, job_data->context, error);
+		if (unavailable_repos == NULL)
+			return NULL;
 
 		/* done */
 		ret = dnf_state_done (state, error);
@@ -776,13 +971,228 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	cache_item->key = g_strdup (cache_key);
 	cache_item->sack = g_object_ref (sack);
 	cache_item->valid = TRUE;
+	cache_item->unavailable = g_steal_pointer (&unavailable_repos);
+	cache_item->repo_checksums = g_steal_pointer (&repo_checksums);
+	cache_item->repos_serial = repos_serial;
 	g_debug ("created cached sack %s", cache_item->key);
 	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
+	dnf_utils_sack_set_unavailable (cache_item, unavailable);
 	g_mutex_unlock (&priv->sack_mutex);
 
 	return g_steal_pointer (&sack);
 }
 
+/* the sacks with and without the remote packages */
+static const PkBitfield prewarm_filters[] = { 0, pk_bitfield_value (PK_FILTER_ENUM_INSTALLED) };
+
+static gboolean
+pk_backend_sack_cache_is_warm (PkBackend *backend)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+	for (guint i = 0; i < G_N_ELEMENTS (prewarm_filters); i++) {
+		DnfSackCacheItem *cache_item;
+		g_autofree gchar *cache_key = NULL;
+
+		cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (priv->context),
+							dnf_utils_get_sack_add_flags (prewarm_filters[i]));
+		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+		if (cache_item == NULL || !cache_item->valid)
+			return FALSE;
+		if (cache_item->repo_checksums != NULL &&
+		    cache_item->repos_serial != priv->repos_serial)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+dnf_utils_repos_are_local (DnfContext *context)
+{
+	GHashTableIter iter;
+	gpointer value;
+	g_autoptr(GHashTable) repo_checksums = NULL;
+
+	repo_checksums = dnf_utils_get_repo_checksums (context, NULL);
+	if (repo_checksums == NULL)
+		return FALSE;
+	g_hash_table_iter_init (&iter, repo_checksums);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		if (g_str_has_suffix (value, ":missing"))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gpointer
+pk_backend_sack_prewarm_thread (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	PkBackendJob *job = priv->prewarm_job;
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* stay out of the way of anything the user is waiting for */
+	pk_ioprio_set_idle (0);
+
+	dnf_state_set_number_steps (job_data->state, G_N_ELEMENTS (prewarm_filters));
+	for (guint i = 0; i < G_N_ELEMENTS (prewarm_filters); i++) {
+		DnfState *state_local = dnf_state_get_child (job_data->state);
+		g_autoptr(DnfSack) sack = NULL;
+
+		/* never download anything the user did not ask for */
+		if (prewarm_filters[i] == 0 &&
+		    !dnf_utils_repos_are_local (job_data->context)) {
+			g_debug ("not prewarming the remote sack as metadata is missing");
+		} else {
+			sack = dnf_utils_create_sack_for_filters (job, prewarm_filters[i],
+								  DNF_CREATE_SACK_FLAG_USE_CACHE,
+								  state_local, &error);
+			if (sack == NULL)
+				break;
+		}
+		if (!dnf_state_done (job_data->state, &error))
+			break;
+	}
+	if (error != NULL) {
+		g_debug ("sack prewarm stopped: %s", error->message);
+	} else {
+		g_debug ("sack prewarm done in %.0fms, cache warm: %s",
+			 g_timer_elapsed (timer, NULL) * 1000,
+			 pk_backend_sack_cache_is_warm (backend) ? "yes" : "no");
+	}
+	g_mutex_lock (&priv->prewarm_mutex);
+	priv->prewarm_running = FALSE;
+	g_cond_broadcast (&priv->prewarm_cond);
+	g_mutex_unlock (&priv->prewarm_mutex);
+	return NULL;
+}
+
+static gboolean
+pk_backend_sack_prewarm_is_running (PkBackend *backend)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->prewarm_mutex);
+	return priv->prewarm_running;
+}
+
+/* blocks until the prewarm thread is done; jobs call this from their own
+ * thread before they touch the context, as it only stops between repos */
+static void
+pk_backend_sack_prewarm_wait (PkBackend *backend, PkBackendJob *job)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->prewarm_mutex);
+
+	if (!priv->prewarm_running)
+		return;
+	if (job != NULL)
+		pk_backend_job_set_status (job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+	while (priv->prewarm_running)
+		g_cond_wait (&priv->prewarm_cond, &priv->prewarm_mutex);
+	if (job != NULL)
+		pk_backend_job_set_status (job, PK_STATUS_ENUM_RUNNING);
+}
+
+/* asks the prewarm thread to give up, and frees it once it has; never
+ * blocks, so it can be called from the main loop */
+static void
+pk_backend_sack_prewarm_stop (PkBackend *backend)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (priv->prewarm_thread == NULL)
+		return;
+	if (pk_backend_sack_prewarm_is_running (backend)) {
+		g_debug ("yielding the sack prewarm to a transaction");
+		g_cancellable_cancel (priv->prewarm_cancellable);
+		return;
+	}
+	g_thread_join (g_steal_pointer (&priv->prewarm_thread));
+	pk_backend_dnf_job_data_free (pk_backend_job_get_user_data (priv->prewarm_job));
+	pk_backend_job_set_user_data (priv->prewarm_job, NULL);
+	g_clear_object (&priv->prewarm_job);
+	g_clear_object (&priv->prewarm_cancellable);
+}
+
+static gboolean
+pk_backend_sack_prewarm_cb (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	PkBackendDnfJobData *job_data;
+
+	/* try again when the current thread is done */
+	if (pk_backend_sack_prewarm_is_running (backend))
+		return G_SOURCE_CONTINUE;
+	priv->prewarm_id = 0;
+	pk_backend_sack_prewarm_stop (backend);
+
+	/* the next transaction to finish queues it again */
+	if (priv->jobs_running > 0 || priv->context == NULL)
+		return G_SOURCE_REMOVE;
+	if (pk_backend_sack_cache_is_warm (backend)) {
+		g_debug ("sack cache warm: yes");
+		return G_SOURCE_REMOVE;
+	}
+	g_debug ("sack cache warm: no, prewarming");
+
+	/* a job of our own, only ever seen by the backend */
+	priv->prewarm_cancellable = g_cancellable_new ();
+	priv->prewarm_job = pk_backend_job_new (priv->conf);
+	pk_backend_job_set_backend (priv->prewarm_job, backend);
+	pk_backend_job_set_cache_age (priv->prewarm_job, G_MAXUINT);
+	job_data = g_new0 (PkBackendDnfJobData, 1);
+	job_data->backend = backend;
+	job_data->context = g_object_ref (priv->context);
+	job_data->state = dnf_state_new ();
+	dnf_state_set_cancellable (job_data->state, priv->prewarm_cancellable);
+	pk_backend_job_set_user_data (priv->prewarm_job, job_data);
+
+	g_mutex_lock (&priv->prewarm_mutex);
+	priv->prewarm_running = TRUE;
+	g_mutex_unlock (&priv->prewarm_mutex);
+	priv->prewarm_thread = g_thread_new ("pk-dnf-prewarm",
+					     pk_backend_sack_prewarm_thread,
+					     backend);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+pk_backend_sack_prewarm_queue_cb (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+
+	g_mutex_lock (&priv->prewarm_mutex);
+	priv->prewarm_queue_id = 0;
+	g_mutex_unlock (&priv->prewarm_mutex);
+
+	/* wait a little, as clients tend to send several transactions */
+	if (priv->prewarm_id == 0 && priv->jobs_running == 0) {
+		priv->prewarm_id = g_timeout_add_seconds_full (G_PRIORITY_LOW, 2,
+							       pk_backend_sack_prewarm_cb,
+							       backend, NULL);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* rebuilds the cached sacks in the background when nothing else is running,
+ * so the next query does not have to; can be called from any thread */
+static void
+pk_backend_sack_prewarm_queue (PkBackend *backend)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->prewarm_mutex);
+
+	/* one idle source at a time, removed again in pk_backend_destroy() */
+	if (priv->prewarm_queue_id == 0)
+		priv->prewarm_queue_id = g_idle_add (pk_backend_sack_prewarm_queue_cb, backend);
+}
+
 static GPtrArray *
 dnf_utils_run_query_with_newest_filter (DnfSack *sack, HyQuery query)
 {
@@ -920,6 +1330,8 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 	g_autoptr(DnfSack) sack = NULL;
 	g_auto(GStrv) search = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   39, /* add repos */
@@ -1276,6 +1688,8 @@ pk_backend_get_repo_list_thread (PkBackendJob *job,
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) repos = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t)", &filters);
 
 	/* set the list of repos */
@@ -1334,6 +1748,8 @@ pk_backend_repo_set_data_thread (PkBackendJob *job,
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	g_autoptr(GError) error = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* get arguments */
 	switch (pk_backend_job_get_role (job)) {
 	case PK_ROLE_ENUM_REPO_ENABLE:
@@ -1569,7 +1985,7 @@ pk_backend_refresh_subman (PkBackendJob *job)
 		return;
 	}
 
-	pk_backend_sack_cache_invalidate (backend, "subscription-manager ran");
+	pk_backend_sack_cache_repos_changed (backend, "subscription-manager ran");
 	pk_backend_repo_list_changed (backend);
 }
 
@@ -1592,6 +2008,8 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	g_autoptr(GPtrArray) refresh_repos = NULL;
 	g_autoptr(GPtrArray) repos = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* set state */
 	dnf_state_set_steps (job_data->state, NULL,
 			     1, /* count */
@@ -1711,13 +2129,13 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* invalidate the sack cache after downloading new metadata */
-	pk_backend_sack_cache_invalidate (backend, "downloaded new metadata");
+	/* check the sack cache against the new metadata */
+	pk_backend_sack_cache_repos_changed (backend, "downloaded new metadata");
 
-	/* regenerate the libsolv metadata */
+	/* regenerate the libsolv metadata if any repo changed */
 	state_local = dnf_state_get_child (job_data->state);
 	sack = dnf_utils_create_sack_for_filters (job, 0,
-						  DNF_CREATE_SACK_FLAG_NONE,
+						  DNF_CREATE_SACK_FLAG_USE_CACHE,
 						  state_local, &error);
 	if (sack == NULL) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
@@ -1842,6 +2260,8 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(^a&s)", &package_ids);
 
 	/* set state */
@@ -1934,6 +2354,8 @@ backend_get_details_local_thread (PkBackendJob *job, GVariant *params, gpointer
 	g_autoptr(DnfSack) sack = NULL;
 	g_autoptr(GError) error = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(^a&s)", &full_paths);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -2024,6 +2446,8 @@ backend_get_files_local_thread (PkBackendJob *job, GVariant *params, gpointer us
 	g_autoptr(DnfSack) sack = NULL;
 	g_autoptr(GError) error = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(^a&s)", &full_paths);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -2095,16 +2519,292 @@ pk_backend_get_files_local (PkBackend *backend, PkBackendJob *job, gchar **files
 	pk_backend_job_thread_create (job, backend_get_files_local_thread, NULL, NULL);
 }
 
+typedef struct {
+	PkBackendJob	*job;
+	const gchar	*directory;
+	DnfState	*state;
+	GCancellable	*cancellable;
+	GMutex		 mutex;
+	GPtrArray	*batches;	/* of PkBackendDnfDownloadBatch */
+	guint64		 download_size;
+	guint		 percentage;
+	GError		*error;
+} PkBackendDnfDownload;
+
+/* the packages of one repo, which librepo downloads in one go */
+typedef struct {
+	PkBackendDnfDownload	*download;
+	DnfRepo			*repo;
+	GPtrArray		*packages;
+	guint64			 download_size;
+	guint			 percentage;
+	guint64			 speed;
+} PkBackendDnfDownloadBatch;
+
+static void
+pk_backend_download_batch_free (PkBackendDnfDownloadBatch *batch)
+{
+	g_ptr_array_unref (batch->packages);
+	g_free (batch);
+}
+
+static gint
+pk_backend_download_batch_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const PkBackendDnfDownloadBatch *batch_a = *((PkBackendDnfDownloadBatch **) a);
+	const PkBackendDnfDownloadBatch *batch_b = *((PkBackendDnfDownloadBatch **) b);
+
+	/* the biggest first, so it does not hold up the end */
+	if (batch_a->download_size > batch_b->download_size)
+		return -1;
+	if (batch_a->download_size < batch_b->download_size)
+		return 1;
+	return 0;
+}
+
+/* called with the mutex held */
+static void
+pk_backend_download_update_progress (PkBackendDnfDownload *download)
+{
+	guint64 downloaded = 0;
+	guint64 speed = 0;
+	guint percentage;
+
+	for (guint i = 0; i < download->batches->len; i++) {
+		PkBackendDnfDownloadBatch *batch = g_ptr_array_index (download->batches, i);
+		downloaded += batch->download_size * batch->percentage / 100;
+		speed += batch->speed;
+	}
+	pk_backend_job_set_speed (download->job, speed);
+	if (download->download_size == 0)
+		return;
+	pk_backend_job_set_download_size_remaining (download->job,
+						    download->download_size - downloaded);
+
+	percentage = downloaded * 100 / download->download_size;
+	if (percentage > download->percentage) {
+		download->percentage = percentage;
+		dnf_state_set_percentage (download->state, percentage);
+	}
+}
+
+static void
+pk_backend_download_batch_percentage_cb (DnfState *state,
+					 guint percentage,
+					 PkBackendDnfDownloadBatch *batch)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&batch->download->mutex);
+
+	/* librepo may start again from a different mirror */
+	if (percentage <= batch->percentage)
+		return;
+	batch->percentage = percentage;
+	pk_backend_download_update_progress (batch->download);
+}
+
+static void
+pk_backend_download_batch_speed_cb (DnfState *state,
+				    GParamSpec *pspec,
+				    PkBackendDnfDownloadBatch *batch)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&batch->download->mutex);
+	batch->speed = dnf_state_get_speed (state);
+	pk_backend_download_update_progress (batch->download);
+}
+
+/* librepo only reports the progress of all the packages of a repo, so
+ * each package is at 0 until its repo is done */
+static void
+pk_backend_download_batch_item_progress (PkBackendDnfDownloadBatch *batch, guint percentage)
+{
+	for (guint i = 0; i < batch->packages->len; i++) {
+		DnfPackage *pkg = g_ptr_array_index (batch->packages, i);
+		pk_backend_job_set_item_progress (batch->download->job,
+						  dnf_package_get_package_id (pkg),
+						  PK_STATUS_ENUM_DOWNLOAD,
+						  percentage);
+	}
+}
+
+static void
+pk_backend_download_batch_thread (gpointer data, gpointer user_data)
+{
+	DnfState *state;
+	PkBackendDnfDownload *download = user_data;
+	PkBackendDnfDownloadBatch *batch = data;
+	g_autoptr(GError) error_local = NULL;
+
+	/* another repo failed already */
+	if (g_cancellable_is_cancelled (download->cancellable))
+		return;
+
+	dnf_emit_package_array (download->job, PK_INFO_ENUM_DOWNLOADING, batch->packages);
+	pk_backend_download_batch_item_progress (batch, 0);
+
+	state = dnf_state_new ();
+	dnf_state_set_cancellable (state, download->cancellable);
+	g_signal_connect (state, "percentage-changed",
+			  G_CALLBACK (pk_backend_download_batch_percentage_cb),
+			  batch);
+	g_signal_connect (state, "notify::speed",
+			  G_CALLBACK (pk_backend_download_batch_speed_cb),
+			  batch);
+	if (!dnf_repo_download_packages (batch->repo,
+					 batch->packages,
+					 download->directory,
+					 state,
+					 &error_local)) {
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&download->mutex);
+		if (download->error == NULL) {
+			download->error = g_steal_pointer (&error_local);
+			g_cancellable_cancel (download->cancellable);
+		}
+		g_object_unref (state);
+		return;
+	}
+	g_object_unref (state);
+
+	pk_backend_download_batch_item_progress (batch, 100);
+	g_mutex_lock (&download->mutex);
+	batch->percentage = 100;
+	batch->speed = 0;
+	pk_backend_download_update_progress (download);
+	g_mutex_unlock (&download->mutex);
+}
+
+static void
+pk_backend_download_cancelled_cb (GCancellable *cancellable, GCancellable *download_cancellable)
+{
+	g_cancellable_cancel (download_cancellable);
+}
+
+/* the check dnf_transaction_download does before it fetches anything */
+static gboolean
+dnf_utils_check_free_space (const gchar *directory, guint64 download_size, GError **error)
+{
+	guint64 free_space;
+	g_autofree gchar *available = NULL;
+	g_autofree gchar *needed = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (directory);
+	g_autoptr(GFileInfo) info = NULL;
+
+	info = g_file_query_filesystem_info (file, G_FILE_ATTRIBUTE_FILESYSTEM_FREE, NULL, error);
+	if (info == NULL)
+		return FALSE;
+	free_space = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_FREE);
+	if (free_space < download_size) {
+		needed = g_format_size (download_size);
+		available = g_format_size (free_space);
+		g_set_error (error, DNF_ERROR, DNF_ERROR_NO_SPACE,
+			     "Not enough free space in %s: needed %s, available %s",
+			     directory, needed, available);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* downloads the packages of several repos at once, each with as many
+ * connections as the dnf configuration allows for one repo, and reports
+ * the progress of all of them together */
+static gboolean
+dnf_utils_download_packages (PkBackendJob *job,
+			     GPtrArray *packages,
+			     const gchar *directory,
+			     DnfState *state,
+			     GError **error)
+{
+	GCancellable *cancellable = pk_backend_job_get_cancellable (job);
+	GThreadPool *pool;
+	PkBackendDnfDownload download = { 0 };
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (job_data->backend);
+	gboolean ret = FALSE;
+	gint parallel;
+	gulong cancel_id;
+	g_autoptr(GHashTable) batches = NULL;
+
+	download.job = job;
+	download.directory = directory;
+	download.state = state;
+	download.cancellable = g_cancellable_new ();
+	download.batches = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_backend_download_batch_free);
+	g_mutex_init (&download.mutex);
+
+	/* one batch for each repo */
+	batches = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < packages->len; i++) {
+		DnfPackage *pkg = g_ptr_array_index (packages, i);
+		DnfRepo *repo;
+		PkBackendDnfDownloadBatch *batch;
+
+		repo = dnf_repo_loader_get_repo_by_id (dnf_context_get_repo_loader (job_data->context),
+						       dnf_package_get_reponame (pkg),
+						       error);
+		if (repo == NULL) {
+			g_prefix_error (error, "Not sure where to download %s: ",
+					dnf_package_get_name (pkg));
+			goto out;
+		}
+		batch = g_hash_table_lookup (batches, dnf_repo_get_id (repo));
+		if (batch == NULL) {
+			batch = g_new0 (PkBackendDnfDownloadBatch, 1);
+			batch->download = &download;
+			batch->repo = repo;
+			batch->packages = g_ptr_array_new_with_free_func (g_object_unref);
+			g_hash_table_insert (batches, (gpointer) dnf_repo_get_id (repo), batch);
+			g_ptr_array_add (download.batches, batch);
+		}
+		g_ptr_array_add (batch->packages, g_object_ref (pkg));
+		batch->download_size += dnf_package_get_downloadsize (pkg);
+		download.download_size += dnf_package_get_downloadsize (pkg);
+	}
+	g_ptr_array_sort (download.batches, pk_backend_download_batch_sort_cb);
+
+	/* packages without a directory go to the cache of their repo */
+	if (!dnf_utils_check_free_space (directory != NULL ? directory :
+					 dnf_context_get_cache_dir (job_data->context),
+					 download.download_size, error))
+		goto out;
+
+	parallel = g_key_file_get_integer (priv->conf, "Daemon", "ParallelRepoDownloads", NULL);
+	if (parallel <= 0)
+		parallel = 3;
+	g_debug ("downloading %u packages from %u repos, %i at a time",
+		 packages->len, download.batches->len, parallel);
+
+	pk_backend_download_update_progress (&download);
+	pool = g_thread_pool_new (pk_backend_download_batch_thread,
+				  &download, parallel, FALSE, error);
+	if (pool == NULL)
+		goto out;
+	cancel_id = g_cancellable_connect (cancellable,
+					   G_CALLBACK (pk_backend_download_cancelled_cb),
+					   download.cancellable, NULL);
+	for (guint i = 0; i < download.batches->len; i++)
+		g_thread_pool_push (pool, g_ptr_array_index (download.batches, i), NULL);
+
+	/* wait for all of them */
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_cancellable_disconnect (cancellable, cancel_id);
+	if (download.error != NULL) {
+		g_propagate_error (error, g_steal_pointer (&download.error));
+		goto out;
+	}
+	ret = TRUE;
+out:
+	g_mutex_clear (&download.mutex);
+	g_ptr_array_unref (download.batches);
+	g_object_unref (download.cancellable);
+	return ret;
+}
+
 static void
 pk_backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	const gchar *directory;
 	gboolean ret;
-	gchar *tmp;
 	guint i;
-	DnfRepo *repo;
 	DnfState *state_local;
-	DnfState *state_loop;
 	DnfPackage *pkg;
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBitfield filters = pk_bitfield_value (PK_FILTER_ENUM_NOT_INSTALLED);
@@ -2113,6 +2813,9 @@ pk_backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpoint
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
 
 	g_variant_get (params, "(^a&ss)",
 		       &package_ids,
@@ -2166,9 +2869,7 @@ pk_backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpoint
 	}
 
 	/* download packages */
-	files = g_ptr_array_new_with_free_func (g_free);
-	state_local = dnf_state_get_child (job_data->state);
-	dnf_state_set_number_steps (state_local, g_strv_length (package_ids));
+	packages = g_ptr_array_new ();
 	for (i = 0; package_ids[i] != NULL; i++) {
 		pkg = g_hash_table_lookup (hash, package_ids[i]);
 		if (pkg == NULL) {
@@ -2177,43 +2878,22 @@ pk_backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpoint
 						   "Failed to find %s", package_ids[i]);
 			return;
 		}
+		g_ptr_array_add (packages, pkg);
+	}
+	state_local = dnf_state_get_child (job_data->state);
+	if (!dnf_utils_download_packages (job, packages, directory, state_local, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
 
-		dnf_emit_package (job, PK_INFO_ENUM_DOWNLOADING, pkg);
-
-		/* get correct package repo */
-		repo = dnf_repo_loader_get_repo_by_id (dnf_context_get_repo_loader (job_data->context),
-		                                       dnf_package_get_reponame (pkg),
-		                                       &error);
-		if (repo == NULL) {
-			g_prefix_error (&error, "Not sure where to download %s: ",
-					dnf_package_get_name (pkg));
-			pk_backend_job_error_code (job, error->code,
-						   "%s", error->message);
-			return;
-		}
-
-		/* download */
-		state_loop = dnf_state_get_child (state_local);
-		tmp = dnf_repo_download_package (repo,
-		                                 pkg,
-		                                 directory,
-		                                 state_loop,
-		                                 &error);
-		if (tmp == NULL) {
-			pk_backend_job_error_code (job, error->code,
-						   "%s", error->message);
-			return;
-		}
-
-		/* add to download list */
-		g_ptr_array_add (files, tmp);
+	/* add to download list */
+	files = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < packages->len; i++) {
+		g_autofree gchar *basename = NULL;
 
-		/* done */
-		ret = dnf_state_done (state_local, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
-		}
+		pkg = g_ptr_array_index (packages, i);
+		basename = g_path_get_basename (dnf_package_get_location (pkg));
+		g_ptr_array_add (files, g_build_filename (directory, basename, NULL));
 	}
 	g_ptr_array_add (files, NULL);
 
@@ -2411,16 +3091,13 @@ pk_backend_transaction_download_commit (PkBackendJob *job,
 
 	/* download */
 	state_local = dnf_state_get_child (state);
-	g_signal_connect (state_local, "percentage-changed",
-	                  G_CALLBACK (pk_backend_download_percentage_changed_cb),
-	                  job);
-	pk_backend_download_percentage_changed_cb (state, 0, job);
-	ret = dnf_transaction_download (job_data->transaction,
-					state_local,
-					error);
+	ret = dnf_utils_download_packages (job,
+					   dnf_transaction_get_remote_pkgs (job_data->transaction),
+					   NULL,
+					   state_local,
+					   error);
 	if (!ret)
 		return FALSE;
-	pk_backend_download_percentage_changed_cb (state, 100, job);
 
 	/* done */
 	if (!dnf_state_done (state, error))
@@ -2617,6 +3294,8 @@ pk_backend_repo_remove_thread (PkBackendJob *job,
 	g_autoptr(GPtrArray) repos = NULL;
 	g_auto(GStrv) search = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t&sb)",
 		       &job_data->transaction_flags,
 		       &repo_id,
@@ -2837,6 +3516,8 @@ pk_backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t^a&sbb)",
 		       &job_data->transaction_flags,
 		       &package_ids,
@@ -2986,6 +3667,8 @@ pk_backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointe
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t^a&s)",
 		       &job_data->transaction_flags,
 		       &package_ids);
@@ -3175,6 +3858,8 @@ pk_backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer u
 	g_autoptr(GHashTable) hash = NULL;
 	g_autoptr(GPtrArray) array = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t^a&s)",
 		       &job_data->transaction_flags,
 		       &full_paths);
@@ -3286,6 +3971,8 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	g_variant_get (params, "(t^a&s)",
 		       &job_data->transaction_flags,
 		       &package_ids);
@@ -3398,6 +4085,8 @@ pk_backend_upgrade_system_thread (PkBackendJob *job, GVariant *params, gpointer
 	g_autoptr(DnfSack) sack = NULL;
 	g_autoptr(GError) error = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* get arguments */
 	g_variant_get (params, "(t&su)",
 	               &job_data->transaction_flags,
@@ -3542,6 +4231,8 @@ pk_backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   90, /* add repos */
@@ -3655,6 +4346,8 @@ pk_backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpoint
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   50, /* add repos */
@@ -3805,6 +4498,8 @@ pk_backend_repair_system_thread (PkBackendJob *job, GVariant *params, gpointer u
 	g_autoptr(GDir) dir = NULL;
 	g_autoptr(GError) error = NULL;
 
+	pk_backend_sack_prewarm_wait (pk_backend_job_get_backend (job), job);
+
 	/* don't do anything when simulating */
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	transaction_flags = pk_backend_job_get_transaction_flags (job);
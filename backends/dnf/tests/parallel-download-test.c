@@ -0,0 +1,351 @@
+/* parallel-download-test.c
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <pk-backend.h>
+#include <pk-backend-job.h>
+
+typedef struct {
+	PkExitEnum	 exit;
+	GHashTable	*done;		/* of package IDs at 100% */
+	GHashTable	*started;	/* of repo IDs downloading before any is done */
+	GArray		*remaining;	/* of guint64 */
+	guint		 speed;
+	guint		 speeds;
+} JobResult;
+
+/* serves the fixture over HTTP, and holds back the packages until both
+ * repos asked for theirs, so the downloads must overlap to finish */
+typedef struct {
+	GMutex		 mutex;
+	GCond		 cond;
+	GHashTable	*requested;	/* of repo IDs */
+	gboolean	 overlapped;
+} Server;
+
+static const gchar *package_files[] = {
+	"pk-fixture-a/noarch/pk-fixture-alpha-1.0-1.noarch.rpm",
+	"pk-fixture-a/noarch/pk-fixture-beta-1.0-1.noarch.rpm",
+	"pk-fixture-b/noarch/pk-fixture-gamma-1.0-1.noarch.rpm",
+	NULL };
+
+static const gchar *package_ids[] = {
+	"pk-fixture-alpha;1.0-1;noarch;pk-fixture-a",
+	"pk-fixture-beta;1.0-1;noarch;pk-fixture-a",
+	"pk-fixture-gamma;1.0-1;noarch;pk-fixture-b",
+	NULL };
+
+static GKeyFile *conf;
+static PkBackend *backend;
+static GMainLoop *loop;
+static gchar *root;
+static Server server;
+
+static void
+item_progress_cb (PkBackendJob *job, PkItemProgress *item, JobResult *result)
+{
+	if (pk_item_progress_get_percentage (item) == 100)
+		g_hash_table_add (result->done, g_strdup (pk_item_progress_get_package_id (item)));
+}
+
+static void
+package_cb (PkBackendJob *job, PkPackage *package, JobResult *result)
+{
+	if (pk_package_get_info (package) == PK_INFO_ENUM_DOWNLOADING &&
+	    g_hash_table_size (result->done) == 0)
+		g_hash_table_add (result->started, g_strdup (pk_package_get_data (package)));
+}
+
+static void
+speed_cb (PkBackendJob *job, gpointer speed, JobResult *result)
+{
+	result->speed = GPOINTER_TO_UINT (speed);
+	result->speeds++;
+}
+
+static void
+download_size_remaining_cb (PkBackendJob *job, guint64 *remaining, JobResult *result)
+{
+	g_array_append_val (result->remaining, *remaining);
+}
+
+static void
+finished_cb (PkBackendJob *job, gpointer exit, JobResult *result)
+{
+	result->exit = (PkExitEnum) GPOINTER_TO_UINT (exit);
+	g_main_loop_quit (loop);
+}
+
+/* like the daemon runs a transaction */
+static PkBackendJob *
+job_new (JobResult *result)
+{
+	PkBackendJob *job = pk_backend_job_new (conf);
+
+	pk_backend_start_job (backend, job);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_ITEM_PROGRESS,
+				  PK_BACKEND_JOB_VFUNC (item_progress_cb), result);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (package_cb), result);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_SPEED,
+				  PK_BACKEND_JOB_VFUNC (speed_cb), result);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_DOWNLOAD_SIZE_REMAINING,
+				  PK_BACKEND_JOB_VFUNC (download_size_remaining_cb), result);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (finished_cb), result);
+	result->exit = PK_EXIT_ENUM_UNKNOWN;
+	result->done = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	result->started = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	result->remaining = g_array_new (FALSE, FALSE, sizeof (guint64));
+	result->speed = 0;
+	result->speeds = 0;
+	return job;
+}
+
+static void
+job_free (PkBackendJob *job, JobResult *result)
+{
+	pk_backend_stop_job (backend, job);
+	g_object_unref (job);
+	g_hash_table_unref (result->done);
+	g_hash_table_unref (result->started);
+	g_array_unref (result->remaining);
+}
+
+static void
+test_parallel_download (void)
+{
+	JobResult result;
+	PkBackendJob *job;
+	g_autofree gchar *directory = g_build_filename (root, "downloads", NULL);
+
+	/* the packages of both repos, which are downloaded at the same time */
+	g_assert_cmpint (g_mkdir_with_parents (directory, 0755), ==, 0);
+	job = job_new (&result);
+	pk_backend_download_packages (backend, job, (gchar **) package_ids, directory);
+	g_main_loop_run (loop);
+	g_assert_cmpint (result.exit, ==, PK_EXIT_ENUM_SUCCESS);
+
+	/* both repos were being downloaded before either one was done */
+	g_assert_true (server.overlapped);
+	g_assert_true (g_hash_table_contains (result.started, "pk-fixture-a"));
+	g_assert_true (g_hash_table_contains (result.started, "pk-fixture-b"));
+
+	/* the progress of both together, which never goes backwards */
+	g_assert_cmpuint (result.remaining->len, >, 0);
+	for (guint i = 1; i < result.remaining->len; i++) {
+		g_assert_cmpuint (g_array_index (result.remaining, guint64, i), <,
+				  g_array_index (result.remaining, guint64, i - 1));
+	}
+	g_assert_cmpuint (g_array_index (result.remaining, guint64, result.remaining->len - 1), ==, 0);
+	if (result.speeds > 0)
+		g_assert_cmpuint (result.speed, ==, 0);
+
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_autofree gchar *basename = g_path_get_basename (package_files[i]);
+		g_autofree gchar *expected = NULL;
+		g_autofree gchar *fixture = g_build_filename (TESTDATADIR, package_files[i], NULL);
+		g_autofree gchar *downloaded = g_build_filename (directory, basename, NULL);
+		g_autofree gchar *contents = NULL;
+
+		g_assert_true (g_hash_table_contains (result.done, package_ids[i]));
+		g_assert_true (g_file_get_contents (fixture, &expected, NULL, NULL));
+		g_assert_true (g_file_get_contents (downloaded, &contents, NULL, NULL));
+		g_assert_cmpstr (contents, ==, expected);
+	}
+	job_free (job, &result);
+}
+
+static gboolean
+server_run_cb (GThreadedSocketService *service,
+	       GSocketConnection *connection,
+	       GObject *source_object,
+	       gpointer user_data)
+{
+	gsize len = 0;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *header = NULL;
+	g_autofree gchar *line = NULL;
+	g_autoptr(GDataInputStream) input = NULL;
+	g_auto(GStrv) request = NULL;
+	GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+	/* GET /pk-fixture-a/noarch/pk-fixture-alpha-1.0-1.noarch.rpm HTTP/1.1 */
+	input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	line = g_data_input_stream_read_line (input, NULL, NULL, NULL);
+	if (line == NULL)
+		return FALSE;
+	request = g_strsplit (g_strchomp (line), " ", 3);
+	for (;;) {
+		g_autofree gchar *tmp = g_data_input_stream_read_line (input, NULL, NULL, NULL);
+		if (tmp == NULL || g_strchomp (tmp)[0] == '\0')
+			break;
+	}
+	if (g_strv_length (request) == 3 && strstr (request[1], "..") == NULL)
+		filename = g_build_filename (TESTDATADIR, request[1], NULL);
+
+	if (filename != NULL && g_str_has_suffix (filename, ".rpm")) {
+		g_auto(GStrv) path = g_strsplit (request[1] + 1, "/", 2);
+		gint64 end_time = g_get_monotonic_time () + 30 * G_TIME_SPAN_SECOND;
+
+		g_mutex_lock (&server.mutex);
+		g_hash_table_add (server.requested, g_strdup (path[0]));
+		g_cond_broadcast (&server.cond);
+		while (g_hash_table_size (server.requested) < 2) {
+			if (!g_cond_wait_until (&server.cond, &server.mutex, end_time))
+				break;
+		}
+		if (g_hash_table_size (server.requested) == 2)
+			server.overlapped = TRUE;
+		g_mutex_unlock (&server.mutex);
+	}
+
+	if (filename != NULL && g_file_get_contents (filename, &contents, &len, NULL)) {
+		header = g_strdup_printf ("HTTP/1.1 200 OK\r\n"
+					  "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+					  "Connection: close\r\n\r\n", len);
+	} else {
+		header = g_strdup ("HTTP/1.1 404 Not Found\r\n"
+				   "Content-Length: 0\r\n"
+				   "Connection: close\r\n\r\n");
+	}
+	if (g_output_stream_write_all (output, header, strlen (header), NULL, NULL, NULL) &&
+	    contents != NULL)
+		g_output_stream_write_all (output, contents, len, NULL, NULL, NULL);
+	g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+	return FALSE;
+}
+
+/* returns the port the fixture is served on */
+static guint16
+server_start (GSocketService **service)
+{
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GInetAddress) loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+	g_autoptr(GSocketAddress) address = g_inet_socket_address_new (loopback, 0);
+	g_autoptr(GSocketAddress) effective = NULL;
+
+	g_mutex_init (&server.mutex);
+	g_cond_init (&server.cond);
+	server.requested = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	*service = g_threaded_socket_service_new (8);
+	if (!g_socket_listener_add_address (G_SOCKET_LISTENER (*service), address,
+					    G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+					    NULL, &effective, &error))
+		g_error ("failed to serve the fixture: %s", error->message);
+	g_signal_connect (*service, "run", G_CALLBACK (server_run_cb), NULL);
+	g_socket_service_start (*service);
+	return g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (effective));
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *child = g_build_filename (path, name, NULL);
+		if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+		    !g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+			remove_tree (child);
+		else
+			g_unlink (child);
+	}
+	g_rmdir (path);
+}
+
+static void
+write_file (const gchar *name, const gchar *contents)
+{
+	g_autofree gchar *path = g_build_filename (root, name, NULL);
+	g_autofree gchar *dir = g_path_get_dirname (path);
+
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+	g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+}
+
+int
+main (int argc, char *argv[])
+{
+	JobResult refresh;
+	PkBackendJob *job;
+	guint16 port;
+	g_autofree gchar *repos = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GSocketService) service = NULL;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* an empty system, which only knows the fixture repositories */
+	root = g_dir_make_tmp ("pk-dnf-test-XXXXXX", NULL);
+	g_assert_nonnull (root);
+	port = server_start (&service);
+	repos = g_strdup_printf ("[pk-fixture-a]\n"
+				 "name=PackageKit fixture A\n"
+				 "baseurl=http://127.0.0.1:%u/pk-fixture-a\n"
+				 "enabled=1\n"
+				 "gpgcheck=0\n"
+				 "\n"
+				 "[pk-fixture-b]\n"
+				 "name=PackageKit fixture B\n"
+				 "baseurl=http://127.0.0.1:%u/pk-fixture-b\n"
+				 "enabled=1\n"
+				 "gpgcheck=0\n",
+				 port, port);
+	write_file ("etc/yum.repos.d/pk-fixture.repo", repos);
+
+	/* the module next to this test, see PK_BUILD_LOCAL */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dnf");
+	g_key_file_set_string (conf, "Daemon", "DestDir", root);
+	g_key_file_set_integer (conf, "Daemon", "ParallelRepoDownloads", 2);
+	backend = pk_backend_new (conf);
+	if (!pk_backend_load (backend, &error))
+		g_error ("failed to load the backend: %s", error->message);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	/* the repositories have to be cached before anything can be found */
+	job = job_new (&refresh);
+	pk_backend_refresh_cache (backend, job, TRUE);
+	g_main_loop_run (loop);
+	g_assert_cmpint (refresh.exit, ==, PK_EXIT_ENUM_SUCCESS);
+	job_free (job, &refresh);
+
+	g_test_add_func ("/dnf/parallel-download", test_parallel_download);
+
+	int ret = g_test_run ();
+	pk_backend_unload (backend);
+	g_socket_service_stop (service);
+	g_main_loop_unref (loop);
+	g_object_unref (backend);
+	g_key_file_unref (conf);
+	g_hash_table_unref (server.requested);
+	remove_tree (root);
+	g_free (root);
+	return ret;
+}
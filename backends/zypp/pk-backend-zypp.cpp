@@ -33,8 +33,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/stat.h>
 #include <sys/vfs.h>
 #include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <glib.h>
@@ -59,6 +62,7 @@
 #include <zypp/RepoInfo.h>
 #include <zypp/RepoInfo.h>
 #include <zypp/RepoManager.h>
+#include <zypp/RepoStatus.h>
 #include <zypp/Repository.h>
 #include <zypp/ResFilters.h>
 #include <zypp/ResObject.h>
@@ -109,11 +113,21 @@ typedef enum {
         EQUAL_VERSION
 } VersionRelation;
 
+/**
+ * Holds the zypp lock for the lifetime of a job. Neither libzypp nor
+ * libsolv may be used from two threads at once: even plain queries
+ * intern strings and capabilities, fill the whatprovides cache, use the
+ * temporary space of the pool, and log. Queries get the pool brought up
+ * to date before they run.
+ */
 class ZyppJob {
  public:
-	ZyppJob(PkBackendJob *job);
+	ZyppJob(PkBackendJob *job, gboolean query = FALSE);
 	~ZyppJob();
 	zypp::ZYpp::Ptr get_zypp();
+ private:
+	PkBackendJob *_job;
+	gboolean _query;
 };
 
 enum PkgSearchType {
@@ -553,13 +567,39 @@ class PkBackendZYppPrivate {
 	PkBackendJob *currentJob;
 	
 	pthread_mutex_t zypp_mutex;
+
+	// the system to manage, DestDir in the config file
+	filesystem::Pathname root;
+
+	// what the pool was last loaded from, see zypp_load_pool
+	std::string poolTargetStamp;
+	std::map<std::string, std::string> poolRepoStamps;
+
+	// see zypp_rpmdb_cookie
+	std::string rpmDbFiles;
+	std::string rpmDbCookie;
+
+	// see zypp_prepare_pool
+	gboolean poolPrepared;
+	unsigned poolSerial;
+
+	// see zypp_get_updates
+	gboolean updatesValid;
+	unsigned updatesSerial;
+	bool updatesHidePackages;
+	SelfUpdate updatesDetail;
+	std::set<PoolItem> updates;
 };
 
 }; // namespace ZyppBackend
 
 using namespace ZyppBackend;
 
-ZyppJob::ZyppJob(PkBackendJob *job)
+static gboolean zypp_prepare_pool (PkBackendJob *job, ZYpp::Ptr zypp);
+static gboolean zypp_pool_is_current (void);
+
+ZyppJob::ZyppJob(PkBackendJob *job, gboolean query)
+	: _job(job), _query(query)
 {
 	MIL << "locking zypp" << std::endl;
 	pthread_mutex_lock(&priv->zypp_mutex);
@@ -586,8 +626,8 @@ ZyppJob::~ZyppJob()
 /**
  * Initialize Zypp (Factory method)
  */
-ZYpp::Ptr
-ZyppJob::get_zypp()
+static ZYpp::Ptr
+zypp_initialize (PkBackendJob *job)
 {
 	static gboolean initialized = FALSE;
 	ZYpp::Ptr zypp = NULL;
@@ -598,22 +638,35 @@ ZyppJob::get_zypp()
 		/* TODO: we need to lifecycle manage this, detect changes
 		   in the requested 'root' etc. */
 		if (!initialized) {
-			filesystem::Pathname pathname("/");
-			zypp->initializeTarget (pathname);
+			zypp->initializeTarget (priv->root);
 
 			initialized = TRUE;
 		}
 	} catch (const ZYppFactoryException &ex) {
-		pk_backend_job_error_code (priv->currentJob, PK_ERROR_ENUM_FAILED_INITIALIZATION, "%s", ex.asUserString().c_str() );
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_FAILED_INITIALIZATION, "%s", ex.asUserString().c_str() );
 		return NULL;
 	} catch (const Exception &ex) {
-		pk_backend_job_error_code (priv->currentJob, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", ex.asUserString().c_str() );
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", ex.asUserString().c_str() );
 		return NULL;
 	}
 
 	return zypp;
 }
 
+ZYpp::Ptr
+ZyppJob::get_zypp()
+{
+	ZYpp::Ptr zypp = zypp_initialize (_job);
+
+	// queries answer from the pool as the last job left it, unless the
+	// rpm database or the repository metadata changed since
+	if (zypp != NULL && _query && !zypp_pool_is_current () &&
+	    !zypp_prepare_pool (_job, zypp))
+		return NULL;
+
+	return zypp;
+}
+
 
 
 
@@ -692,6 +745,89 @@ zypp_is_valid_repo (PkBackendJob *job, RepoInfo repo)
 	return TRUE;
 }
 
+/**
+ * The cookie libzypp keys the solv file of the system repository on: the
+ * RepoStatus of the rpm database file. That checksums the whole database,
+ * so it is only computed again when a file in the database directory
+ * changed size, inode or modification time (in nanoseconds, rpm can write
+ * the database several times within one second).
+ */
+static std::string
+zypp_rpmdb_cookie (Target_Ptr target)
+{
+	Pathname dbPath = target->root () / target->rpmDb ().dbPath ();
+	std::list<std::string> names;
+	std::ostringstream files;
+
+	filesystem::readdir (names, dbPath, false);
+	names.sort ();
+	for (const std::string &name : names) {
+		struct stat buf;
+		if (stat ((dbPath / name).c_str (), &buf) != 0 || !S_ISREG (buf.st_mode))
+			continue;
+		files << name << ' ' << buf.st_ino << ' ' << buf.st_size << ' '
+		      << buf.st_mtim.tv_sec << '.' << buf.st_mtim.tv_nsec << '\n';
+	}
+
+	if (files.str () == priv->rpmDbFiles && !priv->rpmDbCookie.empty ())
+		return priv->rpmDbCookie;
+
+	// the same database file TargetImpl::rpmDbRepoStatus picks
+	RepoStatus status;
+	for (const char *name : { "Packages.db", "Packages", "rpmdb.sqlite" }) {
+		if (PathInfo (dbPath / name).isFile ()) {
+			status = RepoStatus (dbPath / name);
+			break;
+		}
+	}
+	if (status.empty ())
+		status = RepoStatus (dbPath);
+
+	priv->rpmDbFiles = files.str ();
+	priv->rpmDbCookie = status.checksum ();
+	return priv->rpmDbCookie;
+}
+
+/**
+ * What loading the target puts into the pool depends on: the rpm database,
+ * and the package locks, which TargetImpl::load applies to the pool.
+ */
+static std::string
+zypp_target_stamp (Target_Ptr target)
+{
+	Pathname locksFile = Pathname::assertprefix (target->root (), ZConfig::instance ().locksFile ());
+	std::ostringstream stamp;
+	struct stat buf;
+
+	stamp << zypp_rpmdb_cookie (target);
+	if (stat (locksFile.c_str (), &buf) == 0)
+		stamp << " locks " << buf.st_ino << ' ' << buf.st_size << ' '
+		      << buf.st_mtim.tv_sec << '.' << buf.st_mtim.tv_nsec;
+	return stamp.str ();
+}
+
+/**
+ * Load the installed packages into the pool, unless it already holds them
+ * from the same rpm database and with the same locks. libzypp keeps the
+ * solv file of the system repository keyed on the rpmdb cookie, so an
+ * unchanged rpmdb is never read again; this also skips reading and
+ * indexing that solv file.
+ */
+static void
+zypp_load_target (Target_Ptr target)
+{
+	std::string targetStamp = zypp_target_stamp (target);
+
+	if (targetStamp == priv->poolTargetStamp &&
+	    !sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias ()).solvablesEmpty ())
+		return;
+
+	g_autoptr(GTimer) timer = g_timer_new ();
+	target->load ();
+	priv->poolTargetStamp = targetStamp;
+	MIL << "loaded the target in " << g_timer_elapsed (timer, NULL) << "s" << endl;
+}
+
 /**
  * Build and return a ResPool that contains all local resolvables
  * and ones found in the enabled repositories.
@@ -707,8 +843,7 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 		if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
 		{
 			// Add local resolvables
-			Target_Ptr target = zypp->target ();
-			target->load ();
+			zypp_load_target (zypp->target ());
 		}
 	} else {
 		if (!sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
@@ -724,7 +859,7 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 		return zypp->pool();
 
 	// Add resolvables from enabled repos
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	try {
 		for (RepoManager::RepoConstIterator it = manager.repoBegin(); it != manager.repoEnd(); ++it) {
 			RepoInfo repo (*it);
@@ -974,7 +1109,7 @@ zypp_get_Repository (PkBackendJob *job, const gchar *alias)
 	RepoInfo info;
 
 	try {
-		RepoManager manager;
+		RepoManager manager (RepoManagerOptions (priv->root));
 		info = manager.getRepositoryInfo (alias);
 	} catch (const repo::RepoNotFoundException &ex) {
 		pk_backend_job_error_code (job, PK_ERROR_ENUM_REPO_NOT_FOUND, "%s", ex.asUserString().c_str() );
@@ -1298,13 +1433,37 @@ zypp_get_patches (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &patches)
 	return detail;
 }
 
+/**
+  * Whether HidePackages in /etc/PackageKit/ZYpp.conf asks to only offer
+  * patches as updates
+  */
+static bool
+zypp_hide_packages (void)
+{
+	bool hidePackages = false;
+	if (PathInfo("/etc/PackageKit/ZYpp.conf").isExist()) {
+		parser::IniDict vendorConf(InputStream("/etc/PackageKit/ZYpp.conf"));
+		if (vendorConf.hasSection("Updates")) {
+			for ( parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Updates");
+			      eit != vendorConf.entriesEnd("Updates");
+			      ++eit )
+			{
+				if ((*eit).first == "HidePackages" &&
+				    str::strToTrue((*eit).second))
+					hidePackages = true;
+			}
+		}
+	}
+	return hidePackages;
+}
+
 /**
   * Return the best, most friendly selection of update patches and packages that
   * we can find. Also manages SelfUpdate to prioritise critical infrastructure
   * updates.
   */
 static SelfUpdate
-zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
+zypp_find_updates (PkBackendJob *job, ZYpp::Ptr zypp, bool hidePackages, set<PoolItem> &candidates)
 {
 	typedef set<PoolItem>::iterator pi_it_t;
 	SelfUpdate detail = zypp_get_patches (job, zypp, candidates);
@@ -1316,21 +1475,6 @@ zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
 			patchRepo = candidates.begin ()->resolvable ()->repoInfo ().alias ();
 		}
 
-		bool hidePackages = false;
-		if (PathInfo("/etc/PackageKit/ZYpp.conf").isExist()) {
-			parser::IniDict vendorConf(InputStream("/etc/PackageKit/ZYpp.conf"));
-			if (vendorConf.hasSection("Updates")) {
-				for ( parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Updates");
-				      eit != vendorConf.entriesEnd("Updates");
-				      ++eit )
-				{
-					if ((*eit).first == "HidePackages" &&
-					    str::strToTrue((*eit).second))
-						hidePackages = true;
-				}
-			}
-		}
-
 		if (!hidePackages)
 		{
 			set<PoolItem> packages;
@@ -1368,6 +1512,37 @@ zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
 	return detail;
 }
 
+/**
+  * Like zypp_find_updates, but the resolver only runs again when the pool
+  * changed, i.e. when the rpm database, the package locks or the
+  * repositories were reloaded, or when HidePackages changed.
+  */
+static SelfUpdate
+zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
+{
+	bool hidePackages = zypp_hide_packages ();
+
+	if (priv->updatesValid &&
+	    priv->updatesSerial == sat::Pool::instance ().serial ().serial () &&
+	    priv->updatesHidePackages == hidePackages) {
+		MIL << "using the cached updates" << endl;
+		candidates.insert (priv->updates.begin (), priv->updates.end ());
+		return priv->updatesDetail;
+	}
+
+	set<PoolItem> updates;
+	SelfUpdate detail = zypp_find_updates (job, zypp, hidePackages, updates);
+
+	priv->updates.swap (updates);
+	priv->updatesDetail = detail;
+	priv->updatesSerial = sat::Pool::instance ().serial ().serial ();
+	priv->updatesHidePackages = hidePackages;
+	priv->updatesValid = TRUE;
+
+	candidates.insert (priv->updates.begin (), priv->updates.end ());
+	return detail;
+}
+
 /**
   * Sets the restart flag of a patch
   */
@@ -1391,6 +1566,23 @@ zypp_check_restart (PkRestartEnum *restart, Patch::constPtr patch)
 	}
 }
 
+/**
+  * Refuse to remove a package PackageKit itself cannot do without
+  */
+static bool
+zypp_check_removable (PkBackendJob *job, const sat::Solvable &solvable)
+{
+	const string &name = solvable.name();
+	if (name == "glibc" || name == "PackageKit" ||
+	    name == "rpm" || name == "libzypp") {
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_CANNOT_REMOVE_SYSTEM_PACKAGE,
+				       "The package %s is essential to correct operation and cannot be removed using this tool.",
+				       name.c_str());
+		return false;
+	}
+	return true;
+}
+
 /**
   * helper to emit pk package status signals based on a ResPool object
   */
@@ -1412,14 +1604,8 @@ zypp_backend_pool_item_notify (PkBackendJob  *job,
 	} else if (item.status ().isToBeUninstalled ()) {
 		status = PK_INFO_ENUM_REMOVING;
 
-		const string &name = item.satSolvable().name();
-		if (name == "glibc" || name == "PackageKit" ||
-		    name == "rpm" || name == "libzypp") {
-			pk_backend_job_error_code (job, PK_ERROR_ENUM_CANNOT_REMOVE_SYSTEM_PACKAGE,
-					       "The package %s is essential to correct operation and cannot be removed using this tool.",
-					       name.c_str());
+		if (!zypp_check_removable (job, item.satSolvable()))
 			return false;
-		}
 	}
 
 	// FIXME: do we need more heavy lifting here cf. zypper's
@@ -1654,7 +1840,7 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 
 	if (zypp == NULL)
 		return  FALSE;
-	filesystem::Pathname pathname("/");
+	filesystem::Pathname pathname(priv->root);
 
 	bool poolIsClean = sat::Pool::instance ().reposEmpty ();
 	// Erase and reload all if pool is too holey (densyity [100: good | 0 bad])
@@ -1678,12 +1864,12 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 		target->rpmDb ().exportTrustedKeysInZyppKeyRing ();
 	}
 	// load installed packages to pool
-	target->load ();
+	zypp_load_target (target);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
 	pk_backend_job_set_percentage (job, 0);
 
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	list <RepoInfo> repos;
 	try
 	{
@@ -1773,6 +1959,141 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 	return TRUE;
 }
 
+/**
+  * Collect what the pool is built from: the rpm database and the locks,
+  * see zypp_target_stamp, and the checksum of the cached metadata of each
+  * enabled repository.
+  */
+static void
+zypp_get_pool_stamps (ZYpp::Ptr zypp, RepoManager &manager,
+		      std::string &targetStamp, std::map<std::string, std::string> &repoStamps)
+{
+	Target_Ptr target = zypp->getTarget ();
+	targetStamp = target ? zypp_target_stamp (target) : std::string ();
+
+	for (RepoManager::RepoConstIterator it = manager.repoBegin (); it != manager.repoEnd (); ++it) {
+		const RepoInfo &repo (*it);
+
+		// skip disabled repos, changeable media and not cached repos
+		if (repo.enabled () == false ||
+		    (!repo.baseUrlsEmpty () && repo.baseUrlsBegin ()->schemeIsVolatile ()) ||
+		    manager.isCached (repo) == false)
+			continue;
+
+		repoStamps[repo.alias ()] = manager.metadataStatus (repo).checksum ();
+	}
+}
+
+/**
+  * Make sure the pool matches the rpm database and the cached metadata
+  * of the enabled repositories, without touching the network.
+  *
+  * The system repository is only reloaded when the rpm database changed,
+  * and a repository only when its cached metadata changed, so that
+  * queries can be answered from the pool as it is most of the time.
+  * Downloading new metadata is left to RefreshCache.
+  */
+static gboolean
+zypp_load_pool (PkBackendJob *job, ZYpp::Ptr zypp)
+{
+	if (zypp == NULL)
+		return FALSE;
+
+	try
+	{
+		Target_Ptr target = zypp->getTarget ();
+		if (!target)
+			zypp->initializeTarget (priv->root);
+
+		zypp_load_target (zypp->getTarget ());
+
+		RepoManager manager (RepoManagerOptions (priv->root));
+		std::string targetStamp;
+		std::map<std::string, std::string> repoStamps;
+		zypp_get_pool_stamps (zypp, manager, targetStamp, repoStamps);
+
+		for (std::map<std::string, std::string>::const_iterator it = repoStamps.begin (); it != repoStamps.end (); ++it) {
+			std::map<std::string, std::string>::const_iterator loaded = priv->poolRepoStamps.find (it->first);
+			if (loaded != priv->poolRepoStamps.end () && loaded->second == it->second &&
+			    sat::Pool::instance ().reposFind (it->first) != Repository::noRepository)
+				continue;
+
+			MIL << "metadata of " << it->first << " changed, reloading it" << endl;
+			pk_backend_job_set_status (job, PK_STATUS_ENUM_LOADING_CACHE);
+			sat::Pool::instance ().reposErase (it->first);
+			manager.loadFromCache (manager.getRepositoryInfo (it->first));
+		}
+
+		// drop repos which were removed or disabled since
+		std::vector<std::string> aliasesToRemove;
+		for (const Repository &poolrepo : zypp->pool ().knownRepositories ())
+		{
+			if (!poolrepo.isSystemRepo () && repoStamps.find (poolrepo.alias ()) == repoStamps.end ())
+				aliasesToRemove.push_back (poolrepo.alias ());
+		}
+		for (const std::string &aliasToRemove : aliasesToRemove)
+		{
+			sat::Pool::instance ().reposErase (aliasToRemove);
+		}
+
+		priv->poolRepoStamps.swap (repoStamps);
+	}
+	catch (const Exception &ex)
+	{
+		// force a full reload the next time
+		priv->poolTargetStamp.clear ();
+		priv->poolRepoStamps.clear ();
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_REPO_NOT_FOUND, "%s", ex.asUserString ().c_str ());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+  * Bring the pool up to date and build the whatprovides index and the
+  * pool proxy, which queries would otherwise each check for.
+  */
+static gboolean
+zypp_prepare_pool (PkBackendJob *job, ZYpp::Ptr zypp)
+{
+	if (!zypp_load_pool (job, zypp))
+		return FALSE;
+
+	zypp_build_pool (zypp, TRUE);
+	sat::Pool::instance ().prepare ();
+	zypp->poolProxy ();
+
+	priv->poolSerial = sat::Pool::instance ().serial ().serial ();
+	priv->poolPrepared = TRUE;
+	return TRUE;
+}
+
+/**
+  * Whether the pool is still the one zypp_prepare_pool left, and
+  * still matches the rpm database, the locks and the repository metadata.
+  */
+static gboolean
+zypp_pool_is_current (void)
+{
+	if (!priv->poolPrepared ||
+	    priv->poolSerial != sat::Pool::instance ().serial ().serial ())
+		return FALSE;
+
+	try
+	{
+		RepoManager manager (RepoManagerOptions (priv->root));
+		std::string targetStamp;
+		std::map<std::string, std::string> repoStamps;
+		zypp_get_pool_stamps (ZYppFactory::instance ().getZYpp (), manager, targetStamp, repoStamps);
+		return targetStamp == priv->poolTargetStamp && repoStamps == priv->poolRepoStamps;
+	}
+	catch (const Exception &ex)
+	{
+		return FALSE;
+	}
+}
+
 /**
   * helper to simplify returning errors
   */
@@ -1801,7 +2122,7 @@ zypp_backend_finished_error (PkBackendJob  *job, PkErrorEnum err_code,
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-        return FALSE;
+	return FALSE;
 }
 
 
@@ -1826,7 +2147,14 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	/* create private area */
 	priv = new PkBackendZYppPrivate;
 	priv->currentJob = 0;
+	priv->poolPrepared = FALSE;
+	priv->poolSerial = 0;
+	priv->updatesValid = FALSE;
+
 	priv->zypp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	g_autofree gchar *destdir = g_key_file_get_string (conf, "Daemon", "DestDir", NULL);
+	priv->root = destdir != NULL ? destdir : "/";
 	zypp_logging ();
 
 	/* Set PATH variable to avoid problems when installing packges(bsc#1175315). */
@@ -1854,8 +2182,18 @@ zypp_is_no_solvable (const sat::Solvable &solv)
 }
 
 /**
-  * backend_required_by_thread:
-  */
+ * Emit, as REMOVING, the given installed packages and the installed
+ * packages which would break if they were removed: those requiring a
+ * capability only provided by them. With recursive set, the packages
+ * breaking because of those are followed too.
+ *
+ * Unlike the resolver this used to run, only requirements (pre-requires
+ * included) between installed packages are followed. A package the
+ * resolver could have kept by installing another provider from a
+ * repository is reported too. Without recursive set only the direct
+ * dependents are listed, where the resolver always removed the whole
+ * closure.
+ */
 static void
 backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
@@ -1869,7 +2207,7 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		      &package_ids,
 		      &recursive);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -1880,8 +2218,10 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pk_backend_job_set_percentage (job, 10);
 
-	ResPool pool = zypp_build_pool (zypp, true);
-	PoolStatusSaver saver;
+	// the packages considered removed, and the ones still to look at
+	unordered_set<sat::detail::IdType> removed;
+	vector<sat::Solvable> queue;
+
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 
@@ -1891,45 +2231,93 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 			return;
 		}
 
-		PoolItem package = PoolItem(solvable);
-
 		// required-by only works for installed packages. It's meaningless for stuff in the repo
 		// same with yum backend
 		if (!solvable.isSystem ())
 			continue;
-		// set Package as to be uninstalled
-		package.status ().setToBeUninstalled (ResStatus::USER);
+		if (removed.insert (solvable.id ()).second)
+			queue.push_back (solvable);
+	}
+	const size_t requestedCount = queue.size ();
 
-		// solver run
-		ResPool pool = ResPool::instance ();
-		Resolver solver(pool);
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_DEP_RESOLVE);
+	pk_backend_job_set_percentage (job, 30);
 
-		solver.setForceResolve (true);
-		solver.setIgnoreAlreadyRecommended (TRUE);
+	// the installed providers of each capability required by an
+	// installed package, looked up once
+	unordered_map<sat::detail::IdType, vector<sat::Solvable> > providers;
+	// provider -> (package, capability) requiring it
+	unordered_map<sat::detail::IdType, vector<pair<sat::Solvable, Capability> > > requiredBy;
 
-		if (!solver.resolvePool ()) {
-			string problem = "Resolution failed: ";
-			list<ResolverProblem_Ptr> problems = solver.problems ();
-			for (list<ResolverProblem_Ptr>::iterator it = problems.begin (); it != problems.end (); ++it){
-				problem += (*it)->description ();
+	Repository system = sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias ());
+	for_(it, system.solvablesBegin (), system.solvablesEnd ()) {
+		Capabilities req = (*it)[Dep::REQUIRES];
+		for (Capabilities::const_iterator cap = req.begin (); cap != req.end (); ++cap) {
+			unordered_map<sat::detail::IdType, vector<sat::Solvable> >::iterator prov = providers.find (cap->id ());
+			if (prov == providers.end ()) {
+				prov = providers.insert (make_pair (cap->id (), vector<sat::Solvable> ())).first;
+
+				sat::WhatProvides prov_list (*cap);
+				for (sat::WhatProvides::const_iterator provider = prov_list.begin ();
+				     provider != prov_list.end (); ++provider) {
+					if (provider->isSystem ())
+						prov->second.push_back (*provider);
+				}
+			}
+
+			for (const sat::Solvable &provider : prov->second) {
+				if (provider != *it)
+					requiredBy[provider.id ()].push_back (make_pair (*it, *cap));
 			}
-			zypp_backend_finished_error (
-				job, PK_ERROR_ENUM_DEP_RESOLUTION_FAILED,
-				problem.c_str());
-			return;
 		}
+	}
 
-		// look for packages which would be uninstalled
-		bool error = false;
-		for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package);
-				it != pool.byKindEnd (ResKind::package); ++it) {
+	pk_backend_job_set_percentage (job, 70);
+
+	unordered_set<sat::detail::IdType> seen (removed);
+	vector<sat::Solvable> broken;
+	for (size_t i = 0; i < queue.size (); i++) {
+		unordered_map<sat::detail::IdType, vector<pair<sat::Solvable, Capability> > >::const_iterator req = requiredBy.find (queue[i].id ());
+		if (req == requiredBy.end ())
+			continue;
+
+		for (const pair<sat::Solvable, Capability> &item : req->second) {
+			if (seen.find (item.first.id ()) != seen.end ())
+				continue;
+
+			// still fine as long as something else provides it
+			bool provided = false;
+			for (const sat::Solvable &provider : providers[item.second.id ()]) {
+				if (removed.find (provider.id ()) == removed.end ()) {
+					provided = true;
+					break;
+				}
+			}
+			if (provided)
+				continue;
 
-			if (!error && !zypp_filter_solvable (_filters, it->resolvable()->satSolvable()))
-				error = !zypp_backend_pool_item_notify (job, *it);
+			seen.insert (item.first.id ());
+			broken.push_back (item.first);
+			if (recursive) {
+				removed.insert (item.first.id ());
+				queue.push_back (item.first);
+			}
 		}
+	}
 
-		solver.setForceResolve (false);
+	// the packages themselves are removed as well
+	broken.insert (broken.begin (), queue.begin (), queue.begin () + requestedCount);
+	for (const sat::Solvable &solvable : broken) {
+		if (!zypp_check_removable (job, solvable))
+			return;
+	}
+	for (const sat::Solvable &solvable : broken) {
+		if (!zypp_filter_solvable (_filters, solvable))
+			zypp_backend_package (job, PK_INFO_ENUM_REMOVING, solvable,
+					      make<ResObject>(solvable)->summary ().c_str ());
 	}
+
+	pk_backend_job_set_percentage (job, 100);
 }
 
 /**
@@ -2000,7 +2388,7 @@ backend_depends_on_thread (PkBackendJob *job, GVariant *params, gpointer user_da
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -2011,100 +2399,111 @@ backend_depends_on_thread (PkBackendJob *job, GVariant *params, gpointer user_da
 
 	try
 	{
-		sat::Solvable solvable = zypp_get_package_by_id(package_ids[0]);
-		
-		pk_backend_job_set_percentage (job, 20);
+		// packages whose requirements are looked at, and the ones still to do
+		unordered_set<sat::detail::IdType> visited;
+		vector<sat::Solvable> queue;
 
-		if (zypp_is_no_solvable(solvable)) {
-			zypp_backend_finished_error (
-				job, PK_ERROR_ENUM_DEP_RESOLUTION_FAILED,
-				"Did not find the specified package.");
-			return;
+		for (uint i = 0; package_ids[i]; i++) {
+			sat::Solvable solvable = zypp_get_package_by_id(package_ids[i]);
+
+			if (zypp_is_no_solvable(solvable)) {
+				zypp_backend_finished_error (
+					job, PK_ERROR_ENUM_DEP_RESOLUTION_FAILED,
+					"Did not find the specified package.");
+				return;
+			}
+			if (visited.insert (solvable.id ()).second)
+				queue.push_back (solvable);
 		}
+		const unordered_set<sat::detail::IdType> requested (visited);
+
+		pk_backend_job_set_percentage (job, 20);
 
 		// Gather up any dependencies
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DEP_RESOLVE);
 		pk_backend_job_set_percentage (job, 60);
 
-		// get dependencies
-		Capabilities req = solvable[Dep::REQUIRES];
-
-		// which package each capability
-		map<string, sat::Solvable> caps;
+		// capabilities already looked at
+		unordered_set<sat::detail::IdType> caps;
 		// packages already providing a capability
-		vector<string> pkg_names;
+		unordered_set<string> pkg_names;
+		vector<sat::Solvable> deps;
 
-		for (Capabilities::const_iterator cap = req.begin (); cap != req.end (); ++cap) {
-			g_debug ("depends_on - capability '%s'", cap->asString().c_str());
+		for (size_t i = 0; i < queue.size (); i++) {
+			// get dependencies
+			Capabilities req = queue[i][Dep::REQUIRES];
 
-			if (caps.find (cap->asString ()) != caps.end()) {
-				g_debug ("Interesting ! already have capability '%s'", cap->asString().c_str());
-				continue;
-			}
+			for (Capabilities::const_iterator cap = req.begin (); cap != req.end (); ++cap) {
+				if (!caps.insert (cap->id ()).second)
+					continue;
 
-			// Look for packages providing each capability
-			bool have_preference = false;
-			sat::Solvable preferred;
+				g_debug ("depends_on - capability '%s'", cap->asString().c_str());
 
-			sat::WhatProvides prov_list (*cap);
-			for (sat::WhatProvides::const_iterator provider = prov_list.begin ();
-			     provider != prov_list.end (); provider++) {
+				// Look for packages providing each capability
+				bool have_preference = false;
+				sat::Solvable preferred;
 
-				g_debug ("provider: '%s'", provider->asString().c_str());
+				sat::WhatProvides prov_list (*cap);
+				for (sat::WhatProvides::const_iterator provider = prov_list.begin ();
+				     provider != prov_list.end (); provider++) {
 
-				// filter out caps like "rpmlib(PayloadFilesHavePrefix) <= 4.0-1" (bnc#372429)
-				if (zypp_is_no_solvable (*provider))
-					continue;
+					g_debug ("provider: '%s'", provider->asString().c_str());
 
-				// Is this capability provided by a package we already have listed ?
-				if (find (pkg_names.begin (), pkg_names.end(),
-					       provider->name ()) != pkg_names.end()) {
-					preferred = *provider;
-					have_preference = true;
-					break;
-				}
+					// filter out caps like "rpmlib(PayloadFilesHavePrefix) <= 4.0-1" (bnc#372429)
+					if (zypp_is_no_solvable (*provider))
+						continue;
+
+					// Is this capability provided by a package we already have listed ?
+					if (pkg_names.find (provider->name ()) != pkg_names.end ()) {
+						preferred = *provider;
+						have_preference = true;
+						break;
+					}
 
-				// Something is better than nothing
-				if (!have_preference) {
-					preferred = *provider;
-					have_preference = true;
+					// Something is better than nothing
+					if (!have_preference) {
+						preferred = *provider;
+						have_preference = true;
 
-				// Prefer system packages
-				} else if (provider->isSystem()) {
-					preferred = *provider;
-					break;
+					// Prefer system packages
+					} else if (provider->isSystem()) {
+						preferred = *provider;
+						break;
 
-				} // else keep our first love
-			}
+					} // else keep our first love
+				}
+
+				if (!have_preference || !pkg_names.insert (preferred.name ()).second)
+					continue;
 
-			if (have_preference &&
-			    find (pkg_names.begin (), pkg_names.end(),
-				       preferred.name ()) == pkg_names.end()) {
-				caps[cap->asString()] = preferred;
-				pkg_names.push_back (preferred.name ());
+				deps.push_back (preferred);
+				if (recursive && visited.insert (preferred.id ()).second)
+					queue.push_back (preferred);
 			}
 		}
 
 		// print dependencies
-		for (map<string, sat::Solvable>::iterator it = caps.begin ();
-		     it != caps.end();
-		     ++it) {
+		for (const sat::Solvable &dep : deps) {
 			
 			// backup sanity check for no-solvables
-			if (! it->second.name ().c_str() ||
-			    it->second.name ().c_str()[0] == '\0')
+			if (! dep.name ().c_str() ||
+			    dep.name ().c_str()[0] == '\0')
+				continue;
+
+			// the requested packages are not their own dependencies
+			if (requested.find (dep.id ()) != requested.end ())
 				continue;
 			
-			PoolItem item(it->second);
-			PkInfoEnum info = it->second.isSystem () ? PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_AVAILABLE;
+			PoolItem item(dep);
+			PkInfoEnum info = dep.isSystem () ? PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_AVAILABLE;
 
-			g_debug ("add dep - '%s' '%s' %d [%s]", it->second.name().c_str(),
+			g_debug ("add dep - '%s' '%s' %d [%s]", dep.name().c_str(),
 				 info == PK_INFO_ENUM_INSTALLED ? "installed" : "available",
-				 it->second.isSystem(),
-				 zypp_filter_solvable (_filters, it->second) ? "don't add" : "add" );
+				 dep.isSystem(),
+				 zypp_filter_solvable (_filters, dep) ? "don't add" : "add" );
 
-			if (!zypp_filter_solvable (_filters, it->second)) {
-				zypp_backend_package (job, info, it->second,
+			if (!zypp_filter_solvable (_filters, dep)) {
+				zypp_backend_package (job, info, dep,
 						      item->summary ().c_str());
 			}
 		}
@@ -2136,7 +2535,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	g_variant_get (params, "(^a&s)",
 		       &package_ids);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -2210,7 +2609,7 @@ static void
 backend_get_details_local_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	ZyppJob zjob(job);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
@@ -2269,7 +2668,7 @@ static void
 backend_get_files_local_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	ZyppJob zjob(job);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
@@ -2340,8 +2739,8 @@ backend_get_distro_upgrades_thread(PkBackendJob *job, GVariant *params, gpointer
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	// refresh the repos before checking for updates
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
+	// use the metadata as last refreshed by RefreshCache
+	if (!zypp_load_pool (job, zypp)) {
 		return;
 	}
 
@@ -2447,8 +2846,8 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	// refresh the repos before checking for updates
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
+	// use the metadata as last refreshed by RefreshCache
+	if (!zypp_load_pool (job, zypp)) {
 		return;
 	}
 
@@ -2506,7 +2905,7 @@ static void
 backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	ZyppJob zjob(job);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
@@ -2613,7 +3012,7 @@ static void
 backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	gchar **package_ids;
@@ -2914,7 +3313,7 @@ backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	target = zypp->target ();
 
 	// Load all the local system "resolvables" (packages)
-	target->load ();
+	zypp_load_target (target);
 	pk_backend_job_set_percentage (job, 10);
 
 	PoolStatusSaver saver;
@@ -2981,7 +3380,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 		      &_filters,
 		      &search);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 	
 	if (zypp == NULL){
@@ -3074,7 +3473,6 @@ static void
 backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	const gchar *search;
 	PkRoleEnum role;
 
 	PkBitfield _filters;
@@ -3083,19 +3481,13 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		&_filters,
 		&values);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 	
 	if (zypp == NULL){
 		return;
 	}
 
-	// refresh the repos before searching
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
-		return;
-	}
-
-	search = values[0];  //Fixme - support the possible multiple values (logical OR search)
 	role = pk_backend_job_get_role(job);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -3103,8 +3495,11 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	vector<sat::Solvable> v;
 
+	// a package matches if any of the values matches any of the
+	// attributes below; each solvable is only returned once
 	PoolQuery q;
-	q.addString( search ); // may be called multiple times (OR'ed)
+	for (guint i = 0; values[i] != NULL; i++)
+		q.addString( values[i] );
 	q.setCaseSensitive( false ); // [<>] We want to be case insensitive for the name and description searches...
 	q.setMatchSubstring();
 
@@ -3173,7 +3568,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 		&_filters,
 		&search);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -3240,7 +3635,7 @@ pk_backend_get_repo_list (PkBackend *backend, PkBackendJob *job, PkBitfield filt
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	list <RepoInfo> repos;
 	try
 	{
@@ -3284,7 +3679,7 @@ pk_backend_repo_enable (PkBackend *backend, PkBackendJob *job, const gchar *rid,
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	RepoInfo repo;
 
 	try {
@@ -3389,7 +3784,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	g_variant_get (params, "(t)",
 		       &_filters);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, TRUE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -3543,7 +3938,7 @@ backend_repo_set_data_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	RepoManager manager;
+	RepoManager manager (RepoManagerOptions (priv->root));
 	RepoInfo repo;
 
 	try {
@@ -3692,7 +4087,8 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 		      &_filters,
 		      &values);
 	
-	ZyppJob zjob(job);
+	// looking for drivers runs the resolver
+	ZyppJob zjob(job, g_ascii_strcasecmp ("drivers_for_attached_hardware", values[0]) != 0);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
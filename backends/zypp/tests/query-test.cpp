@@ -0,0 +1,210 @@
+/* query-test.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <pk-backend.h>
+#include <pk-backend-job.h>
+
+#define N_ROUNDS	4
+
+typedef struct {
+	PkRoleEnum	 role;
+	const gchar	*value;
+	guint		 expected;
+	guint		 packages;
+	PkExitEnum	 exit;
+} QueryResult;
+
+static GKeyFile *conf;
+static PkBackend *backend;
+static GMainLoop *loop;
+static guint running;
+
+static void
+package_cb (PkBackendJob *job, PkPackage *package, QueryResult *result)
+{
+	result->packages++;
+}
+
+static void
+finished_cb (PkBackendJob *job, gpointer exit, QueryResult *result)
+{
+	result->exit = (PkExitEnum) GPOINTER_TO_UINT (exit);
+	if (--running == 0)
+		g_main_loop_quit (loop);
+}
+
+/* like the daemon runs a transaction */
+static PkBackendJob *
+query_new (QueryResult *result)
+{
+	gchar *values[] = { (gchar *) result->value, NULL };
+	PkBackendJob *job = pk_backend_job_new (conf);
+
+	pk_backend_start_job (backend, job);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (package_cb), result);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (finished_cb), result);
+	result->exit = PK_EXIT_ENUM_UNKNOWN;
+	running++;
+
+	switch (result->role) {
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+		pk_backend_refresh_cache (backend, job, TRUE);
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		pk_backend_search_names (backend, job, 0, values);
+		break;
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		pk_backend_what_provides (backend, job, 0, values);
+		break;
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_backend_resolve (backend, job, 0, values);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+	return job;
+}
+
+static void
+test_query (void)
+{
+	QueryResult results[N_ROUNDS * 3];
+	PkBackendJob *jobs[N_ROUNDS * 3];
+	guint i;
+
+	/* queries of different kinds queued at once, which the zypp lock runs
+	 * one after the other; each must still see the whole pool */
+	for (i = 0; i < G_N_ELEMENTS (results); i++) {
+		QueryResult *result = &results[i];
+		result->packages = 0;
+		switch (i % 3) {
+		case 0:
+			/* pk-fixture-alpha, pk-fixture-beta and pk-fixture-gamma */
+			result->role = PK_ROLE_ENUM_SEARCH_NAME;
+			result->value = "fixture";
+			result->expected = 3;
+			break;
+		case 1:
+			result->role = PK_ROLE_ENUM_WHAT_PROVIDES;
+			result->value = "pk-fixture(capability)";
+			result->expected = 1;
+			break;
+		default:
+			result->role = PK_ROLE_ENUM_RESOLVE;
+			result->value = "pk-fixture-beta";
+			result->expected = 1;
+			break;
+		}
+		jobs[i] = query_new (result);
+	}
+	g_main_loop_run (loop);
+
+	for (i = 0; i < G_N_ELEMENTS (results); i++) {
+		g_assert_cmpint (results[i].exit, ==, PK_EXIT_ENUM_SUCCESS);
+		g_assert_cmpuint (results[i].packages, ==, results[i].expected);
+		pk_backend_stop_job (backend, jobs[i]);
+		g_object_unref (jobs[i]);
+	}
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *child = g_build_filename (path, name, NULL);
+		if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+		    !g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+			remove_tree (child);
+		else
+			g_unlink (child);
+	}
+	g_rmdir (path);
+}
+
+static void
+write_file (const gchar *root, const gchar *name, const gchar *contents)
+{
+	g_autofree gchar *path = g_build_filename (root, name, NULL);
+	g_autofree gchar *dir = g_path_get_dirname (path);
+
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+	g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_autofree gchar *root = NULL;
+	g_autofree gchar *repo = NULL;
+	QueryResult refresh = { PK_ROLE_ENUM_REFRESH_CACHE, NULL, 0, 0, PK_EXIT_ENUM_UNKNOWN };
+	PkBackendJob *job;
+	g_autoptr(GError) error = NULL;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* an empty system, which only knows the fixture repository */
+	root = g_dir_make_tmp ("pk-zypp-test-XXXXXX", NULL);
+	g_assert_nonnull (root);
+	repo = g_strdup_printf ("[pk-fixture]\n"
+				"name=PackageKit fixture\n"
+				"enabled=1\n"
+				"autorefresh=0\n"
+				"baseurl=file://%s\n"
+				"type=rpm-md\n"
+				"gpgcheck=0\n",
+				TESTDATADIR);
+	write_file (root, "etc/zypp/repos.d/pk-fixture.repo", repo);
+	g_setenv ("ZYPP_LOCKFILE_ROOT", root, TRUE);
+
+	/* the module next to this test, see PK_BUILD_LOCAL */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "zypp");
+	g_key_file_set_string (conf, "Daemon", "DestDir", root);
+	backend = pk_backend_new (conf);
+	if (!pk_backend_load (backend, &error))
+		g_error ("failed to load the backend: %s", error->message);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	/* the repository has to be cached before anything can be found */
+	job = query_new (&refresh);
+	g_main_loop_run (loop);
+	g_assert_cmpint (refresh.exit, ==, PK_EXIT_ENUM_SUCCESS);
+	pk_backend_stop_job (backend, job);
+	g_object_unref (job);
+
+	g_test_add_func ("/zypp/query", test_query);
+
+	int ret = g_test_run ();
+	pk_backend_unload (backend);
+	g_main_loop_unref (loop);
+	g_object_unref (backend);
+	g_key_file_unref (conf);
+	remove_tree (root);
+	return ret;
+}
@@ -0,0 +1,107 @@
+/* target-load-benchmark.cpp
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+
+#include <pk-backend.h>
+#include <pk-backend-job.h>
+
+/* the installed packages only mean something on a real system, so this
+ * runs read-only queries against the root given on the command line (or
+ * the running system), as root to be able to use its caches */
+#define N_ROUNDS	10
+
+static GKeyFile *conf;
+static PkBackend *backend;
+static GMainLoop *loop;
+
+static void
+package_cb (PkBackendJob *job, PkPackage *package, guint *found)
+{
+	(*found)++;
+}
+
+static void
+finished_cb (PkBackendJob *job, gpointer exit, PkExitEnum *result)
+{
+	*result = (PkExitEnum) GPOINTER_TO_UINT (exit);
+	g_main_loop_quit (loop);
+}
+
+/* like the daemon runs a transaction, returns the time until it finished */
+static gdouble
+resolve (const gchar *name, guint *found)
+{
+	gchar *values[] = { (gchar *) name, NULL };
+	PkBackendJob *job = pk_backend_job_new (conf);
+	PkExitEnum exit = PK_EXIT_ENUM_UNKNOWN;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	*found = 0;
+	pk_backend_start_job (backend, job);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (package_cb), found);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (finished_cb), &exit);
+	pk_backend_resolve (backend, job, pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), values);
+	g_main_loop_run (loop);
+	g_assert_cmpint (exit, ==, PK_EXIT_ENUM_SUCCESS);
+	pk_backend_stop_job (backend, job);
+	g_object_unref (job);
+	return g_timer_elapsed (timer, NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+	const gchar *root = argc > 1 ? argv[1] : "/";
+	g_autoptr(GError) error = NULL;
+	gdouble elapsed;
+	gdouble total = 0;
+	guint found;
+
+	/* the module next to this benchmark, see PK_BUILD_LOCAL */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "zypp");
+	g_key_file_set_string (conf, "Daemon", "DestDir", root);
+	backend = pk_backend_new (conf);
+	if (!pk_backend_load (backend, &error))
+		g_error ("failed to load the backend: %s", error->message);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	/* the first query builds the pool: the repositories and the target */
+	elapsed = resolve ("rpm", &found);
+	g_print ("Resolve rpm, cold: %u packages in %.3f s\n", found, elapsed);
+
+	/* the rpmdb did not change, so these reuse the installed packages;
+	 * before the pool was keyed on the rpmdb, each one loaded the target */
+	for (guint i = 0; i < N_ROUNDS; i++) {
+		total += resolve ("rpm", &found);
+		g_assert_cmpuint (found, >, 0);
+	}
+	g_print ("Resolve rpm, warm: %.3f s on average over %u runs\n", total / N_ROUNDS, N_ROUNDS);
+
+	pk_backend_unload (backend);
+	g_main_loop_unref (loop);
+	g_object_unref (backend);
+	g_key_file_unref (conf);
+	return 0;
+}
@@ -60,6 +60,8 @@ struct _PkClientPrivate
 {
 	GDBusConnection		*connection;
 	GPtrArray		*calls;
+	GPtrArray		*subscriptions;
+	GHashTable		*tids;		/* tid → GPtrArray of PkClientState */
 	PkControl		*control;
 	gchar			*locale;
 	gboolean		 background;
@@ -80,6 +82,19 @@ enum {
 
 G_DEFINE_TYPE (PkClient, pk_client, G_TYPE_OBJECT)
 
+/*
+ * PkClientSubscription:
+ *
+ * A signal subscription on the shared connection, one per main context so
+ * that the sync helpers running their own loop still get the signals.
+ **/
+typedef struct {
+	PkClient			*client;
+	GMainContext			*context;
+	guint				 subscription_id;
+	guint				 refcount;
+} PkClientSubscription;
+
 typedef struct {
 	gboolean			 allow_deps;
 	gboolean			 autoremove;
@@ -105,8 +120,7 @@ typedef struct {
 	gpointer			 user_data;
 	guint				 number;
 	gulong				 cancellable_id;
-	GDBusProxy			*proxy;
-	GDBusProxy			*proxy_props;
+	PkClientSubscription		*subscription;
 	GCancellable			*cancellable;
 	GCancellable			*cancellable_client;
 	GSimpleAsyncResult		*res;
@@ -122,17 +136,6 @@ typedef struct {
 	PkClientHelper			*client_helper;
 } PkClientState;
 
-static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
-				 gpointer user_data);
-static void
-pk_client_signal_cb (GDBusProxy *proxy,
-		     const gchar *sender_name,
-		     const gchar *signal_name,
-		     GVariant *parameters,
-		     gpointer user_data);
 
 /**
  * pk_client_error_quark:
@@ -561,12 +564,12 @@ pk_client_cancel_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* there's not really a lot we can do here */
 		g_warning ("failed to cancel: %s", error->message);
@@ -581,19 +584,50 @@ static void
 pk_client_cancellable_cancel_cb (GCancellable *cancellable, PkClientState *state)
 {
 	/* dbus method has not yet fired */
-	if (state->proxy == NULL) {
-		g_debug ("Cancelled, but no proxy, not sure what to do here");
+	if (state->subscription == NULL) {
+		g_debug ("Cancelled, but not connected, not sure what to do here");
 		return;
 	}
 
 	/* takeover the call with the cancel method */
 	g_debug ("cancelling %s", state->tid);
-	g_dbus_proxy_call (state->proxy, "Cancel",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   NULL,
-			   pk_client_cancel_cb, NULL);
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				"Cancel",
+				NULL,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				NULL,
+				pk_client_cancel_cb, NULL);
+}
+
+/*
+ * pk_client_call:
+ *
+ * Calls a method on the transaction object directly on the shared
+ * connection, without setting up a proxy and its property cache first.
+ **/
+static void
+pk_client_call (PkClientState *state,
+		const gchar *method_name,
+		GVariant *parameters,
+		GAsyncReadyCallback callback)
+{
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				method_name,
+				parameters,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				state);
 }
 
 /*
@@ -631,6 +665,38 @@ pk_client_state_add (PkClient *client, PkClientState *state)
 	}
 }
 
+/*
+ * pk_client_state_disconnect:
+ **/
+static void
+pk_client_state_disconnect (PkClientState *state)
+{
+	PkClientPrivate *priv = state->client->priv;
+	PkClientSubscription *subscription = state->subscription;
+
+	GPtrArray *states;
+
+	if (subscription == NULL)
+		return;
+	states = g_hash_table_lookup (priv->tids, state->tid);
+	if (states != NULL) {
+		g_ptr_array_remove (states, state);
+		if (states->len == 0)
+			g_hash_table_remove (priv->tids, state->tid);
+	}
+	state->subscription = NULL;
+
+	/* keep the subscription for the default context around, but drop
+	 * the ones for the short-lived contexts used by the sync helpers */
+	if (--subscription->refcount > 0)
+		return;
+	if (subscription->context == g_main_context_default ())
+		return;
+	g_dbus_connection_signal_unsubscribe (priv->connection,
+					      subscription->subscription_id);
+	g_ptr_array_remove (priv->subscriptions, subscription);
+}
+
 /*
  * pk_client_state_finish:
  **/
@@ -655,18 +721,8 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	if (state->cancellable != NULL)
 		g_object_unref (state->cancellable);
 
-	if (state->proxy != NULL) {
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_properties_changed_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_signal_cb),
-						      state);
-		g_object_unref (G_OBJECT (state->proxy));
-	}
-
-	if (state->proxy_props != NULL)
-		g_object_unref (G_OBJECT (state->proxy_props));
+	/* stop routing signals to this state */
+	pk_client_state_disconnect (state);
 
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
@@ -713,18 +769,15 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 }
 
 /*
- * pk_client_properties_changed_cb:
+ * pk_client_properties_changed:
  **/
 static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
-				 gpointer user_data)
+pk_client_properties_changed (PkClientState *state,
+			      GVariant *changed_properties)
 {
 	const gchar *key;
 	GVariantIter *iter;
 	GVariant *value;
-	PkClientState *state = (PkClientState *) user_data;
 
 	if (g_variant_n_children (changed_properties) > 0) {
 		g_variant_get (changed_properties,
@@ -1038,16 +1091,13 @@ pk_client_signal_finished (PkClientState *state,
 }
 
 /*
- * pk_client_signal_cb:
+ * pk_client_signal:
  **/
 static void
-pk_client_signal_cb (GDBusProxy *proxy,
-		     const gchar *sender_name,
-		     const gchar *signal_name,
-		     GVariant *parameters,
-		     gpointer user_data)
+pk_client_signal (PkClientState *state,
+		  const gchar *signal_name,
+		  GVariant *parameters)
 {
-	PkClientState *state = (PkClientState *) user_data;
 	gchar *tmp_str[12];
 	gchar **tmp_strv[5];
 	gboolean tmp_bool;
@@ -1390,32 +1440,136 @@ pk_client_signal_cb (GDBusProxy *proxy,
 }
 
 /*
- * pk_client_proxy_connect:
+ * pk_client_connection_signal_cb:
+ *
+ * Demultiplexes the signals of all the transactions by object path.
  **/
 static void
-pk_client_proxy_connect (PkClientState *state)
+pk_client_connection_signal_cb (GDBusConnection *connection,
+				const gchar *sender_name,
+				const gchar *object_path,
+				const gchar *interface_name,
+				const gchar *signal_name,
+				GVariant *parameters,
+				gpointer user_data)
 {
+	PkClientSubscription *subscription = (PkClientSubscription *) user_data;
+	GPtrArray *states;
+	const gchar *interface_tmp = NULL;
 	guint i;
-	g_auto(GStrv) props = NULL;
+	g_autoptr(GPtrArray) states_tmp = NULL;
+	g_autoptr(GVariant) changed_properties = NULL;
 
-	/* coldplug properties */
-	props = g_dbus_proxy_get_cached_property_names (state->proxy);
-	for (i = 0; props != NULL && props[i] != NULL; i++) {
-		g_autoptr(GVariant) value_tmp = NULL;
-		value_tmp = g_dbus_proxy_get_cached_property (state->proxy,
-							      props[i]);
-		pk_client_set_property_value (state,
-					      props[i],
-					      value_tmp);
-	}
-
-	/* connect up signals */
-	g_signal_connect (state->proxy, "g-properties-changed",
-			  G_CALLBACK (pk_client_properties_changed_cb),
-			  state);
-	g_signal_connect (state->proxy, "g-signal",
-			  G_CALLBACK (pk_client_signal_cb),
-			  state);
+	/* not one of ours */
+	states = g_hash_table_lookup (subscription->client->priv->tids, object_path);
+	if (states == NULL)
+		return;
+
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties") == 0 &&
+	    g_strcmp0 (signal_name, "PropertiesChanged") == 0) {
+		g_variant_get (parameters, "(&s@a{sv}^a&s)",
+			       &interface_tmp, &changed_properties, NULL);
+	}
+
+	/* the same transaction may be watched more than once, and
+	 * ::Finished() removes the state from the list */
+	states_tmp = g_ptr_array_sized_new (states->len);
+	for (i = 0; i < states->len; i++) {
+		PkClientState *state = g_ptr_array_index (states, i);
+		/* owned by another main context */
+		if (state->subscription == subscription)
+			g_ptr_array_add (states_tmp, state);
+	}
+	for (i = 0; i < states_tmp->len; i++) {
+		PkClientState *state = g_ptr_array_index (states_tmp, i);
+		if (g_strcmp0 (interface_name, PK_DBUS_INTERFACE_TRANSACTION) == 0)
+			pk_client_signal (state, signal_name, parameters);
+		else if (g_strcmp0 (interface_tmp, PK_DBUS_INTERFACE_TRANSACTION) == 0)
+			pk_client_properties_changed (state, changed_properties);
+	}
+}
+
+/*
+ * pk_client_subscription_free:
+ **/
+static void
+pk_client_subscription_free (PkClientSubscription *subscription)
+{
+	g_main_context_unref (subscription->context);
+	g_slice_free (PkClientSubscription, subscription);
+}
+
+/*
+ * pk_client_state_connect:
+ *
+ * Routes the signals for the transaction to @state, subscribing to the
+ * daemon signals for the current main context if not already done.
+ **/
+static void
+pk_client_state_connect (PkClientState *state)
+{
+	PkClientPrivate *priv = state->client->priv;
+	PkClientSubscription *subscription = NULL;
+	GPtrArray *states;
+	guint i;
+	g_autoptr(GMainContext) context = NULL;
+
+	context = g_main_context_ref_thread_default ();
+	for (i = 0; i < priv->subscriptions->len; i++) {
+		PkClientSubscription *tmp = g_ptr_array_index (priv->subscriptions, i);
+		if (tmp->context == context) {
+			subscription = tmp;
+			break;
+		}
+	}
+	if (subscription == NULL) {
+		subscription = g_slice_new0 (PkClientSubscription);
+		subscription->client = state->client;
+		subscription->context = g_main_context_ref (context);
+		subscription->subscription_id =
+			g_dbus_connection_signal_subscribe (priv->connection,
+							    PK_DBUS_SERVICE,
+							    NULL,
+							    NULL,
+							    NULL,
+							    NULL,
+							    G_DBUS_SIGNAL_FLAGS_NONE,
+							    pk_client_connection_signal_cb,
+							    subscription,
+							    NULL);
+		g_ptr_array_add (priv->subscriptions, subscription);
+	}
+	subscription->refcount++;
+	state->subscription = subscription;
+	states = g_hash_table_lookup (priv->tids, state->tid);
+	if (states == NULL) {
+		states = g_ptr_array_new ();
+		g_hash_table_insert (priv->tids, g_strdup (state->tid), states);
+	}
+	g_ptr_array_add (states, state);
+}
+
+/*
+ * pk_client_get_all:
+ *
+ * Gets the current property values, as the daemon only signals changes
+ * and never does for some of them, e.g. Uid.
+ **/
+static void
+pk_client_get_all (PkClientState *state, GAsyncReadyCallback callback)
+{
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				"org.freedesktop.DBus.Properties",
+				"GetAll",
+				g_variant_new ("(s)", PK_DBUS_INTERFACE_TRANSACTION),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				state);
 }
 
 /*
@@ -1426,13 +1580,13 @@ pk_client_method_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	PkClientState *state = (PkClientState *) user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1469,13 +1623,13 @@ pk_client_set_hints_cb (GObject *source_object,
 			GAsyncResult *res,
 			gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	PkClientState *state = (PkClientState *) user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1493,357 +1647,229 @@ pk_client_set_hints_cb (GObject *source_object,
 
 	/* do this async, although this should be pretty fast anyway */
 	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "Resolve",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "SearchNames",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->search),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "SearchDetails",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->search),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "SearchGroups",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->search),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "SearchFiles",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->search),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetDetails",
+				g_variant_new ("(^a&s)",
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetDetailsLocal",
+				g_variant_new ("(^a&s)",
+					       state->files),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetFilesLocal",
+				g_variant_new ("(^a&s)",
+					       state->files),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetUpdateDetail",
+				g_variant_new ("(^a&s)",
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetOldTransactions",
+				g_variant_new ("(u)",
+					       state->number),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "DownloadPackages",
+				g_variant_new ("(b^a&s)",
+					       (state->directory == NULL),
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetUpdates",
+				g_variant_new ("(t)",
+					       state->filters),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "DependsOn",
+				g_variant_new ("(t^a&sb)",
+					       state->filters,
+					       state->package_ids,
+					       state->recursive),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 
 	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RequiredBy",
+				g_variant_new ("(t^a&sb)",
+					       state->filters,
+					       state->package_ids,
+					       state->recursive),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetPackages",
+				g_variant_new ("(t)",
+					       state->filters),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "WhatProvides",
+				g_variant_new ("(t^a&s)",
+					       state->filters,
+					       state->search),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetDistroUpgrades",
+				NULL,
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetFiles",
+				g_variant_new ("(^a&s)",
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetCategories",
+				NULL,
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RemovePackages",
+				g_variant_new ("(t^a&sbb)",
+					       state->transaction_flags,
+					       state->package_ids,
+					       state->allow_deps,
+					       state->autoremove),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RefreshCache",
+				g_variant_new ("(b)",
+					       state->force),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "InstallPackages",
+				g_variant_new ("(t^a&s)",
+					       state->transaction_flags,
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "InstallSignature",
+				g_variant_new ("(uss)",
+					       state->type,
+					       state->key_id,
+					       state->package_id),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "UpdatePackages",
+				g_variant_new ("(t^a&s)",
+					       state->transaction_flags,
+					       state->package_ids),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "InstallFiles",
+				g_variant_new ("(t^a&s)",
+					       state->transaction_flags,
+					       state->files),
+				pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "AcceptEula",
+				g_variant_new ("(s)",
+					       state->eula_id),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "GetRepoList",
+				g_variant_new ("(t)",
+					       state->filters),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RepoEnable",
+				g_variant_new ("(sb)",
+					       state->repo_id,
+					       state->enabled),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RepoSetData",
+				g_variant_new ("(sss)",
+					       state->repo_id,
+					       state->parameter ? state->parameter : "",
+					       state->value ? state->value : ""),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RepoRemove",
+				g_variant_new ("(tsb)",
+					       state->transaction_flags,
+					       state->repo_id,
+					       state->autoremove),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "UpgradeSystem",
-				   g_variant_new ("(tsu)",
-						  state->transaction_flags,
-						  state->distro_id,
-						  state->upgrade_kind),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "UpgradeSystem",
+				g_variant_new ("(tsu)",
+					       state->transaction_flags,
+					       state->distro_id,
+					       state->upgrade_kind),
+				pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_call (state, "RepairSystem",
+				g_variant_new ("(t)",
+					       state->transaction_flags),
+				pk_client_method_cb);
 	} else {
 		g_assert_not_reached ();
 	}
@@ -2002,24 +2028,57 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /*
- * pk_client_get_proxy_cb:
+ * pk_client_set_connection:
  **/
 static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+pk_client_set_connection (PkClient *client, GDBusConnection *connection)
 {
-	gchar *hint;
+	if (client->priv->connection != NULL)
+		return;
+	client->priv->connection = g_object_ref (connection);
+}
+
+/*
+ * pk_client_coldplug_cb:
+ **/
+static void
+pk_client_coldplug_cb (GObject *source_object,
+		       GAsyncResult *res,
+		       gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	PkClientState *state = (PkClientState *) user_data;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GVariant) properties = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* any real problem is reported by the method calls, which may
+	 * already have finished the state when cancelled */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to get the transaction properties: %s", error->message);
+		return;
+	}
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
+	/* the reply comes before that of the method call, so the state
+	 * cannot have seen ::Finished() yet */
+	properties = g_variant_get_child_value (value, 0);
+	pk_client_properties_changed (state, properties);
+}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+/*
+ * pk_client_set_hints:
+ **/
+static void
+pk_client_set_hints (PkClientState *state)
+{
+	gchar *hint;
+	g_autoptr(GPtrArray) array = NULL;
+
+	/* connect, and coldplug the properties while setting the hints */
+	pk_client_state_connect (state);
+	pk_client_get_all (state, pk_client_coldplug_cb);
 
 	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
@@ -2059,19 +2118,36 @@ pk_client_get_proxy_cb (GObject *object,
 
 	/* set hints */
 	g_ptr_array_add (array, NULL);
-	g_dbus_proxy_call (state->proxy, "SetHints",
-			   g_variant_new ("(^a&s)",
-					  array->pdata),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   state->cancellable,
-			   pk_client_set_hints_cb,
-			   state);
+	pk_client_call (state, "SetHints",
+			g_variant_new ("(^a&s)",
+				       array->pdata),
+			pk_client_set_hints_cb);
 
 	/* track state */
 	g_ptr_array_add (state->client->priv->calls, state);
 }
 
+/*
+ * pk_client_bus_get_cb:
+ **/
+static void
+pk_client_bus_get_cb (GObject *object,
+		      GAsyncResult *res,
+		      gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	pk_client_set_connection (state->client, connection);
+	pk_client_set_hints (state);
+}
+
 /*
  * pk_client_get_tid_cb:
  **/
@@ -2089,16 +2165,17 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_proxy_cb,
-				  state);
+	/* skip straight to the D-Bus method if already connected */
+	if (state->client->priv->connection != NULL) {
+		pk_client_set_hints (state);
+		return;
+	}
+
+	/* get the shared connection used for all the transactions */
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_bus_get_cb,
+		   state);
 }
 
 /**
@@ -4399,24 +4476,61 @@ pk_client_repair_system_async (PkClient *client,
 /**********************************************************************/
 
 /*
- * pk_client_adopt_get_proxy_cb:
+ * pk_client_adopt_get_all_cb:
  **/
 static void
-pk_client_adopt_get_proxy_cb (GObject *object,
-			      GAsyncResult *res,
-			      gpointer user_data)
+pk_client_adopt_get_all_cb (GObject *source_object,
+			    GAsyncResult *res,
+			    gpointer user_data)
 {
-	g_autoptr(GError) error = NULL;
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) properties = NULL;
+	g_autoptr(GVariant) value = NULL;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	/* get the result */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		pk_client_fixup_dbus_error (error);
 		pk_client_state_finish (state, error);
 		return;
 	}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* coldplug properties, then wait for ::Finished() */
+	properties = g_variant_get_child_value (value, 0);
+	pk_client_properties_changed (state, properties);
+}
+
+/*
+ * pk_client_adopt_connected:
+ **/
+static void
+pk_client_adopt_connected (PkClientState *state)
+{
+	pk_client_state_connect (state);
+	pk_client_get_all (state, pk_client_adopt_get_all_cb);
+}
+
+/*
+ * pk_client_adopt_bus_get_cb:
+ **/
+static void
+pk_client_adopt_bus_get_cb (GObject *object,
+			    GAsyncResult *res,
+			    gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	pk_client_set_connection (state->client, connection);
+	pk_client_adopt_connected (state);
 }
 
 /**
@@ -4486,19 +4600,20 @@ pk_client_adopt_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_adopt_get_proxy_cb,
-				  state);
-
 	/* track state */
 	pk_client_state_add (client, state);
+
+	/* skip straight to the D-Bus method if already connected */
+	if (client->priv->connection != NULL) {
+		pk_client_adopt_connected (state);
+		return;
+	}
+
+	/* get the shared connection used for all the transactions */
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_adopt_bus_get_cb,
+		   state);
 }
 
 /**********************************************************************/
@@ -4544,18 +4659,8 @@ pk_client_get_progress_state_finish (PkClientState *state, const GError *error)
 	if (state->cancellable != NULL)
 		g_object_unref (state->cancellable);
 
-	if (state->proxy != NULL) {
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_properties_changed_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_signal_cb),
-						      state);
-		g_object_unref (G_OBJECT (state->proxy));
-	}
-
-	if (state->proxy_props != NULL)
-		g_object_unref (G_OBJECT (state->proxy_props));
+	/* stop routing signals to this state */
+	pk_client_state_disconnect (state);
 
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
@@ -4587,22 +4692,49 @@ pk_client_get_progress_cb (GObject *source_object,
 			   GAsyncResult *res,
 			   gpointer user_data)
 {
-	g_autoptr(GError) error = NULL;
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) properties = NULL;
+	g_autoptr(GVariant) value = NULL;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	/* get the result */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		pk_client_fixup_dbus_error (error);
 		pk_client_get_progress_state_finish (state, error);
 		return;
 	}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* coldplug properties */
+	properties = g_variant_get_child_value (value, 0);
+	pk_client_properties_changed (state, properties);
 
 	state->ret = TRUE;
 	pk_client_get_progress_state_finish (state, NULL);
 }
 
+/*
+ * pk_client_get_progress_bus_get_cb:
+ **/
+static void
+pk_client_get_progress_bus_get_cb (GObject *object,
+				   GAsyncResult *res,
+				   gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_get_progress_state_finish (state, error);
+		return;
+	}
+	pk_client_set_connection (state->client, connection);
+	pk_client_get_all (state, pk_client_get_progress_cb);
+}
+
 /**
  * pk_client_get_progress_async:
  * @client: a valid #PkClient instance
@@ -4657,19 +4789,20 @@ pk_client_get_progress_async (PkClient *client,
 	/* identify */
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_progress_cb,
-				  state);
-
 	/* track state */
 	pk_client_state_add (client, state);
+
+	/* skip straight to the D-Bus method if already connected */
+	if (client->priv->connection != NULL) {
+		pk_client_get_all (state, pk_client_get_progress_cb);
+		return;
+	}
+
+	/* get the shared connection used for all the transactions */
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_get_progress_bus_get_cb,
+		   state);
 }
 
 /**********************************************************************/
@@ -4688,7 +4821,7 @@ pk_client_cancel_all_dbus_methods (PkClient *client)
 	array = client->priv->calls;
 	for (i = 0; i < array->len; i++) {
 		state = g_ptr_array_index (array, i);
-		if (state->proxy == NULL)
+		if (state->subscription == NULL)
 			continue;
 		g_debug ("cancel in flight call");
 		g_cancellable_cancel (state->cancellable);
@@ -4927,6 +5060,9 @@ pk_client_init (PkClient *client)
 {
 	client->priv = PK_CLIENT_GET_PRIVATE (client);
 	client->priv->calls = g_ptr_array_new ();
+	client->priv->subscriptions = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_client_subscription_free);
+	client->priv->tids = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, (GDestroyNotify) g_ptr_array_unref);
 	client->priv->background = FALSE;
 	client->priv->interactive = TRUE;
 	client->priv->idle = TRUE;
@@ -4947,6 +5083,7 @@ pk_client_finalize (GObject *object)
 {
 	PkClient *client = PK_CLIENT (object);
 	PkClientPrivate *priv = client->priv;
+	guint i;
 
 	/* ensure we cancel any in-flight DBus calls */
 	pk_client_cancel_all_dbus_methods (client);
@@ -4954,6 +5091,15 @@ pk_client_finalize (GObject *object)
 	g_free (client->priv->locale);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
+	for (i = 0; i < priv->subscriptions->len; i++) {
+		PkClientSubscription *subscription = g_ptr_array_index (priv->subscriptions, i);
+		g_dbus_connection_signal_unsubscribe (priv->connection,
+						      subscription->subscription_id);
+	}
+	g_ptr_array_unref (priv->subscriptions);
+	g_hash_table_unref (priv->tids);
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
 
 	G_OBJECT_CLASS (pk_client_parent_class)->finalize (object);
 }
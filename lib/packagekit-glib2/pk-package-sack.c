@@ -30,6 +30,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib-object.h>
 #include <gio/gio.h>
 
@@ -44,6 +45,42 @@ static void     pk_package_sack_finalize	(GObject     *object);
 
 #define PK_PACKAGE_SACK_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PACKAGE_SACK, PkPackageSackPrivate))
 
+#define PK_PACKAGE_SACK_BINARY_MAGIC	"PKSACK\x00\x01"
+#define PK_PACKAGE_SACK_BINARY_VERSION	1
+
+/* the daemon refuses more items than this in one transaction */
+#define PK_PACKAGE_SACK_MAX_ITEMS_PER_TRANSACTION	10000
+
+/*
+ * PkPackageSackBinaryHeader:
+ *
+ * The header of a binary sack file. All values are little endian, and all
+ * the offsets are relative to the start of the file.
+ **/
+typedef struct {
+	gchar			 magic[8];
+	guint32			 version;
+	guint32			 n_records;
+	guint32			 records_offset;
+	guint32			 index_offset;
+	guint32			 arena_offset;
+	guint32			 arena_size;
+} PkPackageSackBinaryHeader;
+
+/*
+ * PkPackageSackBinaryRecord:
+ *
+ * One package in a binary sack file. The strings are offsets into the
+ * string arena, where offset 0 is always the empty string.
+ **/
+typedef struct {
+	guint32			 info;
+	guint32			 package_id;
+	guint32			 name;
+	guint32			 arch;
+	guint32			 summary;
+} PkPackageSackBinaryRecord;
+
 /**
  * PkPackageSackPrivate:
  *
@@ -53,7 +90,14 @@ struct _PkPackageSackPrivate
 {
 	GHashTable		*table;
 	GPtrArray		*array;
+	GHashTable		*name_index;
+	GPtrArray		*info_index[PK_INFO_ENUM_LAST];
+	gboolean		 info_index_dirty;
 	PkClient		*client;
+	GBytes			*binary;
+	PkPackage		**binary_packages;
+	guint			 binary_n_records;
+	guint			 max_transactions;
 };
 
 enum {
@@ -63,6 +107,301 @@ enum {
 
 G_DEFINE_TYPE (PkPackageSack, pk_package_sack, G_TYPE_OBJECT)
 
+/*
+ * pk_package_sack_binary_data:
+ **/
+static const guint8 *
+pk_package_sack_binary_data (PkPackageSack *sack)
+{
+	return g_bytes_get_data (sack->priv->binary, NULL);
+}
+
+/*
+ * pk_package_sack_binary_record:
+ **/
+static const PkPackageSackBinaryRecord *
+pk_package_sack_binary_record (PkPackageSack *sack, guint idx)
+{
+	const guint8 *data = pk_package_sack_binary_data (sack);
+	const PkPackageSackBinaryHeader *header = (const PkPackageSackBinaryHeader *) data;
+	const PkPackageSackBinaryRecord *records;
+
+	records = (const PkPackageSackBinaryRecord *) (data + GUINT32_FROM_LE (header->records_offset));
+	return &records[idx];
+}
+
+/*
+ * pk_package_sack_binary_string:
+ **/
+static const gchar *
+pk_package_sack_binary_string (PkPackageSack *sack, guint32 offset)
+{
+	const guint8 *data = pk_package_sack_binary_data (sack);
+	const PkPackageSackBinaryHeader *header = (const PkPackageSackBinaryHeader *) data;
+
+	return (const gchar *) data + GUINT32_FROM_LE (header->arena_offset) + GUINT32_FROM_LE (offset);
+}
+
+/*
+ * pk_package_sack_binary_index:
+ *
+ * Returns the record at position @i when sorted by name and arch.
+ **/
+static guint
+pk_package_sack_binary_index (PkPackageSack *sack, guint i)
+{
+	const guint8 *data = pk_package_sack_binary_data (sack);
+	const PkPackageSackBinaryHeader *header = (const PkPackageSackBinaryHeader *) data;
+	const guint32 *index;
+
+	index = (const guint32 *) (data + GUINT32_FROM_LE (header->index_offset));
+	return GUINT32_FROM_LE (index[i]);
+}
+
+/*
+ * pk_package_sack_binary_compare:
+ **/
+static gint
+pk_package_sack_binary_compare (PkPackageSack *sack,
+				guint idx,
+				const gchar *name,
+				const gchar *arch)
+{
+	const PkPackageSackBinaryRecord *record;
+	gint rc;
+
+	record = pk_package_sack_binary_record (sack, idx);
+	rc = g_strcmp0 (pk_package_sack_binary_string (sack, record->name), name);
+	if (rc != 0 || arch == NULL)
+		return rc;
+	return g_strcmp0 (pk_package_sack_binary_string (sack, record->arch), arch);
+}
+
+/*
+ * pk_package_sack_binary_lower_bound:
+ *
+ * Finds the first position in the index that sorts at or after @name and
+ * @arch, or only @name if @arch is %NULL.
+ **/
+static guint
+pk_package_sack_binary_lower_bound (PkPackageSack *sack,
+				    const gchar *name,
+				    const gchar *arch)
+{
+	guint lo = 0;
+	guint hi = sack->priv->binary_n_records;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		guint idx = pk_package_sack_binary_index (sack, mid);
+		if (pk_package_sack_binary_compare (sack, idx, name, arch) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * pk_package_sack_binary_get_package:
+ *
+ * Creates the package for a record on first use, so loading a large sack
+ * only costs the packages that are actually looked at.
+ **/
+static PkPackage *
+pk_package_sack_binary_get_package (PkPackageSack *sack, guint idx)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	PkPackage *package;
+	PkInfoEnum info;
+	const PkPackageSackBinaryRecord *record;
+	const gchar *summary;
+
+	if (priv->binary_packages[idx] != NULL)
+		return priv->binary_packages[idx];
+
+	record = pk_package_sack_binary_record (sack, idx);
+	package = pk_package_new ();
+	if (!pk_package_set_id (package,
+				pk_package_sack_binary_string (sack, record->package_id),
+				NULL)) {
+		/* the IDs were checked when the file was loaded */
+		g_assert_not_reached ();
+	}
+	info = GUINT32_FROM_LE (record->info);
+	pk_package_set_info (package, info < PK_INFO_ENUM_LAST ? info : PK_INFO_ENUM_UNKNOWN);
+	summary = pk_package_sack_binary_string (sack, record->summary);
+	if (summary[0] != '\0')
+		pk_package_set_summary (package, summary);
+	priv->binary_packages[idx] = package;
+	return package;
+}
+
+/*
+ * pk_package_sack_binary_free:
+ **/
+static void
+pk_package_sack_binary_free (PkPackageSack *sack)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	guint i;
+
+	if (priv->binary == NULL)
+		return;
+	for (i = 0; i < priv->binary_n_records; i++) {
+		if (priv->binary_packages[i] != NULL)
+			g_object_unref (priv->binary_packages[i]);
+	}
+	g_free (priv->binary_packages);
+	priv->binary_packages = NULL;
+	priv->binary_n_records = 0;
+	g_clear_pointer (&priv->binary, g_bytes_unref);
+}
+
+/*
+ * pk_package_sack_package_notify_info_cb:
+ **/
+static void
+pk_package_sack_package_notify_info_cb (GObject *object,
+					GParamSpec *pspec,
+					gpointer user_data)
+{
+	PkPackageSack *sack = PK_PACKAGE_SACK (user_data);
+
+	/* rebuild the next time it is needed */
+	sack->priv->info_index_dirty = TRUE;
+}
+
+/*
+ * pk_package_sack_index_add:
+ **/
+static void
+pk_package_sack_index_add (PkPackageSack *sack, PkPackage *package)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	PkInfoEnum info;
+	GPtrArray *bucket;
+	const gchar *name;
+
+	name = pk_package_get_name (package);
+	bucket = g_hash_table_lookup (priv->name_index, name);
+	if (bucket == NULL) {
+		bucket = g_ptr_array_new ();
+		g_hash_table_insert (priv->name_index, g_strdup (name), bucket);
+	}
+	g_ptr_array_add (bucket, package);
+
+	info = pk_package_get_info (package);
+	if (!priv->info_index_dirty && info < PK_INFO_ENUM_LAST)
+		g_ptr_array_add (priv->info_index[info], package);
+}
+
+/*
+ * pk_package_sack_index_remove:
+ **/
+static void
+pk_package_sack_index_remove (PkPackageSack *sack, PkPackage *package)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	PkInfoEnum info;
+	GPtrArray *bucket;
+	const gchar *name;
+
+	name = pk_package_get_name (package);
+	bucket = g_hash_table_lookup (priv->name_index, name);
+	if (bucket != NULL) {
+		g_ptr_array_remove (bucket, package);
+		if (bucket->len == 0)
+			g_hash_table_remove (priv->name_index, name);
+	}
+
+	info = pk_package_get_info (package);
+	if (!priv->info_index_dirty && info < PK_INFO_ENUM_LAST)
+		g_ptr_array_remove (priv->info_index[info], package);
+}
+
+/*
+ * pk_package_sack_index_rebuild:
+ *
+ * Recreates the name index in the order of the array, and leaves the info
+ * index to be recreated when next used.
+ **/
+static void
+pk_package_sack_index_rebuild (PkPackageSack *sack)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	guint i;
+
+	g_hash_table_remove_all (priv->name_index);
+	priv->info_index_dirty = TRUE;
+	for (i = 0; i < priv->array->len; i++)
+		pk_package_sack_index_add (sack, g_ptr_array_index (priv->array, i));
+}
+
+/*
+ * pk_package_sack_info_index_ensure:
+ **/
+static void
+pk_package_sack_info_index_ensure (PkPackageSack *sack)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	PkInfoEnum info;
+	PkPackage *package;
+	guint i;
+
+	if (!priv->info_index_dirty)
+		return;
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++)
+		g_ptr_array_set_size (priv->info_index[i], 0);
+	for (i = 0; i < priv->array->len; i++) {
+		package = g_ptr_array_index (priv->array, i);
+		info = pk_package_get_info (package);
+		if (info < PK_INFO_ENUM_LAST)
+			g_ptr_array_add (priv->info_index[info], package);
+	}
+	priv->info_index_dirty = FALSE;
+}
+
+/*
+ * pk_package_sack_disconnect_all:
+ **/
+static void
+pk_package_sack_disconnect_all (PkPackageSack *sack)
+{
+	guint i;
+
+	for (i = 0; i < sack->priv->array->len; i++) {
+		g_signal_handlers_disconnect_by_func (g_ptr_array_index (sack->priv->array, i),
+						      G_CALLBACK (pk_package_sack_package_notify_info_cb),
+						      sack);
+	}
+}
+
+/*
+ * pk_package_sack_ensure_loaded:
+ *
+ * Creates all the packages still pending in a mapped binary sack file, for
+ * the operations that need the whole array.
+ **/
+static void
+pk_package_sack_ensure_loaded (PkPackageSack *sack)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	guint i;
+	g_autoptr(GPtrArray) packages = NULL;
+
+	if (priv->binary == NULL)
+		return;
+	packages = g_ptr_array_new_with_free_func (g_object_unref);
+	for (i = 0; i < priv->binary_n_records; i++) {
+		PkPackage *package = pk_package_sack_binary_get_package (sack, i);
+		g_ptr_array_add (packages, g_object_ref (package));
+	}
+	pk_package_sack_binary_free (sack);
+	for (i = 0; i < packages->len; i++)
+		pk_package_sack_add_package (sack, g_ptr_array_index (packages, i));
+}
+
 /**
  * pk_package_sack_clear:
  * @sack: a valid #PkPackageSack instance
@@ -76,8 +415,12 @@ pk_package_sack_clear (PkPackageSack *sack)
 {
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 
+	pk_package_sack_binary_free (sack);
+	pk_package_sack_disconnect_all (sack);
 	g_ptr_array_set_size (sack->priv->array, 0);
 	g_hash_table_remove_all (sack->priv->table);
+	g_hash_table_remove_all (sack->priv->name_index);
+	sack->priv->info_index_dirty = TRUE;
 }
 
 /**
@@ -95,6 +438,9 @@ pk_package_sack_get_size (PkPackageSack *sack)
 {
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), 0);
 
+	/* a mapped binary sack is only pending when the sack was empty */
+	if (sack->priv->binary != NULL)
+		return sack->priv->binary_n_records;
 	return sack->priv->array->len;
 }
 
@@ -118,6 +464,7 @@ pk_package_sack_get_ids (PkPackageSack *sack)
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 
+	pk_package_sack_ensure_loaded (sack);
 	array = sack->priv->array;
 	package_ids = g_new0 (gchar *, array->len + 1);
 	for (i = 0; i < array->len; i++) {
@@ -141,6 +488,7 @@ GPtrArray *
 pk_package_sack_get_array (PkPackageSack *sack)
 {
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
+	pk_package_sack_ensure_loaded (sack);
 	return g_ptr_array_ref (sack->priv->array);
 }
 
@@ -160,23 +508,24 @@ PkPackageSack *
 pk_package_sack_filter_by_info (PkPackageSack *sack, PkInfoEnum info)
 {
 	PkPackageSack *results;
-	PkPackage *package;
-	PkInfoEnum info_tmp;
+	GPtrArray *bucket;
 	guint i;
 	PkPackageSackPrivate *priv = sack->priv;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 
+	pk_package_sack_ensure_loaded (sack);
+
 	/* create new sack */
 	results = pk_package_sack_new ();
+	if (info >= PK_INFO_ENUM_LAST)
+		return results;
 
 	/* add each that matches the info enum */
-	for (i = 0; i < priv->array->len; i++) {
-		package = g_ptr_array_index (priv->array, i);
-		info_tmp = pk_package_get_info (package);
-		if (info_tmp == info)
-			pk_package_sack_add_package (results, package);
-	}
+	pk_package_sack_info_index_ensure (sack);
+	bucket = priv->info_index[info];
+	for (i = 0; i < bucket->len; i++)
+		pk_package_sack_add_package (results, g_ptr_array_index (bucket, i));
 
 	return results;
 }
@@ -205,6 +554,8 @@ pk_package_sack_filter (PkPackageSack *sack, PkPackageSackFilterFunc filter_cb,
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (filter_cb != NULL, NULL);
 
+	pk_package_sack_ensure_loaded (sack);
+
 	/* create new sack */
 	results = pk_package_sack_new ();
 
@@ -234,12 +585,18 @@ pk_package_sack_add_package (PkPackageSack *sack, PkPackage *package)
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
+	pk_package_sack_ensure_loaded (sack);
+
 	/* add to array */
 	g_ptr_array_add (sack->priv->array,
 			 g_object_ref (package));
 	g_hash_table_insert (sack->priv->table,
 			     (gpointer) pk_package_get_id (package),
 			     (gpointer) package);
+	pk_package_sack_index_add (sack, package);
+	g_signal_connect (package, "notify::info",
+			  G_CALLBACK (pk_package_sack_package_notify_info_cb),
+			  sack);
 
 	return TRUE;
 }
@@ -311,6 +668,101 @@ pk_package_sack_add_packages_from_line (PkPackageSack *sack,
 	return TRUE;
 }
 
+/*
+ * pk_package_sack_binary_id_valid:
+ *
+ * Does the same checks as pk_package_set_id() without allocating.
+ **/
+static gboolean
+pk_package_sack_binary_id_valid (const gchar *package_id)
+{
+	guint cnt = 0;
+	guint i;
+
+	if (package_id[0] == '\0' || package_id[0] == ';')
+		return FALSE;
+	for (i = 0; package_id[i] != '\0'; i++) {
+		if (package_id[i] == ';')
+			cnt++;
+	}
+	return cnt == 3;
+}
+
+/*
+ * pk_package_sack_add_packages_from_binary:
+ **/
+static gboolean
+pk_package_sack_add_packages_from_binary (PkPackageSack *sack,
+					  GBytes *bytes,
+					  GError **error)
+{
+	PkPackageSackPrivate *priv = sack->priv;
+	const PkPackageSackBinaryHeader *header;
+	const PkPackageSackBinaryRecord *records;
+	const guint32 *index;
+	const gchar *arena;
+	const guint8 *data;
+	gsize len;
+	guint32 arena_size;
+	guint32 n_records;
+	guint64 arena_offset;
+	guint64 index_offset;
+	guint64 records_offset;
+	guint i;
+
+	/* the file is untrusted, so check every offset before using it */
+	data = g_bytes_get_data (bytes, &len);
+	header = (const PkPackageSackBinaryHeader *) data;
+	if (GUINT32_FROM_LE (header->version) != PK_PACKAGE_SACK_BINARY_VERSION) {
+		g_set_error (error, 1, 0, "unsupported binary sack version %u",
+			     GUINT32_FROM_LE (header->version));
+		return FALSE;
+	}
+	n_records = GUINT32_FROM_LE (header->n_records);
+	records_offset = GUINT32_FROM_LE (header->records_offset);
+	index_offset = GUINT32_FROM_LE (header->index_offset);
+	arena_offset = GUINT32_FROM_LE (header->arena_offset);
+	arena_size = GUINT32_FROM_LE (header->arena_size);
+	if (records_offset % 4 != 0 || index_offset % 4 != 0 ||
+	    records_offset + (guint64) n_records * sizeof (PkPackageSackBinaryRecord) > len ||
+	    index_offset + (guint64) n_records * sizeof (guint32) > len ||
+	    arena_offset + arena_size > len ||
+	    arena_size == 0) {
+		g_set_error_literal (error, 1, 0, "invalid binary sack layout");
+		return FALSE;
+	}
+	records = (const PkPackageSackBinaryRecord *) (data + records_offset);
+	index = (const guint32 *) (data + index_offset);
+	arena = (const gchar *) data + arena_offset;
+	if (arena[0] != '\0' || arena[arena_size - 1] != '\0') {
+		g_set_error_literal (error, 1, 0, "invalid binary sack string arena");
+		return FALSE;
+	}
+	for (i = 0; i < n_records; i++) {
+		if (GUINT32_FROM_LE (index[i]) >= n_records ||
+		    GUINT32_FROM_LE (records[i].package_id) >= arena_size ||
+		    GUINT32_FROM_LE (records[i].name) >= arena_size ||
+		    GUINT32_FROM_LE (records[i].arch) >= arena_size ||
+		    GUINT32_FROM_LE (records[i].summary) >= arena_size) {
+			g_set_error (error, 1, 0, "invalid binary sack record %u", i);
+			return FALSE;
+		}
+		if (!pk_package_sack_binary_id_valid (arena + GUINT32_FROM_LE (records[i].package_id))) {
+			g_set_error (error, 1, 0, "invalid package-id in binary sack record %u", i);
+			return FALSE;
+		}
+	}
+
+	/* merging into existing packages needs the full array anyway */
+	pk_package_sack_ensure_loaded (sack);
+	priv->binary = g_bytes_ref (bytes);
+	priv->binary_packages = g_new0 (PkPackage *, n_records);
+	priv->binary_n_records = n_records;
+	if (priv->array->len > 0)
+		pk_package_sack_ensure_loaded (sack);
+	return TRUE;
+}
+
 /**
  * pk_package_sack_add_packages_from_file:
  * @sack: a valid #PkPackageSack instance
@@ -319,6 +771,10 @@ pk_package_sack_add_packages_from_line (PkPackageSack *sack,
  *
  * Adds packages from package-list file to a #PkPackageSack.
  *
+ * Local files written by pk_package_sack_to_binary_file() are detected
+ * automatically and mapped into memory, with the packages only created
+ * when they are first used.
+ *
  * Return value: %TRUE if there were no errors.
  *
  **/
@@ -328,11 +784,26 @@ pk_package_sack_add_packages_from_file (PkPackageSack *sack,
 					GError **error)
 {
 	GError *error_local = NULL;
+	g_autofree gchar *path = NULL;
 	g_autoptr(GFileInputStream) is = NULL;
 	g_autoptr(GDataInputStream) input = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 
+	/* try the binary format first */
+	path = g_file_get_path (file);
+	if (path != NULL) {
+		g_autoptr(GMappedFile) mapped = NULL;
+		mapped = g_mapped_file_new (path, FALSE, NULL);
+		if (mapped != NULL &&
+		    g_mapped_file_get_length (mapped) >= sizeof (PkPackageSackBinaryHeader) &&
+		    memcmp (g_mapped_file_get_contents (mapped),
+			    PK_PACKAGE_SACK_BINARY_MAGIC, 8) == 0) {
+			g_autoptr(GBytes) bytes = g_mapped_file_get_bytes (mapped);
+			return pk_package_sack_add_packages_from_binary (sack, bytes, error);
+		}
+	}
+
 	is = g_file_read (file, NULL, &error_local);
 	if (is == NULL) {
 		g_propagate_error (error, error_local);
@@ -374,6 +845,7 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 	PkPackage *pkg;
 	g_autoptr(GString) string = NULL;
 
+	pk_package_sack_ensure_loaded (sack);
 	string = g_string_new ("");
 	for (i = 0; i < sack->priv->array->len; i++) {
 		pkg = g_ptr_array_index (sack->priv->array, i);
@@ -397,6 +869,143 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 	return TRUE;
 }
 
+/*
+ * pk_package_sack_binary_add_string:
+ **/
+static guint32
+pk_package_sack_binary_add_string (GString *arena,
+				   GHashTable *offsets,
+				   const gchar *str)
+{
+	gpointer offset;
+
+	if (str == NULL)
+		return 0;
+	if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+		return GPOINTER_TO_UINT (offset);
+	offset = GUINT_TO_POINTER (arena->len);
+	g_string_append_len (arena, str, strlen (str) + 1);
+	g_hash_table_insert (offsets, (gpointer) str, offset);
+	return GPOINTER_TO_UINT (offset);
+}
+
+/*
+ * pk_package_sack_binary_sort_index_cb:
+ **/
+static gint
+pk_package_sack_binary_sort_index_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	GPtrArray *array = (GPtrArray *) user_data;
+	PkPackage *pkg1 = g_ptr_array_index (array, *((const guint32 *) a));
+	PkPackage *pkg2 = g_ptr_array_index (array, *((const guint32 *) b));
+	gint rc;
+
+	rc = g_strcmp0 (pk_package_get_name (pkg1), pk_package_get_name (pkg2));
+	if (rc != 0)
+		return rc;
+	return g_strcmp0 (pk_package_get_arch (pkg1), pk_package_get_arch (pkg2));
+}
+
+/**
+ * pk_package_sack_to_binary_file:
+ * @sack: a valid #PkPackageSack instance
+ * @file: a valid package-list file
+ * @error: a #GError to put the error code and message in, or %NULL
+ *
+ * Write the contents of a #PkPackageSack to a versioned binary file, which
+ * can be loaded again using pk_package_sack_add_packages_from_file() without
+ * any parsing.
+ *
+ * Return value: %TRUE if there were no errors.
+ *
+ * Since: 1.2.4
+ **/
+gboolean
+pk_package_sack_to_binary_file (PkPackageSack *sack, GFile *file, GError **error)
+{
+	GPtrArray *array;
+	PkPackage *pkg;
+	PkPackageSackBinaryHeader header;
+	guint i;
+	guint64 size;
+	g_autoptr(GArray) index = NULL;
+	g_autoptr(GArray) records = NULL;
+	g_autoptr(GByteArray) buf = NULL;
+	g_autoptr(GHashTable) offsets = NULL;
+	g_autofree gchar *path = NULL;
+	g_autoptr(GString) arena = NULL;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
+
+	pk_package_sack_ensure_loaded (sack);
+	array = sack->priv->array;
+
+	/* offset 0 is the empty string */
+	arena = g_string_new_len ("", 1);
+	offsets = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (offsets, (gpointer) "", GUINT_TO_POINTER (0));
+
+	/* add the fixed-width records */
+	records = g_array_sized_new (FALSE, TRUE, sizeof (PkPackageSackBinaryRecord), array->len);
+	index = g_array_sized_new (FALSE, FALSE, sizeof (guint32), array->len);
+	for (i = 0; i < array->len; i++) {
+		PkPackageSackBinaryRecord record;
+		pkg = g_ptr_array_index (array, i);
+		record.info = GUINT32_TO_LE (pk_package_get_info (pkg));
+		record.package_id = GUINT32_TO_LE (pk_package_sack_binary_add_string (arena, offsets, pk_package_get_id (pkg)));
+		record.name = GUINT32_TO_LE (pk_package_sack_binary_add_string (arena, offsets, pk_package_get_name (pkg)));
+		record.arch = GUINT32_TO_LE (pk_package_sack_binary_add_string (arena, offsets, pk_package_get_arch (pkg)));
+		record.summary = GUINT32_TO_LE (pk_package_sack_binary_add_string (arena, offsets, pk_package_get_summary (pkg)));
+		g_array_append_val (records, record);
+		g_array_append_val (index, i);
+	}
+
+	/* sort the index by name and arch for the lookups */
+	g_array_sort_with_data (index, pk_package_sack_binary_sort_index_cb, array);
+	for (i = 0; i < index->len; i++)
+		g_array_index (index, guint32, i) = GUINT32_TO_LE (g_array_index (index, guint32, i));
+
+	/* header, records, index, then the string arena */
+	size = sizeof (header) +
+	       (guint64) records->len * sizeof (PkPackageSackBinaryRecord) +
+	       (guint64) index->len * sizeof (guint32);
+	if (size + arena->len > G_MAXUINT32) {
+		g_set_error_literal (error, 1, 0, "package-sack too large for binary file");
+		return FALSE;
+	}
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, PK_PACKAGE_SACK_BINARY_MAGIC, sizeof (header.magic));
+	header.version = GUINT32_TO_LE (PK_PACKAGE_SACK_BINARY_VERSION);
+	header.n_records = GUINT32_TO_LE (records->len);
+	header.records_offset = GUINT32_TO_LE (sizeof (header));
+	header.index_offset = GUINT32_TO_LE (sizeof (header) + records->len * sizeof (PkPackageSackBinaryRecord));
+	header.arena_offset = GUINT32_TO_LE (size);
+	header.arena_size = GUINT32_TO_LE (arena->len);
+
+	buf = g_byte_array_sized_new (size + arena->len);
+	g_byte_array_append (buf, (const guint8 *) &header, sizeof (header));
+	g_byte_array_append (buf, (const guint8 *) records->data,
+			     records->len * sizeof (PkPackageSackBinaryRecord));
+	g_byte_array_append (buf, (const guint8 *) index->data,
+			     index->len * sizeof (guint32));
+	g_byte_array_append (buf, (const guint8 *) arena->str, arena->len);
+
+	/* readers map the file lazily, so it must never be truncated in
+	 * place; g_file_set_contents() writes a new file and renames it */
+	path = g_file_get_path (file);
+	if (path != NULL)
+		return g_file_set_contents (path, (const gchar *) buf->data, buf->len, error);
+	return g_file_replace_contents (file,
+					(const gchar *) buf->data,
+					buf->len,
+					NULL,
+					FALSE,
+					G_FILE_CREATE_NONE,
+					NULL,
+					NULL,
+					error);
+}
+
 /**
  * pk_package_sack_remove_package:
  * @sack: a valid #PkPackageSack instance
@@ -411,12 +1020,23 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 gboolean
 pk_package_sack_remove_package (PkPackageSack *sack, PkPackage *package)
 {
+	guint idx;
+
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
+	pk_package_sack_ensure_loaded (sack);
+
 	/* remove from array */
 	g_hash_table_remove (sack->priv->table, pk_package_get_id (package));
-	return g_ptr_array_remove (sack->priv->array, package);
+	if (!g_ptr_array_find (sack->priv->array, package, &idx))
+		return FALSE;
+	pk_package_sack_index_remove (sack, package);
+	g_signal_handlers_disconnect_by_func (package,
+					      G_CALLBACK (pk_package_sack_package_notify_info_cb),
+					      sack);
+	g_ptr_array_remove_index (sack->priv->array, idx);
+	return TRUE;
 }
 
 /**
@@ -436,21 +1056,15 @@ pk_package_sack_remove_package_by_id (PkPackageSack *sack,
 				      const gchar *package_id)
 {
 	PkPackage *package;
-	guint i;
-	GPtrArray *array;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (package_id != NULL, FALSE);
 
-	array = sack->priv->array;
-	for (i = 0; i < array->len; i++) {
-		package = g_ptr_array_index (array, i);
-		if (g_strcmp0 (package_id, pk_package_get_id (package)) == 0) {
-			pk_package_sack_remove_package (sack, package);
-			return TRUE;
-		}
-	}
-	return FALSE;
+	pk_package_sack_ensure_loaded (sack);
+	package = g_hash_table_lookup (sack->priv->table, package_id);
+	if (package == NULL)
+		return FALSE;
+	return pk_package_sack_remove_package (sack, package);
 }
 
 /**
@@ -471,27 +1085,41 @@ pk_package_sack_remove_by_filter (PkPackageSack *sack,
 				  PkPackageSackFilterFunc filter_cb,
 				  gpointer user_data)
 {
-	gboolean ret = FALSE;
 	PkPackage *package;
-	gint i;
+	guint i;
+	guint j = 0;
 	PkPackageSackPrivate *priv = sack->priv;
+	g_autoptr(GPtrArray) removed = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (filter_cb != NULL, FALSE);
 
-	/* add each that matches the info enum */
-	for (i = 0; i < (gint) priv->array->len; i++) {
-		package = g_ptr_array_index (priv->array, i);
-		if (!filter_cb (package, user_data)) {
-			ret = TRUE;
-			pk_package_sack_remove_package (sack, package);
+	pk_package_sack_ensure_loaded (sack);
 
-			/* ensure we pick up subsequent matches */
-			i--;
+	/* compact the array in one pass rather than removing each */
+	removed = g_ptr_array_new ();
+	for (i = 0; i < priv->array->len; i++) {
+		package = g_ptr_array_index (priv->array, i);
+		if (filter_cb (package, user_data)) {
+			priv->array->pdata[j++] = package;
+			continue;
 		}
+		g_hash_table_remove (priv->table, pk_package_get_id (package));
+		g_signal_handlers_disconnect_by_func (package,
+						      G_CALLBACK (pk_package_sack_package_notify_info_cb),
+						      sack);
+		g_ptr_array_add (removed, package);
 	}
-	return ret;
-}
+	if (removed->len == 0)
+		return FALSE;
+
+	/* move the removed packages to the end so they get unreffed */
+	for (i = 0; i < removed->len; i++)
+		priv->array->pdata[j + i] = g_ptr_array_index (removed, i);
+	g_ptr_array_set_size (priv->array, j);
+	pk_package_sack_index_rebuild (sack);
+	return TRUE;
+}
 
 /**
  * pk_package_sack_find_by_id:
@@ -513,6 +1141,24 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
+	/* use the index of the mapped file, rather than loading everything */
+	if (sack->priv->binary != NULL) {
+		g_autoptr(PkPackage) package_tmp = pk_package_new ();
+		guint i;
+		if (!pk_package_set_id (package_tmp, package_id, NULL))
+			return NULL;
+		for (i = pk_package_sack_binary_lower_bound (sack, pk_package_get_name (package_tmp), NULL);
+		     i < sack->priv->binary_n_records; i++) {
+			guint idx = pk_package_sack_binary_index (sack, i);
+			const PkPackageSackBinaryRecord *record = pk_package_sack_binary_record (sack, idx);
+			if (pk_package_sack_binary_compare (sack, idx, pk_package_get_name (package_tmp), NULL) != 0)
+				break;
+			if (g_strcmp0 (pk_package_sack_binary_string (sack, record->package_id), package_id) == 0)
+				return g_object_ref (pk_package_sack_binary_get_package (sack, idx));
+		}
+		return NULL;
+	}
+
 	package = g_hash_table_lookup (sack->priv->table, package_id);
 	if (package != NULL)
 		g_object_ref (package);
@@ -535,6 +1181,7 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 PkPackage *
 pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_id)
 {
+	GPtrArray *bucket;
 	PkPackage *pkg_tmp;
 	guint i;
 	g_auto(GStrv) split = NULL;
@@ -546,11 +1193,29 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 	split = pk_package_id_split (package_id);
 	if (split == NULL)
 		return NULL;
-	for (i = 0; i < sack->priv->array->len; i++) {
-		pkg_tmp = g_ptr_array_index (sack->priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
+
+	/* use the index of the mapped file, rather than loading everything */
+	if (sack->priv->binary != NULL) {
+		i = pk_package_sack_binary_lower_bound (sack,
+							split[PK_PACKAGE_ID_NAME],
+							split[PK_PACKAGE_ID_ARCH]);
+		if (i < sack->priv->binary_n_records) {
+			guint idx = pk_package_sack_binary_index (sack, i);
+			if (pk_package_sack_binary_compare (sack, idx,
+							    split[PK_PACKAGE_ID_NAME],
+							    split[PK_PACKAGE_ID_ARCH]) == 0)
+				return g_object_ref (pk_package_sack_binary_get_package (sack, idx));
+		}
+		return NULL;
+	}
+
+	bucket = g_hash_table_lookup (sack->priv->name_index,
+				      split[PK_PACKAGE_ID_NAME]);
+	if (bucket == NULL)
+		return NULL;
+	for (i = 0; i < bucket->len; i++) {
+		pkg_tmp = g_ptr_array_index (bucket, i);
+		if (g_strcmp0 (pk_package_get_arch (pkg_tmp),
 			       split[PK_PACKAGE_ID_ARCH]) == 0) {
 			return g_object_ref (pkg_tmp);
 		}
@@ -632,6 +1297,7 @@ void
 pk_package_sack_sort (PkPackageSack *sack, PkPackageSackSortType type)
 {
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	pk_package_sack_ensure_loaded (sack);
 	if (type == PK_PACKAGE_SACK_SORT_TYPE_NAME)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_name_func);
 	else if (type == PK_PACKAGE_SACK_SORT_TYPE_PACKAGE_ID)
@@ -640,6 +1306,9 @@ pk_package_sack_sort (PkPackageSack *sack, PkPackageSackSortType type)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_summary_func);
 	else if (type == PK_PACKAGE_SACK_SORT_TYPE_INFO)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_info_func);
+
+	/* keep the lookups returning packages in the new order */
+	pk_package_sack_index_rebuild (sack);
 }
 
 /**
@@ -663,6 +1332,7 @@ pk_package_sack_get_total_bytes (PkPackageSack *sack)
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 
+	pk_package_sack_ensure_loaded (sack);
 	array = sack->priv->array;
 	for (i = 0; i < array->len; i++) {
 		package = g_ptr_array_index (array, i);
@@ -688,6 +1358,7 @@ pk_package_sack_get_package_ids (PkPackageSack *sack)
 	guint i;
 
 	/* create array of package_ids */
+	pk_package_sack_ensure_loaded (sack);
 	array = sack->priv->array;
 	package_ids = g_new0 (gchar *, array->len+1);
 	for (i = 0; i < array->len; i++) {
@@ -704,71 +1375,90 @@ typedef struct {
 	GCancellable		*cancellable;
 	gboolean		 ret;
 	GSimpleAsyncResult	*res;
+	PkRoleEnum		 role;
+	gchar			**package_ids;
+	guint			 n_package_ids;
+	guint			 chunk_size;
+	guint			 n_chunks;
+	guint			 next_chunk;
+	guint			 n_running;
+	guint			 n_results;
+	gint			*percentages;
+	GError			*error;
+	PkProgress		*progress;
+	PkProgressCallback	 progress_callback;
+	gpointer		 progress_user_data;
 } PkPackageSackState;
 
-/***************************************************************************************************/
+typedef struct {
+	PkPackageSackState	*state;
+	guint			 idx;
+	guint			 offset;
+	guint			 len;
+} PkPackageSackChunk;
 
-/*
- * pk_package_sack_merge_bool_state_finish:
+/**
+ * pk_package_sack_set_max_transactions:
+ * @sack: a valid #PkPackageSack instance
+ * @max_transactions: the number of transactions, or 0 for the default
+ *
+ * Sets how many transactions may be run at the same time when merging
+ * data into the sack using pk_package_sack_resolve_async(),
+ * pk_package_sack_get_details_async() or
+ * pk_package_sack_get_update_detail_async().
+ *
+ * The package IDs are split into this many chunks, and each chunk is
+ * merged as soon as its transaction finishes. Chunks are never made
+ * larger than the number of items the daemon accepts in one transaction.
+ *
+ * Since: 1.2.4
  **/
-static void
-pk_package_sack_merge_bool_state_finish (PkPackageSackState *state, const GError *error)
+void
+pk_package_sack_set_max_transactions (PkPackageSack *sack, guint max_transactions)
 {
-	/* get result */
-	if (state->ret) {
-		g_simple_async_result_set_op_res_gboolean (state->res, state->ret);
-	} else {
-		g_simple_async_result_set_from_error (state->res, error);
-	}
-
-	/* complete */
-	g_simple_async_result_complete_in_idle (state->res);
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	if (max_transactions == 0)
+		max_transactions = 1;
+	sack->priv->max_transactions = max_transactions;
+}
 
-	/* deallocate */
-	if (state->cancellable != NULL)
-		g_object_unref (state->cancellable);
-	g_object_unref (state->res);
-	g_object_unref (state->sack);
-	g_slice_free (PkPackageSackState, state);
+/**
+ * pk_package_sack_get_max_transactions:
+ * @sack: a valid #PkPackageSack instance
+ *
+ * Gets how many transactions may be run at the same time when merging.
+ *
+ * Return value: the number of transactions
+ *
+ * Since: 1.2.4
+ **/
+guint
+pk_package_sack_get_max_transactions (PkPackageSack *sack)
+{
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), 0);
+	return sack->priv->max_transactions;
 }
 
+/***************************************************************************************************/
+
 /*
- * pk_package_sack_resolve_cb:
+ * pk_package_sack_merge_resolve_results:
  **/
-static void
-pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
+static guint
+pk_package_sack_merge_resolve_results (PkPackageSack *sack, PkResults *results)
 {
-	PkClient *client = PK_CLIENT (source_object);
 	PkPackage *item;
 	guint i;
 	PkPackage *package;
 	const gchar *package_id;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) packages = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to resolve: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the packages */
-	packages = pk_results_get_package_array (results);
-	if (packages->len == 0) {
-		g_warning ("%i", state->ret);
-		error = g_error_new (1, 0, "no packages found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
 	/* set data on each item */
+	packages = pk_results_get_package_array (results);
 	for (i = 0; i < packages->len; i++) {
 		item = g_ptr_array_index (packages, i);
 		package_id = pk_package_get_id (item);
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -781,119 +1471,22 @@ pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackage
 			      NULL);
 		g_object_unref (package);
 	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
-}
-
-/**
- * pk_package_sack_resolve_async:
- * @sack: a valid #PkPackageSack instance
- * @cancellable: a #GCancellable or %NULL
- * @progress_callback: (scope notified): the function to run when the progress changes
- * @progress_user_data: data to pass to @progress_callback
- * @callback: the function to run on completion
- * @user_data: the data to pass to @callback
- *
- * Merges in details about packages using resolve.
- *
- * Since: 0.5.2
- **/
-void
-pk_package_sack_resolve_async (PkPackageSack *sack, GCancellable *cancellable,
-				     PkProgressCallback progress_callback, gpointer progress_user_data,
-				     GAsyncReadyCallback callback, gpointer user_data)
-{
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
-	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
-	g_return_if_fail (callback != NULL);
-
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_resolve_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start resolve async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_resolve_async (sack->priv->client,
-				 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
-				 cancellable, progress_callback, progress_user_data,
-				 (GAsyncReadyCallback) pk_package_sack_resolve_cb, state);
-}
-
-/**
- * pk_package_sack_merge_generic_finish:
- * @sack: a valid #PkPackageSack instance
- * @res: the #GAsyncResult
- * @error: A #GError or %NULL
- *
- * Gets the result from the asynchronous function.
- *
- * Return value: %TRUE for success
- *
- * Since: 0.5.2
- **/
-gboolean
-pk_package_sack_merge_generic_finish (PkPackageSack *sack, GAsyncResult *res, GError **error)
-{
-	GSimpleAsyncResult *simple;
-
-	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
-	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	simple = G_SIMPLE_ASYNC_RESULT (res);
-
-	if (g_simple_async_result_propagate_error (simple, error))
-		return FALSE;
-
-	return g_simple_async_result_get_op_res_gboolean (simple);
+	return packages->len;
 }
 
-/***************************************************************************************************/
-
 /*
- * pk_package_sack_get_details_cb:
+ * pk_package_sack_merge_details_results:
  **/
-static void
-pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
+static guint
+pk_package_sack_merge_details_results (PkPackageSack *sack, PkResults *results)
 {
-	PkClient *client = PK_CLIENT (source_object);
 	PkDetails *item;
 	guint i;
 	PkPackage *package;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) details = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to details: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the details */
-	details = pk_results_get_details_array (results);
-	if (details->len == 0) {
-		error = g_error_new (1, 0, "no details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
 	/* set data on each item */
+	details = pk_results_get_details_array (results);
 	for (i = 0; i < details->len; i++) {
 		g_autofree gchar *package_id = NULL;
 		item = g_ptr_array_index (details, i);
@@ -902,7 +1495,7 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 			      NULL);
 
 		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -918,87 +1511,22 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 			      NULL);
 		g_object_unref (package);
 	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	return details->len;
 }
 
-/**
- * pk_package_sack_get_details_async:
- * @sack: a valid #PkPackageSack instance
- * @cancellable: a #GCancellable or %NULL
- * @progress_callback: (scope notified): the function to run when the progress changes
- * @progress_user_data: data to pass to @progress_callback
- * @callback: the function to run on completion
- * @user_data: the data to pass to @callback
- *
- * Merges in details about packages.
- **/
-void
-pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellable,
-				   PkProgressCallback progress_callback, gpointer progress_user_data,
-				   GAsyncReadyCallback callback, gpointer user_data)
-{
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
-	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
-	g_return_if_fail (callback != NULL);
-
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_details_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start details async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_details_async (sack->priv->client, package_ids,
-				     cancellable, progress_callback, progress_user_data,
-				     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
-}
-
-/***************************************************************************************************/
-
 /*
- * pk_package_sack_get_update_detail_cb:
+ * pk_package_sack_merge_update_detail_results:
  **/
-static void
-pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
+static guint
+pk_package_sack_merge_update_detail_results (PkPackageSack *sack, PkResults *results)
 {
-	PkClient *client = PK_CLIENT (source_object);
 	PkUpdateDetail *item;
 	guint i;
 	PkPackage *package;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) update_details = NULL;
 
-	/* get the results */
-	results = pk_client_generic_finish (client, res, &error);
-	if (results == NULL) {
-		g_warning ("failed to update_detail: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the update_details */
-	update_details = pk_results_get_update_detail_array (results);
-	if (update_details->len == 0) {
-		error = g_error_new (1, 0, "no update details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
 	/* set data on each item */
+	update_details = pk_results_get_update_detail_array (results);
 	for (i = 0; i < update_details->len; i++) {
 		PkRestartEnum restart;
 		PkUpdateStateEnum state_enum;
@@ -1030,7 +1558,7 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 			      NULL);
 
 		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
+		package = pk_package_sack_find_by_id (sack, package_id);
 		if (package == NULL) {
 			g_warning ("failed to find %s", package_id);
 			continue;
@@ -1052,14 +1580,353 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 			      NULL);
 		g_object_unref (package);
 	}
+	return update_details->len;
+}
+
+/***************************************************************************************************/
+
+/*
+ * pk_package_sack_merge_bool_state_finish:
+ **/
+static void
+pk_package_sack_merge_bool_state_finish (PkPackageSackState *state, const GError *error)
+{
+	/* get result */
+	if (state->ret) {
+		g_simple_async_result_set_op_res_gboolean (state->res, state->ret);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL)
+		g_object_unref (state->cancellable);
+	if (state->error != NULL)
+		g_error_free (state->error);
+	if (state->progress != NULL)
+		g_object_unref (state->progress);
+	g_strfreev (state->package_ids);
+	g_free (state->percentages);
+	g_object_unref (state->res);
+	g_object_unref (state->sack);
+	g_slice_free (PkPackageSackState, state);
+}
+
+/*
+ * pk_package_sack_merge_progress_cb:
+ *
+ * Each chunk is its own transaction, so when there is more than one the
+ * percentage is combined across all chunks, weighted by their size.
+ **/
+static void
+pk_package_sack_merge_progress_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	PkPackageSackChunk *chunk = (PkPackageSackChunk *) user_data;
+	PkPackageSackState *state = chunk->state;
+	gboolean ret = FALSE;
+	gint percentage;
+	guint64 done = 0;
+	guint i;
+
+	if (state->progress_callback == NULL)
+		return;
+
+	/* nothing to combine */
+	if (state->n_chunks == 1) {
+		state->progress_callback (progress, type, state->progress_user_data);
+		return;
+	}
+
+	switch (type) {
+	case PK_PROGRESS_TYPE_PERCENTAGE:
+		percentage = pk_progress_get_percentage (progress);
+		if (percentage < 0 || percentage > 100)
+			return;
+		state->percentages[chunk->idx] = percentage;
+		for (i = 0; i < state->n_chunks; i++) {
+			guint len = MIN (state->chunk_size,
+					 state->n_package_ids - i * state->chunk_size);
+			done += (guint64) state->percentages[i] * len;
+		}
+		ret = pk_progress_set_percentage (state->progress,
+						  done / state->n_package_ids);
+		break;
+	case PK_PROGRESS_TYPE_STATUS:
+		ret = pk_progress_set_status (state->progress,
+					      pk_progress_get_status (progress));
+		break;
+	case PK_PROGRESS_TYPE_PACKAGE_ID:
+		ret = pk_progress_set_package_id (state->progress,
+						  pk_progress_get_package_id (progress));
+		break;
+	case PK_PROGRESS_TYPE_PACKAGE:
+		ret = pk_progress_set_package (state->progress,
+					       pk_progress_get_package (progress));
+		break;
+	case PK_PROGRESS_TYPE_ITEM_PROGRESS:
+		ret = pk_progress_set_item_progress (state->progress,
+						     pk_progress_get_item_progress (progress));
+		break;
+	default:
+		/* the transaction ID, timings etc. are per chunk */
+		break;
+	}
+	if (ret)
+		state->progress_callback (state->progress, type, state->progress_user_data);
+}
+
+static void pk_package_sack_merge_cb (GObject *source_object, GAsyncResult *res, gpointer user_data);
+
+/*
+ * pk_package_sack_merge_next_chunk:
+ **/
+static void
+pk_package_sack_merge_next_chunk (PkPackageSackState *state)
+{
+	PkClient *client = state->sack->priv->client;
+	PkPackageSackChunk *chunk;
+	g_autofree gchar **package_ids = NULL;
+
+	chunk = g_slice_new0 (PkPackageSackChunk);
+	chunk->state = state;
+	chunk->idx = state->next_chunk++;
+	chunk->offset = chunk->idx * state->chunk_size;
+	chunk->len = MIN (state->chunk_size, state->n_package_ids - chunk->offset);
+	state->n_running++;
+
+	/* the client copies the IDs, so borrow the strings */
+	package_ids = g_new0 (gchar *, chunk->len + 1);
+	if (chunk->len > 0)
+		memcpy (package_ids, state->package_ids + chunk->offset,
+			chunk->len * sizeof (gchar *));
+
+	switch (state->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_client_resolve_async (client,
+					 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
+					 state->cancellable,
+					 pk_package_sack_merge_progress_cb, chunk,
+					 pk_package_sack_merge_cb, chunk);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+		pk_client_get_details_async (client, package_ids,
+					     state->cancellable,
+					     pk_package_sack_merge_progress_cb, chunk,
+					     pk_package_sack_merge_cb, chunk);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		pk_client_get_update_detail_async (client, package_ids,
+						   state->cancellable,
+						   pk_package_sack_merge_progress_cb, chunk,
+						   pk_package_sack_merge_cb, chunk);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/*
+ * pk_package_sack_merge_cb:
+ **/
+static void
+pk_package_sack_merge_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	PkClient *client = PK_CLIENT (source_object);
+	PkPackageSackChunk *chunk = (PkPackageSackChunk *) user_data;
+	PkPackageSackState *state = chunk->state;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	/* get the results */
+	results = pk_client_generic_finish (client, res, &error);
+	if (results == NULL) {
+		g_warning ("failed to %s: %s",
+			   pk_role_enum_to_string (state->role),
+			   error->message);
+		if (state->error == NULL)
+			state->error = g_steal_pointer (&error);
+	} else if (state->error == NULL) {
+		/* merge this chunk straight away */
+		switch (state->role) {
+		case PK_ROLE_ENUM_RESOLVE:
+			state->n_results += pk_package_sack_merge_resolve_results (state->sack, results);
+			break;
+		case PK_ROLE_ENUM_GET_DETAILS:
+			state->n_results += pk_package_sack_merge_details_results (state->sack, results);
+			break;
+		case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+			state->n_results += pk_package_sack_merge_update_detail_results (state->sack, results);
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+	state->n_running--;
+	g_slice_free (PkPackageSackChunk, chunk);
+
+	/* keep the pipeline full unless something already failed */
+	if (state->error == NULL && state->next_chunk < state->n_chunks) {
+		pk_package_sack_merge_next_chunk (state);
+		return;
+	}
+	if (state->n_running > 0)
+		return;
+
+	/* we're done */
+	if (state->error != NULL) {
+		pk_package_sack_merge_bool_state_finish (state, state->error);
+		return;
+	}
+	if (state->n_results == 0) {
+		if (state->role == PK_ROLE_ENUM_RESOLVE)
+			error = g_error_new (1, 0, "no packages found!");
+		else if (state->role == PK_ROLE_ENUM_GET_DETAILS)
+			error = g_error_new (1, 0, "no details found!");
+		else
+			error = g_error_new (1, 0, "no update details found!");
+		pk_package_sack_merge_bool_state_finish (state, error);
+		return;
+	}
 
 	/* all okay */
 	state->ret = TRUE;
+	pk_package_sack_merge_bool_state_finish (state, NULL);
+}
 
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+/*
+ * pk_package_sack_merge_async:
+ **/
+static void
+pk_package_sack_merge_async (PkPackageSack *sack, PkRoleEnum role, gpointer source_tag,
+			     GCancellable *cancellable,
+			     PkProgressCallback progress_callback, gpointer progress_user_data,
+			     GAsyncReadyCallback callback, gpointer user_data)
+{
+	PkPackageSackState *state;
+	guint max_transactions = sack->priv->max_transactions;
+	guint i;
+	g_autoptr(GSimpleAsyncResult) res = NULL;
+
+	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, source_tag);
+
+	/* save state */
+	state = g_slice_new0 (PkPackageSackState);
+	state->res = g_object_ref (res);
+	state->sack = g_object_ref (sack);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+	state->ret = FALSE;
+	state->role = role;
+	state->progress_callback = progress_callback;
+	state->progress_user_data = progress_user_data;
+	state->progress = pk_progress_new ();
+	pk_progress_set_role (state->progress, role);
+
+	/* split into chunks the daemon will accept */
+	state->package_ids = pk_package_sack_get_package_ids (sack);
+	state->n_package_ids = g_strv_length (state->package_ids);
+	state->chunk_size = (state->n_package_ids + max_transactions - 1) / max_transactions;
+	state->chunk_size = CLAMP (state->chunk_size, 1, PK_PACKAGE_SACK_MAX_ITEMS_PER_TRANSACTION);
+	state->n_chunks = (state->n_package_ids + state->chunk_size - 1) / state->chunk_size;
+	if (state->n_chunks == 0)
+		state->n_chunks = 1;
+	state->percentages = g_new0 (gint, state->n_chunks);
+
+	/* start as many as we're allowed to */
+	for (i = 0; i < MIN (max_transactions, state->n_chunks); i++)
+		pk_package_sack_merge_next_chunk (state);
+}
+
+/**
+ * pk_package_sack_resolve_async:
+ * @sack: a valid #PkPackageSack instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope notified): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Merges in details about packages using resolve.
+ *
+ * Since: 0.5.2
+ **/
+void
+pk_package_sack_resolve_async (PkPackageSack *sack, GCancellable *cancellable,
+				     PkProgressCallback progress_callback, gpointer progress_user_data,
+				     GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (callback != NULL);
+
+	/* start resolve async */
+	pk_package_sack_merge_async (sack, PK_ROLE_ENUM_RESOLVE,
+				     pk_package_sack_resolve_async, cancellable,
+				     progress_callback, progress_user_data,
+				     callback, user_data);
+}
+
+/**
+ * pk_package_sack_merge_generic_finish:
+ * @sack: a valid #PkPackageSack instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.5.2
+ **/
+gboolean
+pk_package_sack_merge_generic_finish (PkPackageSack *sack, GAsyncResult *res, GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	return g_simple_async_result_get_op_res_gboolean (simple);
 }
 
+/***************************************************************************************************/
+
+/**
+ * pk_package_sack_get_details_async:
+ * @sack: a valid #PkPackageSack instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope notified): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Merges in details about packages.
+ **/
+void
+pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellable,
+				   PkProgressCallback progress_callback, gpointer progress_user_data,
+				   GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (callback != NULL);
+
+	/* start details async */
+	pk_package_sack_merge_async (sack, PK_ROLE_ENUM_GET_DETAILS,
+				     pk_package_sack_get_details_async, cancellable,
+				     progress_callback, progress_user_data,
+				     callback, user_data);
+}
+
+/***************************************************************************************************/
+
 /**
  * pk_package_sack_get_update_detail_async:
  * @sack: a valid #PkPackageSack instance
@@ -1078,28 +1945,14 @@ pk_package_sack_get_update_detail_async (PkPackageSack *sack, GCancellable *canc
 					 PkProgressCallback progress_callback, gpointer progress_user_data,
 					 GAsyncReadyCallback callback, gpointer user_data)
 {
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
 
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_update_detail_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
 	/* start update_detail async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_update_detail_async (sack->priv->client, package_ids,
-					   cancellable, progress_callback, progress_user_data,
-					   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
+	pk_package_sack_merge_async (sack, PK_ROLE_ENUM_GET_UPDATE_DETAIL,
+				     pk_package_sack_get_update_detail_async, cancellable,
+				     progress_callback, progress_user_data,
+				     callback, user_data);
 }
 
 /***************************************************************************************************/
@@ -1138,12 +1991,19 @@ static void
 pk_package_sack_init (PkPackageSack *sack)
 {
 	PkPackageSackPrivate *priv;
+	guint i;
+
 	sack->priv = PK_PACKAGE_SACK_GET_PRIVATE (sack);
 	priv = sack->priv;
 
 	priv->table = g_hash_table_new (g_str_hash, g_str_equal);
 	priv->array = g_ptr_array_new_with_free_func (g_object_unref);
+	priv->name_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, (GDestroyNotify) g_ptr_array_unref);
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++)
+		priv->info_index[i] = g_ptr_array_new ();
 	priv->client = pk_client_new ();
+	priv->max_transactions = 1;
 }
 
 /*
@@ -1154,9 +2014,15 @@ pk_package_sack_finalize (GObject *object)
 {
 	PkPackageSack *sack = PK_PACKAGE_SACK (object);
 	PkPackageSackPrivate *priv = sack->priv;
+	guint i;
 
+	pk_package_sack_binary_free (sack);
+	pk_package_sack_disconnect_all (sack);
 	g_ptr_array_unref (priv->array);
 	g_hash_table_unref (priv->table);
+	g_hash_table_unref (priv->name_index);
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++)
+		g_ptr_array_unref (priv->info_index[i]);
 	g_object_unref (priv->client);
 
 	G_OBJECT_CLASS (pk_package_sack_parent_class)->finalize (object);
@@ -121,6 +121,9 @@ gboolean	 pk_package_sack_add_packages_from_file	(PkPackageSack		*sack,
 gboolean	 pk_package_sack_to_file		(PkPackageSack		*sack,
 							 GFile			*file,
 							 GError			**error);
+gboolean	 pk_package_sack_to_binary_file		(PkPackageSack		*sack,
+							 GFile			*file,
+							 GError			**error);
 gboolean	 pk_package_sack_remove_package		(PkPackageSack		*sack,
 							 PkPackage		*package);
 gboolean	 pk_package_sack_remove_package_by_id	(PkPackageSack		*sack,
@@ -138,6 +141,9 @@ PkPackageSack	*pk_package_sack_filter			(PkPackageSack		*sack,
 							 PkPackageSackFilterFunc filter_cb,
 							 gpointer		 user_data);
 guint64		 pk_package_sack_get_total_bytes	(PkPackageSack		*sack);
+void		 pk_package_sack_set_max_transactions	(PkPackageSack		*sack,
+							 guint			 max_transactions);
+guint		 pk_package_sack_get_max_transactions	(PkPackageSack		*sack);
 
 gboolean	 pk_package_sack_merge_generic_finish	(PkPackageSack		*sack,
 							 GAsyncResult		*res,
@@ -267,7 +267,10 @@ void
 pk_package_set_info (PkPackage *package, PkInfoEnum info)
 {
 	g_return_if_fail (PK_IS_PACKAGE (package));
+	if (package->priv->info == info)
+		return;
 	package->priv->info = info;
+	g_object_notify (G_OBJECT (package), "info");
 }
 
 /**
@@ -1120,6 +1120,21 @@ pk_test_package_sack_func (void)
 	ret = pk_package_sack_remove_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
 	g_assert (!ret);
 
+	/* resolve in more than one transaction */
+	pk_package_sack_set_max_transactions (sack, 2);
+	g_assert_cmpint (pk_package_sack_get_max_transactions (sack), ==, 2);
+	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed", NULL);
+	pk_package_sack_resolve_async (sack, NULL, NULL, NULL, (GAsyncReadyCallback) pk_test_package_sack_resolve_cb, NULL);
+	_g_test_loop_run_with_timeout (5000);
+
+	/* check both chunks were merged */
+	package = pk_package_sack_find_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	g_assert (package != NULL);
+	g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_INSTALLED);
+	g_object_unref (package);
+	pk_package_sack_clear (sack);
+
 	/* remove by filter */
 	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
 	pk_package_sack_add_package_by_id (sack, "powertop-debuginfo;1.8-1.fc8;i386;fedora", NULL);
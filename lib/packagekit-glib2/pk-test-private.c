@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
 
 #include "pk-common.h"
 #include "pk-debug.h"
@@ -31,6 +32,7 @@
 #include "pk-package.h"
 #include "pk-package-id.h"
 #include "pk-package-ids.h"
+#include "pk-package-sack.h"
 #include "pk-progress-bar.h"
 #include "pk-results.h"
 
@@ -404,6 +406,138 @@ pk_test_package_id_func (void)
 	g_assert (sections == NULL);
 }
 
+static void
+pk_test_package_sack_binary_func (void)
+{
+	gboolean ret;
+	g_autofree gchar *path = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(PkPackage) package = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkPackageSack) sack_binary = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	/* create a sack with a few packages */
+	sack = pk_package_sack_new ();
+	ret = pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;x86_64;installed", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	package = pk_package_sack_find_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	pk_package_set_info (package, PK_INFO_ENUM_AVAILABLE);
+	pk_package_set_summary (package, "Power consumption monitor");
+	g_clear_object (&package);
+
+	/* write binary file */
+	tmpdir = g_dir_make_tmp ("pk-self-test-sack-XXXXXX", &error);
+	g_assert_no_error (error);
+	path = g_build_filename (tmpdir, "sack.bin", NULL);
+	file = g_file_new_for_path (path);
+	ret = pk_package_sack_to_binary_file (sack, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* load it without creating all the packages */
+	sack_binary = pk_package_sack_new ();
+	ret = pk_package_sack_add_packages_from_file (sack_binary, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack_binary), ==, 3);
+
+	/* find using the index */
+	package = pk_package_sack_find_by_id (sack_binary, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_AVAILABLE);
+	g_assert_cmpstr (pk_package_get_summary (package), ==, "Power consumption monitor");
+	g_clear_object (&package);
+	package = pk_package_sack_find_by_id (sack_binary, "powertop;1.8-1.fc8;i386;updates");
+	g_assert (package == NULL);
+	package = pk_package_sack_find_by_id_name_arch (sack_binary, "kernel;0.1;x86_64;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpstr (pk_package_get_id (package), ==, "kernel;2.6.23-0.115.rc3.git1.fc8;x86_64;installed");
+	g_clear_object (&package);
+	package = pk_package_sack_find_by_id_name_arch (sack_binary, "kernel;0.1;ppc64;fedora");
+	g_assert (package == NULL);
+
+	/* replacing the file keeps the mapped one intact */
+	ret = pk_package_sack_to_binary_file (sack, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* load everything, keeping the packages already created */
+	array = pk_package_sack_get_array (sack_binary);
+	g_assert_cmpint (array->len, ==, 3);
+	package = pk_package_sack_find_by_id (sack_binary, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package == g_ptr_array_index (array, 0));
+	g_clear_object (&package);
+
+	/* merging into a sack that is not empty */
+	ret = pk_package_sack_add_packages_from_file (sack_binary, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack_binary), ==, 6);
+
+	g_unlink (path);
+	g_rmdir (tmpdir);
+}
+
+static gboolean
+pk_test_package_sack_index_filter_cb (PkPackage *package, gpointer user_data)
+{
+	return g_strcmp0 (pk_package_get_arch (package), "i386") == 0;
+}
+
+static void
+pk_test_package_sack_index_func (void)
+{
+	gboolean ret;
+	g_autoptr(PkPackage) package = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkPackageSack) sack_info = NULL;
+
+	sack = pk_package_sack_new ();
+	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed", NULL);
+	pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;x86_64;installed", NULL);
+
+	/* find by name and arch */
+	package = pk_package_sack_find_by_id_name_arch (sack, "kernel;0.1;x86_64;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpstr (pk_package_get_id (package), ==, "kernel;2.6.23-0.115.rc3.git1.fc8;x86_64;installed");
+
+	/* changing the info of a package moves it to the right bucket */
+	pk_package_set_info (package, PK_INFO_ENUM_INSTALLED);
+	sack_info = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (pk_package_sack_get_size (sack_info), ==, 1);
+	g_clear_object (&sack_info);
+	sack_info = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_package_sack_get_size (sack_info), ==, 2);
+	g_clear_object (&sack_info);
+
+	/* removing keeps the indexes up to date */
+	ret = pk_package_sack_remove_by_filter (sack, pk_test_package_sack_index_filter_cb, NULL);
+	g_assert (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 2);
+	g_clear_object (&package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "kernel;0.1;x86_64;fedora");
+	g_assert (package == NULL);
+	sack_info = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (pk_package_sack_get_size (sack_info), ==, 0);
+	ret = pk_package_sack_remove_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (ret);
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;0.1;i386;fedora");
+	g_assert (package == NULL);
+	package = pk_package_sack_find_by_id_name_arch (sack, "kernel;0.1;i386;fedora");
+	g_assert (package != NULL);
+}
+
 static void
 pk_test_package_ids_func (void)
 {
@@ -929,6 +1063,8 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/progress", pk_test_progress_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-binary", pk_test_package_sack_binary_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-index", pk_test_package_sack_index_func);
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/offline-upgrade", pk_test_offline_upgrade_func);
@@ -79,6 +79,9 @@ static gboolean pk_transaction_is_supported_content_type (PkTransaction *transac
 /* maximum number of packages that can be processed in one go */
 #define PK_TRANSACTION_MAX_PACKAGES_TO_PROCESS	10000
 
+/* how often progress is sent to clients when not set in the config file */
+#define PK_TRANSACTION_PROGRESS_UPDATES_PER_SECOND	10
+
 struct PkTransactionPrivate
 {
 	PkRoleEnum		 role;
@@ -138,6 +141,13 @@ struct PkTransactionPrivate
 	guint			 registration_id;
 	GDBusConnection		*connection;
 	GDBusNodeInfo		*introspection;
+
+	/* rate limited progress */
+	GHashTable		*pending_properties;
+	GHashTable		*pending_item_progress;
+	guint			 progress_interval;
+	guint			 progress_id;
+	gint64			 progress_last_emit;
 };
 
 typedef enum {
@@ -299,32 +309,128 @@ out:
 }
 
 static void
-pk_transaction_emit_property_changed (PkTransaction *transaction,
-				      const gchar *property_name,
-				      GVariant *property_value)
+pk_transaction_emit_item_progress (PkTransaction *transaction,
+				   PkItemProgress *item_progress)
 {
-	GVariantBuilder builder;
-	GVariantBuilder invalidated_builder;
-
-	/* build the dict */
-	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder,
-			       "{sv}",
-			       property_name,
-			       property_value);
+	g_debug ("emitting item-progress %s, %s: %u",
+		 pk_item_progress_get_package_id (item_progress),
+		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
+		 pk_item_progress_get_percentage (item_progress));
 	g_dbus_connection_emit_signal (transaction->priv->connection,
 				       NULL,
 				       transaction->priv->tid,
-				       "org.freedesktop.DBus.Properties",
-				       "PropertiesChanged",
-				       g_variant_new ("(sa{sv}as)",
-						      PK_DBUS_INTERFACE_TRANSACTION,
-						      &builder,
-						      &invalidated_builder),
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       "ItemProgress",
+				       g_variant_new ("(suu)",
+						      pk_item_progress_get_package_id (item_progress),
+						      pk_item_progress_get_status (item_progress),
+						      pk_item_progress_get_percentage (item_progress)),
 				       NULL);
 }
 
+/* send everything that has changed since the last flush as one signal */
+static void
+pk_transaction_progress_flush (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	GVariantBuilder builder;
+	GVariantBuilder invalidated_builder;
+
+	if (priv->progress_id != 0) {
+		g_source_remove (priv->progress_id);
+		priv->progress_id = 0;
+	}
+	priv->progress_last_emit = g_get_monotonic_time ();
+
+	/* build the dict */
+	if (g_hash_table_size (priv->pending_properties) > 0) {
+		g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
+		g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+		g_hash_table_iter_init (&iter, priv->pending_properties);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			g_variant_builder_add (&builder,
+					       "{sv}",
+					       (const gchar *) key,
+					       (GVariant *) value);
+		}
+		g_hash_table_remove_all (priv->pending_properties);
+		g_dbus_connection_emit_signal (priv->connection,
+					       NULL,
+					       priv->tid,
+					       "org.freedesktop.DBus.Properties",
+					       "PropertiesChanged",
+					       g_variant_new ("(sa{sv}as)",
+							      PK_DBUS_INTERFACE_TRANSACTION,
+							      &builder,
+							      &invalidated_builder),
+					       NULL);
+	}
+
+	/* only the latest progress of each item */
+	g_hash_table_iter_init (&iter, priv->pending_item_progress);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		pk_transaction_emit_item_progress (transaction, PK_ITEM_PROGRESS (value));
+	g_hash_table_remove_all (priv->pending_item_progress);
+}
+
+static gboolean
+pk_transaction_progress_flush_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->progress_id = 0;
+	pk_transaction_progress_flush (transaction);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_transaction_progress_queue (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 elapsed;
+
+	/* already scheduled */
+	if (priv->progress_id != 0)
+		return;
+
+	/* nothing sent recently, so send it now */
+	elapsed = (g_get_monotonic_time () - priv->progress_last_emit) / 1000;
+	if (elapsed >= priv->progress_interval) {
+		pk_transaction_progress_flush (transaction);
+		return;
+	}
+	priv->progress_id = g_timeout_add (priv->progress_interval - elapsed,
+					   pk_transaction_progress_flush_cb,
+					   transaction);
+	g_source_set_name_by_id (priv->progress_id, "[PkTransaction] progress");
+}
+
+/* for values that change often, sent at most ProgressUpdatesPerSecond */
+static void
+pk_transaction_emit_progress_property_changed (PkTransaction *transaction,
+					       const gchar *property_name,
+					       GVariant *property_value)
+{
+	g_hash_table_insert (transaction->priv->pending_properties,
+			     g_strdup (property_name),
+			     g_variant_ref_sink (property_value));
+	pk_transaction_progress_queue (transaction);
+}
+
+static void
+pk_transaction_emit_property_changed (PkTransaction *transaction,
+				      const gchar *property_name,
+				      GVariant *property_value)
+{
+	/* send along with any progress that is still pending */
+	g_hash_table_insert (transaction->priv->pending_properties,
+			     g_strdup (property_name),
+			     g_variant_ref_sink (property_value));
+	pk_transaction_progress_flush (transaction);
+}
+
 static void
 pk_transaction_progress_changed_emit (PkTransaction *transaction,
 				     guint percentage,
@@ -338,15 +444,15 @@ pk_transaction_progress_changed_emit (PkTransaction *transaction,
 	transaction->priv->elapsed_time = elapsed;
 
 	/* emit */
-	pk_transaction_emit_property_changed (transaction,
-					      "Percentage",
-					      g_variant_new_uint32 (percentage));
-	pk_transaction_emit_property_changed (transaction,
-					      "ElapsedTime",
-					      g_variant_new_uint32 (elapsed));
-	pk_transaction_emit_property_changed (transaction,
-					      "RemainingTime",
-					      g_variant_new_uint32 (remaining));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "Percentage",
+						       g_variant_new_uint32 (percentage));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "ElapsedTime",
+						       g_variant_new_uint32 (elapsed));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "RemainingTime",
+						       g_variant_new_uint32 (remaining));
 }
 
 static void
@@ -392,6 +498,9 @@ pk_transaction_finished_emit (PkTransaction *transaction,
 			      PkExitEnum exit_enum,
 			      guint time_ms)
 {
+	/* the final progress always goes out before ::Finished() */
+	pk_transaction_progress_flush (transaction);
+
 	g_debug ("emitting finished '%s', %i",
 		 pk_exit_enum_to_string (exit_enum),
 		 time_ms);
@@ -638,24 +747,26 @@ pk_transaction_item_progress_cb (PkBackendJob *job,
 				 PkItemProgress *item_progress,
 				 PkTransaction *transaction)
 {
+	PkItemProgress *pending;
+	const gchar *package_id;
+
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 	g_return_if_fail (transaction->priv->tid != NULL);
 
+	/* a new status for the item is never merged away */
+	package_id = pk_item_progress_get_package_id (item_progress);
+	if (package_id == NULL)
+		package_id = "";
+	pending = g_hash_table_lookup (transaction->priv->pending_item_progress, package_id);
+	if (pending != NULL &&
+	    pk_item_progress_get_status (pending) != pk_item_progress_get_status (item_progress))
+		pk_transaction_emit_item_progress (transaction, pending);
+
 	/* emit */
-	g_debug ("emitting item-progress %s, %s: %u",
-		 pk_item_progress_get_package_id (item_progress),
-		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
-		 pk_item_progress_get_percentage (item_progress));
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "ItemProgress",
-				       g_variant_new ("(suu)",
-						      pk_item_progress_get_package_id (item_progress),
-						      pk_item_progress_get_status (item_progress),
-						      pk_item_progress_get_percentage (item_progress)),
-				       NULL);
+	g_hash_table_insert (transaction->priv->pending_item_progress,
+			     g_strdup (package_id),
+			     g_object_ref (item_progress));
+	pk_transaction_progress_queue (transaction);
 }
 
 static void
@@ -1596,9 +1707,9 @@ pk_transaction_speed_cb (PkBackendJob *job,
 {
 	/* emit */
 	transaction->priv->speed = speed;
-	pk_transaction_emit_property_changed (transaction,
-					      "Speed",
-					      g_variant_new_uint32 (speed));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "Speed",
+						       g_variant_new_uint32 (speed));
 }
 
 static void
@@ -1608,9 +1719,9 @@ pk_transaction_download_size_remaining_cb (PkBackendJob *job,
 {
 	/* emit */
 	transaction->priv->download_size_remaining = *download_size_remaining;
-	pk_transaction_emit_property_changed (transaction,
-					      "DownloadSizeRemaining",
-					      g_variant_new_uint64 (*download_size_remaining));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "DownloadSizeRemaining",
+						       g_variant_new_uint64 (*download_size_remaining));
 }
 
 static void
@@ -1620,9 +1731,9 @@ pk_transaction_percentage_cb (PkBackendJob *job,
 {
 	/* emit */
 	transaction->priv->percentage = percentage;
-	pk_transaction_emit_property_changed (transaction,
-					      "Percentage",
-					      g_variant_new_uint32 (percentage));
+	pk_transaction_emit_progress_property_changed (transaction,
+						       "Percentage",
+						       g_variant_new_uint32 (percentage));
 }
 
 gboolean
@@ -5163,6 +5274,10 @@ pk_transaction_init (PkTransaction *transaction)
 	transaction->priv->results = pk_results_new ();
 	transaction->priv->supported_content_types = g_ptr_array_new_with_free_func (g_free);
 	transaction->priv->cancellable = g_cancellable_new ();
+	transaction->priv->pending_properties = g_hash_table_new_full (g_str_hash, g_str_equal,
+								       g_free, (GDestroyNotify) g_variant_unref);
+	transaction->priv->pending_item_progress = g_hash_table_new_full (g_str_hash, g_str_equal,
+									  g_free, (GDestroyNotify) g_object_unref);
 
 	transaction->priv->transaction_db = pk_transaction_db_new ();
 	ret = pk_transaction_db_load (transaction->priv->transaction_db, &error);
@@ -5194,7 +5309,12 @@ pk_transaction_dispose (GObject *object)
 	}
 
 	/* send signal to clients that we are about to be destroyed */
+	if (transaction->priv->progress_id > 0) {
+		g_source_remove (transaction->priv->progress_id);
+		transaction->priv->progress_id = 0;
+	}
 	if (transaction->priv->connection != NULL) {
+		pk_transaction_progress_flush (transaction);
 		g_debug ("emitting destroy %s", transaction->priv->tid);
 		g_dbus_connection_emit_signal (transaction->priv->connection,
 					       NULL,
@@ -5235,6 +5355,8 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->sender);
 	g_free (transaction->priv->cmdline);
 	g_ptr_array_unref (transaction->priv->supported_content_types);
+	g_hash_table_unref (transaction->priv->pending_properties);
+	g_hash_table_unref (transaction->priv->pending_item_progress);
 
 	if (transaction->priv->connection != NULL)
 		g_object_unref (transaction->priv->connection);
@@ -5259,9 +5381,19 @@ PkTransaction *
 pk_transaction_new (GKeyFile *conf, GDBusNodeInfo *introspection)
 {
 	PkTransaction *transaction;
+	gint updates_per_second;
+	g_autoptr(GError) error = NULL;
+
 	transaction = g_object_new (PK_TYPE_TRANSACTION, NULL);
 	transaction->priv->conf = g_key_file_ref (conf);
 	transaction->priv->job = pk_backend_job_new (conf);
+
+	/* 0 means every change is sent straight away */
+	updates_per_second = g_key_file_get_integer (conf, "Daemon", "ProgressUpdatesPerSecond", &error);
+	if (error != NULL)
+		updates_per_second = PK_TRANSACTION_PROGRESS_UPDATES_PER_SECOND;
+	if (updates_per_second > 0)
+		transaction->priv->progress_interval = 1000 / updates_per_second;
 	transaction->priv->introspection = g_dbus_node_info_ref (introspection);
 	return PK_TRANSACTION (transaction);
 }